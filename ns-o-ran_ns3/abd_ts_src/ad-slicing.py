@@ -8,8 +8,10 @@ import pandas as pd
 import torch.nn as nn
 import os, time, logging, traceback
 from pathlib import Path
-from typing import Tuple, Dict, Any
+from typing import Tuple, Dict, Any, List
+from datetime import datetime, timezone
 from influxdb import InfluxDBClient
+from stream_join import StreamJoin, InfluxJoinSource
 
 # =========================
 # Config
@@ -21,10 +23,18 @@ CELLID_NAME = {2: "eMBB", 3: "uRLLC", 4: "mMTC"}
 def _fmt_num(val):
 	return f"{val:.2f}" if isinstance(val, (int, float)) else "N/A"
 
+def _fmt_time(t_ns):
+	# InfluxDB RFC3339 time, as returned by queries without epoch
+	dt = datetime.fromtimestamp(int(t_ns) // 1_000_000_000, tz=timezone.utc)
+	return dt.strftime("%Y-%m-%dT%H:%M:%S") + ".{:09d}".format(int(t_ns) % 1_000_000_000).rstrip("0").rstrip(".") + "Z"
+
 # =========================
 QUERY_INTERVAL = 0.001  # seconds
+JOIN_WINDOW_NS = 5_000_000_000  # rows whose three sides don't arrive within 5 s of stream time are dropped
+JOIN_STATS_EVERY = 30  # seconds between [JOIN] stats prints (joined, unmatched, lag)
 MODELS_DIR = Path("models_dir")  # folder containing hier_*.pkl and VAE files
 DEBUG = True  # set False to reduce logs
+BATCH_INFERENCE = True  # score the rows of each poll together (same decisions as per-row)
 
 # =========================
 # Logging
@@ -53,16 +63,17 @@ class VAE(nn.Module):
 			nn.Linear(32, input_dim)
 		)
 
-	def reparameterize(self, mu, logvar):
+	def reparameterize(self, mu, logvar, eps=None):
 		std = torch.exp(0.5 * logvar)
-		eps = torch.randn_like(std)
+		if eps is None:
+			eps = torch.randn_like(std)
 		return mu + eps * std
 
-	def forward(self, x):
+	def forward(self, x, eps=None):
 		h = self.encoder(x)
 		mu = self.fc_mu(h)
 		logvar = self.fc_logvar(h)
-		z = self.reparameterize(mu, logvar)
+		z = self.reparameterize(mu, logvar, eps)
 		recon = self.decoder(z)
 		return recon, mu, logvar
 
@@ -213,10 +224,157 @@ def vae_anomaly_for_row(row_dict: Dict[str, Any], vae_pack: Dict[str, Any]) -> T
 	y_hat = int(rec_err > thr)
 	return rec_err, y_hat
 
+# =========================
+# Batched inference (one poll of joined rows at a time)
+# =========================
+def _align_rows_for_scaler(rows: List[Dict[str, Any]], cols_expected: list, scaler) -> pd.DataFrame:
+	"""_align_columns_for_scaler for many rows, without filling NaN from the other rows:
+	the per-row median fill of a single row leaves its NaN in place, so this keeps the per-row result."""
+	if hasattr(scaler, "feature_names_in_"):
+		expected = list(scaler.feature_names_in_)
+	else:
+		expected = list(cols_expected)
+
+	X = pd.DataFrame(rows).reindex(columns=expected)
+	X.replace([np.inf, -np.inf], np.nan, inplace=True)
+	for c in expected:
+		if not np.issubdtype(X[c].dtype, np.number):
+			X[c] = pd.to_numeric(X[c], errors="coerce")
+	return X
+
+def assign_clusters_batch(rows: List[Dict[str, Any]], assigner: Dict[str, Any]) -> np.ndarray:
+	"""assign_cluster_for_row for many rows: the distances to all centroids as one matrix op."""
+	C = assigner["centroids"]
+	Xs = assigner["scaler"].transform(
+		_align_rows_for_scaler(rows, cols_expected=assigner["selected_columns"], scaler=assigner["scaler"]))  # (N, D)
+
+	if assigner["distance_metric"] == "euclidean":
+		dists = np.linalg.norm(Xs[:, None, :] - C[None, :, :], axis=2)  # (N, K)
+
+	elif assigner["distance_metric"] == "mahalanobis":
+		dists = np.empty((Xs.shape[0], C.shape[0]))
+		for k, inv in enumerate(assigner["invs"]):
+			diff = Xs - C[k]
+			dists[:, k] = np.einsum("nd,nd->n", diff @ inv, diff)
+
+	else:
+		raise ValueError("distance_metric must be 'euclidean' or 'mahalanobis'.")
+
+	return np.argmin(dists, axis=1)
+
+def vae_anomaly_batch(rows: List[Dict[str, Any]], vae_pack: Dict[str, Any], eps: torch.Tensor) -> Tuple[np.ndarray, np.ndarray]:
+	"""vae_anomaly_for_row for the rows of one cluster, in one forward pass. eps holds the
+	reparameterization noise of each row, drawn as the per-row path draws it."""
+	X = _align_rows_for_scaler(rows, cols_expected=vae_pack["features"], scaler=vae_pack["scaler"])
+	x = torch.as_tensor(vae_pack["scaler"].transform(X), dtype=torch.float32)
+
+	with torch.inference_mode():
+		recon, _, _ = vae_pack["vae"](x, eps=eps)
+		rec_err = ((recon - x)**2).mean(dim=1).double().numpy()
+	return rec_err, (rec_err > vae_pack["threshold"]).astype(int)
+
+def infer_batch(rows: List[Dict[str, Any]], assigner: Dict[str, Any], vaes: Dict[int, Dict[str, Any]]) -> List[Tuple[int, Any, Any]]:
+	"""(cluster, rec_err, y_hat) of every row, rec_err/y_hat None if the cluster has no VAE pack.
+
+	The VAE noise is drawn row by row in arrival order, one (1, latent) draw per
+	scored row like the per-row path, so with the same torch seed the decisions
+	are the per-row ones; only the forward passes are batched per cluster."""
+	ks = assign_clusters_batch(rows, assigner)
+	eps = {}
+	for i, k in enumerate(ks):
+		if int(k) in vaes:
+			eps[i] = torch.randn((1, vaes[int(k)]["vae"].fc_mu.out_features), dtype=torch.float32)
+
+	results = [(int(k), None, None) for k in ks]
+	for k in sorted(set(int(k) for k in ks) & set(vaes)):
+		idx = [i for i in range(len(rows)) if ks[i] == k]
+		rec_err, y_hat = vae_anomaly_batch([rows[i] for i in idx], vaes[k], torch.cat([eps[i] for i in idx]))
+		for j, i in enumerate(idx):
+			results[i] = (k, float(rec_err[j]), int(y_hat[j]))
+	return results
+
+class InferenceStats:
+	"""Rows/s and per-batch latency of the inference, printed as [INFER] lines."""
+	def __init__(self, samples: int = 10_000):
+		self.samples = samples
+		self.rows = 0
+		self.batches = 0
+		self.busy = 0.0
+		self.latencies = []
+		self.started = time.monotonic()
+
+	def add(self, n_rows: int, seconds: float):
+		self.rows += n_rows
+		self.batches += 1
+		self.busy += seconds
+		if len(self.latencies) >= self.samples:
+			del self.latencies[:self.samples // 2]
+		self.latencies.append(seconds)
+
+	def summary(self) -> str:
+		if not self.latencies:
+			return "no batch yet"
+		lat = sorted(self.latencies)
+		return "rows={} batches={} mean_batch={:.1f} rows/s={:.0f} (busy {:.0f}) batch_ms p50={:.2f} p99={:.2f} max={:.2f}".format(
+			self.rows, self.batches, self.rows / self.batches,
+			self.rows / max(1e-9, time.monotonic() - self.started), self.rows / max(1e-9, self.busy),
+			1000 * lat[len(lat) // 2], 1000 * lat[min(len(lat) - 1, int(0.99 * len(lat)))], 1000 * lat[-1])
+
 # =========================
 # InfluxDB streaming (3 buckets)
 # =========================
-def query_influxdb():
+def _build_row(cu_point: dict, du_point: dict, cuup_point: dict) -> Dict[str, Any]:
+	"""Model input row of one joined (cu_cp, du, cu_up) triple."""
+	ueid = cu_point['ue_imsi_complete']
+	t = _fmt_time(cu_point['time'])
+
+	row = {
+		'ueid': ueid,
+		'time': t,
+
+		# CU-CP
+		'numActiveUes': cu_point.get('num_active_ues'),
+		'L3 serving SINR': cu_point.get('l3_serving_sinr'),
+		'L3 serving SINR 3gpp': cu_point.get('l3_serving_sinr_3gpp'),
+		'neighbor_id_1': cu_point.get('l3_neigh_id_1_cellid'),
+		'neighbor_id_2': cu_point.get('l3_neigh_id_2_cellid'),
+		'neighbor_id_3': cu_point.get('l3_neigh_id_3_cellid'),
+		'neighbor_sinr_1': cu_point.get('l3_neigh_sinr_1'),
+		'neighbor_sinr_2': cu_point.get('l3_neigh_sinr_2'),
+		'neighbor_sinr_3': cu_point.get('l3_neigh_sinr_3'),
+		'serving_cell_id': cu_point.get('l3_serving_id_m_cellid'),
+
+		# DU
+		'RRU.PrbUsedDl': du_point.get('rru_prb_used_dl'),
+		'TB.ErrTotalNbrDl.1': du_point.get('tb_err_total_nbr_dl_1'),
+		'DRB.UEThpDl.UEID': du_point.get('drb_uethp_dl_ueid'),
+
+		# CU-UP
+		'DRB.PdcpSduVolumeDl_Filter.UEID(txBytes)': cuup_point.get('drb_pdcp_sdu_volume_dl_filter_ueid_tx_bytes'),
+		'Tot.PdcpSduNbrDl.UEID(txDlPackets)': cuup_point.get('tot_pdcp_sdu_nbr_dl_ueid_tx_dl_packets'),
+		'DRB.PdcpSduDelayDl.UEID(pdcpLatency)': cuup_point.get('drb_pdcp_sdu_delay_dl_ueid_pdcp_latency'),
+	}
+
+	# soft-cast numerics
+	for k in [
+		'numActiveUes','L3 serving SINR','L3 serving SINR 3gpp',
+		'RRU.PrbUsedDl','TB.ErrTotalNbrDl.1',
+		'DRB.UEThpDl.UEID',
+		'DRB.PdcpSduVolumeDl_Filter.UEID(txBytes)',
+		'Tot.PdcpSduNbrDl.UEID(txDlPackets)',
+		'DRB.PdcpSduDelayDl.UEID(pdcpLatency)',
+		'serving_cell_id'
+	]:
+		v = row.get(k, None)
+		if v is not None:
+			try:
+				row[k] = float(v)
+			except Exception:
+				pass
+
+	return row
+
+def query_influxdb_batches():
 	"""
 	Streams joined rows from:
 	  - cu_cp_bucket
@@ -225,18 +383,19 @@ def query_influxdb():
 					  "tot_pdcp_sdu_nbr_dl_ueid_tx_dl_packets",
 					  "drb_pdcp_sdu_delay_dl_ueid_pdcp_latency"
 	Join key: (ue_imsi_complete, time)
+
+	Each poll pulls only the new points of the three buckets; rows are
+	joined incrementally over a bounded window (see stream_join.py) and
+	yielded as soon as their three sides have arrived, as one list per poll.
 	"""
 	client = InfluxDBClient(host='influxdb', port=8086, database='ns3_metrics')
-	last_time_seen = "1970-01-01T00:00:00.000000Z"
-
-	while True:
-		cu_query = f"""
+	source = InfluxJoinSource(client, {
+		"cu_cp": """
 			SELECT
 				num_active_ues,
 				l3_serving_sinr,
 				l3_serving_sinr_3gpp,
 				ue_imsi_complete,
-				time,
 				l3_neigh_id_1_cellid,
 				l3_neigh_id_2_cellid,
 				l3_neigh_id_3_cellid,
@@ -244,101 +403,31 @@ def query_influxdb():
 				l3_neigh_sinr_2,
 				l3_neigh_sinr_3,
 				l3_serving_id_m_cellid
-			FROM cu_cp_bucket
-			WHERE time > '{last_time_seen}'
-			ORDER BY time ASC
-		"""
-		cu_points = list(client.query(cu_query).get_points())
-
-		if not cu_points:
-			time.sleep(QUERY_INTERVAL)
-			continue
-
-		du_query = """
+			FROM cu_cp_bucket""",
+		"du": """
 			SELECT
 				"drb_uethp_dl_ueid",
 				rru_prb_used_dl,
 				tb_err_total_nbr_dl_1,
-				ue_imsi_complete,
-				time
-			FROM du_bucket
-			ORDER BY time ASC
-		"""
-		du_points = list(client.query(du_query).get_points())
-		du_lookup = {(p['ue_imsi_complete'], p['time']): p for p in du_points}
-
-		cuup_query = """
+				ue_imsi_complete
+			FROM du_bucket""",
+		"cu_up": """
 			SELECT
 				"drb_pdcp_sdu_volume_dl_filter_ueid_tx_bytes",
 				"tot_pdcp_sdu_nbr_dl_ueid_tx_dl_packets",
 				"drb_pdcp_sdu_delay_dl_ueid_pdcp_latency",
-				ue_imsi_complete,
-				time
-			FROM cu_up_bucket
-			ORDER BY time ASC
-		"""
-		cuup_points = list(client.query(cuup_query).get_points())
-		cuup_lookup = {(p['ue_imsi_complete'], p['time']): p for p in cuup_points}
-
-		for cu_point in cu_points:
-			ueid = cu_point['ue_imsi_complete']
-			t = cu_point['time']
-
-			if t > last_time_seen:
-				last_time_seen = t
-
-			du_point = du_lookup.get((ueid, t))
-			cuup_point = cuup_lookup.get((ueid, t))
-			if not du_point or not cuup_point:
-				continue
-
-			row = {
-				'ueid': ueid,
-				'time': t,
-
-				# CU-CP
-				'numActiveUes': cu_point.get('num_active_ues'),
-				'L3 serving SINR': cu_point.get('l3_serving_sinr'),
-				'L3 serving SINR 3gpp': cu_point.get('l3_serving_sinr_3gpp'),
-				'neighbor_id_1': cu_point.get('l3_neigh_id_1_cellid'),
-				'neighbor_id_2': cu_point.get('l3_neigh_id_2_cellid'),
-				'neighbor_id_3': cu_point.get('l3_neigh_id_3_cellid'),
-				'neighbor_sinr_1': cu_point.get('l3_neigh_sinr_1'),
-				'neighbor_sinr_2': cu_point.get('l3_neigh_sinr_2'),
-				'neighbor_sinr_3': cu_point.get('l3_neigh_sinr_3'),
-				'serving_cell_id': cu_point.get('l3_serving_id_m_cellid'),
-
-				# DU
-				'RRU.PrbUsedDl': du_point.get('rru_prb_used_dl'),
-				'TB.ErrTotalNbrDl.1': du_point.get('tb_err_total_nbr_dl_1'),
-				'DRB.UEThpDl.UEID': du_point.get('drb_uethp_dl_ueid'),
-
-				# CU-UP
-				'DRB.PdcpSduVolumeDl_Filter.UEID(txBytes)': cuup_point.get('drb_pdcp_sdu_volume_dl_filter_ueid_tx_bytes'),
-				'Tot.PdcpSduNbrDl.UEID(txDlPackets)': cuup_point.get('tot_pdcp_sdu_nbr_dl_ueid_tx_dl_packets'),
-				'DRB.PdcpSduDelayDl.UEID(pdcpLatency)': cuup_point.get('drb_pdcp_sdu_delay_dl_ueid_pdcp_latency'),
-			}
-
-			# soft-cast numerics
-			for k in [
-				'numActiveUes','L3 serving SINR','L3 serving SINR 3gpp',
-				'RRU.PrbUsedDl','TB.ErrTotalNbrDl.1',
-				'DRB.UEThpDl.UEID',
-				'DRB.PdcpSduVolumeDl_Filter.UEID(txBytes)',
-				'Tot.PdcpSduNbrDl.UEID(txDlPackets)',
-				'DRB.PdcpSduDelayDl.UEID(pdcpLatency)',
-				'serving_cell_id'
-			]:
-				v = row.get(k, None)
-				if v is not None:
-					try:
-						row[k] = float(v)
-					except Exception:
-						pass
+				ue_imsi_complete
+			FROM cu_up_bucket""",
+	}, StreamJoin(window_ns=JOIN_WINDOW_NS))
 
-			yield row
+	for joined in source.stream_batches(QUERY_INTERVAL, stats_every=JOIN_STATS_EVERY):
+		yield [_build_row(*triple) for triple in joined]
 
-		time.sleep(QUERY_INTERVAL)
+def query_influxdb():
+	"""Same rows as query_influxdb_batches, one at a time."""
+	for rows in query_influxdb_batches():
+		for row in rows:
+			yield row
 
 # =========================
 # Dry-run
@@ -373,10 +462,42 @@ def dry_run_once():
 			return
 		rec_err, y_hat = vae_anomaly_for_row(row, vaes[k])
 		print("[DRY] rec_err={:.6f}  thr={:.6f}  pred={}".format(rec_err, vaes[k]['threshold'], y_hat))
+
+		if BATCH_INFERENCE:
+			check_batch_against_rows(row, assigner, vaes)
 	except Exception as e:
 		print("[DRY][ERROR]", e)
 		traceback.print_exc()
 
+def check_batch_against_rows(row: Dict[str, Any], assigner: Dict[str, Any], vaes: Dict[int, Dict[str, Any]], n: int = 256):
+	"""Scores n perturbed copies of row per-row and batched from the same torch RNG state and compares the decisions."""
+	rng = np.random.RandomState(0)
+	rows = []
+	for _ in range(n):
+		r = dict(row)
+		for c in r:
+			if isinstance(r[c], float):
+				r[c] = r[c] * float(rng.lognormal(0.0, 1.0)) + float(rng.normal(0.0, 5.0))
+		rows.append(r)
+
+	state = torch.get_rng_state()
+	t0 = time.perf_counter()
+	per_row = []
+	for r in rows:
+		k = assign_cluster_for_row(r, assigner)
+		per_row.append((k,) + vae_anomaly_for_row(r, vaes[k]) if k in vaes else (k, None, None))
+	t1 = time.perf_counter()
+	torch.set_rng_state(state)
+	batched = infer_batch(rows, assigner, vaes)
+	t2 = time.perf_counter()
+
+	same_k = sum(a[0] == b[0] for a, b in zip(per_row, batched))
+	same_y = sum(a[2] == b[2] for a, b in zip(per_row, batched))
+	max_diff = max([abs(a[1] - b[1]) for a, b in zip(per_row, batched) if a[1] is not None and b[1] is not None] or [0.0])
+	print("[DRY] batch check: {} rows | clusters equal {}/{} | decisions equal {}/{} | max |rec_err diff| {:.2e} | "
+		  "per-row {:.0f} rows/s, batched {:.0f} rows/s".format(
+			n, same_k, n, same_y, n, max_diff, n / max(1e-9, t1 - t0), n / max(1e-9, t2 - t1)))
+
 # =========================
 # Main
 # =========================
@@ -411,84 +532,109 @@ def main():
 		print("Time                          | UEID   | Cluster |  rec_err  |    thr   | ServingSINR | Neigh( id:sinr, ... )")
 		print("-" * 130)
 
-		for row in query_influxdb():
-			try:
-				if DEBUG:
-					print("[ROW] keys:", list(row.keys())[:8], "... total:", len(row))
-
-				k = assign_cluster_for_row(row, assigner)
-				if k not in vaes:
+		stats = InferenceStats()
+		last_stats = time.monotonic()
+		for batch in query_influxdb_batches():
+			results = None
+			if BATCH_INFERENCE:
+				try:
+					t0 = time.perf_counter()
+					results = infer_batch(batch, assigner, vaes)
+					stats.add(len(batch), time.perf_counter() - t0)
+				except Exception as batch_e:
+					print("[ERROR] Batch inference error, scoring per row:", batch_e)
+					traceback.print_exc()
+					results = None
+
+			if time.monotonic() - last_stats >= JOIN_STATS_EVERY:
+				last_stats = time.monotonic()
+				print("[INFER] " + stats.summary())
+
+			for index, row in enumerate(batch):
+				try:
 					if DEBUG:
-						print("[WARN] No VAE pack for cluster {}. Skipping row.".format(k))
-					continue
+						print("[ROW] keys:", list(row.keys())[:8], "... total:", len(row))
 
-				rec_err, y_hat = vae_anomaly_for_row(row, vaes[k])
-				thr = vaes[k]['threshold']
-
-				serving_sinr = row.get('L3 serving SINR', None)
-				s_sinr_str = "{:.2f}".format(serving_sinr) if isinstance(serving_sinr, (int, float)) else "N/A"
-				neigh_str = "{}:{}, {}:{}, {}:{}".format(
-					row.get('neighbor_id_1'), row.get('neighbor_sinr_1'),
-					row.get('neighbor_id_2'), row.get('neighbor_sinr_2'),
-					row.get('neighbor_id_3'), row.get('neighbor_sinr_3')
-				)
+					if results is not None:
+						k, rec_err, y_hat = results[index]
+					else:
+						t0 = time.perf_counter()
+						k = assign_cluster_for_row(row, assigner)
+					if k not in vaes:
+						if DEBUG:
+							print("[WARN] No VAE pack for cluster {}. Skipping row.".format(k))
+						continue
+
+					if results is None:
+						rec_err, y_hat = vae_anomaly_for_row(row, vaes[k])
+						stats.add(1, time.perf_counter() - t0)
+					thr = vaes[k]['threshold']
+
+					serving_sinr = row.get('L3 serving SINR', None)
+					s_sinr_str = "{:.2f}".format(serving_sinr) if isinstance(serving_sinr, (int, float)) else "N/A"
+					neigh_str = "{}:{}, {}:{}, {}:{}".format(
+						row.get('neighbor_id_1'), row.get('neighbor_sinr_1'),
+						row.get('neighbor_id_2'), row.get('neighbor_sinr_2'),
+						row.get('neighbor_id_3'), row.get('neighbor_sinr_3')
+					)
 
-				print("{} | {:6d} | {:^7d} | {:9.4f} | {:9.4f} | {:>11} | {}".format(
-					row['time'], int(row['ueid']), k, rec_err, thr, s_sinr_str, neigh_str))
+					print("{} | {:6d} | {:^7d} | {:9.4f} | {:9.4f} | {:>11} | {}".format(
+						row['time'], int(row['ueid']), k, rec_err, thr, s_sinr_str, neigh_str))
 
-				if y_hat == 1:
+					if y_hat == 1:
 
-					print(
-						"\n[ALERT] UE {} anomalous at {} (cluster={}, rec_err={:.4f}, thr={:.4f}); "
-						"ServingSINR={}; Neigh={}\n".format(
-							int(row['ueid']), row['time'], k, rec_err, thr, s_sinr_str, neigh_str
+						print(
+							"\n[ALERT] UE {} anomalous at {} (cluster={}, rec_err={:.4f}, thr={:.4f}); "
+							"ServingSINR={}; Neigh={}\n".format(
+								int(row['ueid']), row['time'], k, rec_err, thr, s_sinr_str, neigh_str
+							)
 						)
-					)
 
-					expected_cell = CLUSTER_TO_CELLID.get(int(k))
-					current_cell = row.get('serving_cell_id', None)
+						expected_cell = CLUSTER_TO_CELLID.get(int(k))
+						current_cell = row.get('serving_cell_id', None)
 
-					try:
-						current_cell = int(float(current_cell)) if current_cell is not None else None
-					except Exception:
-						current_cell = None
+						try:
+							current_cell = int(float(current_cell)) if current_cell is not None else None
+						except Exception:
+							current_cell = None
 
-					if current_cell is None or expected_cell is None:
-						if DEBUG:
-							print(f"[SKIP-LOG] UE {int(row['ueid'])}: missing cell info "
-								  f"(current_cell={current_cell}, expected_cell={expected_cell})")
-					else:
-						if current_cell != int(expected_cell):
-							log_line = (
-								"Mismatch: UE ID {ueid} | time {t} | "
-								"Cluster={k}({kname}) -> expected CellID {exp}({expn}) | "
-								"Current CellID {cur}({curn})"
-							).format(
-								ueid=int(row['ueid']),
-								t=row['time'],
-								k=int(k), kname=CLUSTER_NAME.get(int(k), "unknown"),
-								exp=int(expected_cell), expn=CELLID_NAME.get(int(expected_cell), "unknown"),
-								cur=int(current_cell), curn=CELLID_NAME.get(int(current_cell), "unknown"),
-							)
-							logging.warning(log_line)
+						if current_cell is None or expected_cell is None:
 							if DEBUG:
-								print("[LOGGED] " + log_line)
+								print(f"[SKIP-LOG] UE {int(row['ueid'])}: missing cell info "
+									  f"(current_cell={current_cell}, expected_cell={expected_cell})")
 						else:
-							if DEBUG:
-								print(f"[OK-MATCH] UE {int(row['ueid'])}: cluster {k} ↔ CellID {current_cell} "
-									  f"({CELLID_NAME.get(int(current_cell), 'unknown')})")
-
-				time.sleep(QUERY_INTERVAL)
-
-			except Exception as inner_e:
-				print("[ERROR] Iteration error:", inner_e)
-				traceback.print_exc()
-				try:
-					from pprint import pformat
-					print("[ERROR] Offending row dump:\n", pformat(row))
-				except Exception:
-					pass
-				time.sleep(0.5)
+							if current_cell != int(expected_cell):
+								log_line = (
+									"Mismatch: UE ID {ueid} | time {t} | "
+									"Cluster={k}({kname}) -> expected CellID {exp}({expn}) | "
+									"Current CellID {cur}({curn})"
+								).format(
+									ueid=int(row['ueid']),
+									t=row['time'],
+									k=int(k), kname=CLUSTER_NAME.get(int(k), "unknown"),
+									exp=int(expected_cell), expn=CELLID_NAME.get(int(expected_cell), "unknown"),
+									cur=int(current_cell), curn=CELLID_NAME.get(int(current_cell), "unknown"),
+								)
+								logging.warning(log_line)
+								if DEBUG:
+									print("[LOGGED] " + log_line)
+							else:
+								if DEBUG:
+									print(f"[OK-MATCH] UE {int(row['ueid'])}: cluster {k} ↔ CellID {current_cell} "
+										  f"({CELLID_NAME.get(int(current_cell), 'unknown')})")
+
+					if not BATCH_INFERENCE:
+						time.sleep(QUERY_INTERVAL)
+
+				except Exception as inner_e:
+					print("[ERROR] Iteration error:", inner_e)
+					traceback.print_exc()
+					try:
+						from pprint import pformat
+						print("[ERROR] Offending row dump:\n", pformat(row))
+					except Exception:
+						pass
+					time.sleep(0.5)
 
 	except KeyboardInterrupt:
 		print("\nShutting down...")
@@ -0,0 +1,65 @@
+import sys
+import time
+import argparse
+import threading
+from concurrent import futures
+
+import grpc
+
+from rc_control_client import METHOD, decode_control_request, encode_control_response
+
+# Stand-in for the RC xApp rc.MsgComm service, to test ts-final-tested.py
+# without a RIC: every SendRICControlReqServiceGrpc request is decoded,
+# printed and acknowledged with rspCode 0 after --delay seconds.
+
+
+class MockRcServicer:
+    def __init__(self, delay: float, quiet: bool):
+        self.delay = delay
+        self.quiet = quiet
+        self.requests = []
+        self._lock = threading.Lock()
+
+    def send_ric_control(self, request: dict, context) -> bytes:
+        if self.delay:
+            time.sleep(self.delay)
+        with self._lock:
+            self.requests.append((time.time(), request))
+        if not self.quiet:
+            print("[MOCK] UEID {} -> TargetCellID {}".format(
+                request["RICControlHeaderData"]["UEID"],
+                request["RICControlMessageData"]["TargetCellID"]), flush=True)
+        return encode_control_response(0, "mock: control request accepted")
+
+
+def serve(port: int, delay: float = 0.0, quiet: bool = False, workers: int = 16):
+    """Starts the mock server; returns (server, servicer, bound port)."""
+    servicer = MockRcServicer(delay, quiet)
+    service, method = METHOD.strip("/").split("/")
+    handler = grpc.method_handlers_generic_handler(service, {
+        method: grpc.unary_unary_rpc_method_handler(
+            servicer.send_ric_control,
+            request_deserializer=decode_control_request,
+            response_serializer=lambda response: response)})
+    server = grpc.server(futures.ThreadPoolExecutor(max_workers=workers))
+    server.add_generic_rpc_handlers((handler,))
+    bound_port = server.add_insecure_port(f"[::]:{port}")
+    server.start()
+    return server, servicer, bound_port
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Mock RC xApp gRPC endpoint (rc.MsgComm).")
+    parser.add_argument("--port", type=int, default=7777)
+    parser.add_argument("--delay", type=float, default=0.0, help="processing delay per request [s]")
+    parser.add_argument("--quiet", action="store_true")
+    args = parser.parse_args()
+
+    server, servicer, port = serve(args.port, args.delay, args.quiet)
+    print(f"[MOCK] rc.MsgComm listening on port {port}", flush=True)
+    try:
+        server.wait_for_termination()
+    except KeyboardInterrupt:
+        print(f"\n[MOCK] {len(servicer.requests)} requests received")
+        server.stop(0)
+        sys.exit(0)
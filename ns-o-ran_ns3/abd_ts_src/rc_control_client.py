@@ -0,0 +1,236 @@
+import time
+import subprocess
+from typing import Dict, List, Optional, Tuple
+
+try:
+    import grpc
+except ImportError:  # grpcurl fallback only
+    grpc = None
+
+# --------------------------
+# rc.proto messages (RC xApp, rc.MsgComm service)
+# --------------------------
+# The messages are encoded by hand so the client needs only grpcio, not the
+# generated stubs. Field numbers follow rc.proto of the RC xApp:
+#
+#   RicControlGrpcReq    { string e2NodeID = 1; string plmnID = 2; string ranName = 3;
+#                          RICE2APHeader RICE2APHeaderData = 4;
+#                          RICControlHeader RICControlHeaderData = 5;
+#                          RICControlMessage RICControlMessageData = 6;
+#                          RICControlAckEnum RICControlAckReqVal = 7; }
+#   RICE2APHeader        { int64 RanFuncId = 1; int64 RICRequestorID = 2; }
+#   RICControlHeader     { int64 ControlStyle = 1; int64 ControlActionId = 2; string UEID = 3; }
+#   RICControlMessage    { RICControlCellTypeEnum RICControlCellTypeVal = 1; string TargetCellID = 2; }
+#   RicControlGrpcRsp    { int32 rspCode = 1; string description = 2; }
+
+METHOD = "/rc.MsgComm/SendRICControlReqServiceGrpc"
+
+
+def _varint(value: int) -> bytes:
+    value &= (1 << 64) - 1  # negative int64 as two's complement
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def _int_field(number: int, value: int) -> bytes:
+    # proto3: default values are not serialized
+    return _varint(number << 3) + _varint(value) if value else b""
+
+
+def _bytes_field(number: int, value: bytes) -> bytes:
+    return _varint((number << 3) | 2) + _varint(len(value)) + value if value else b""
+
+
+def _str_field(number: int, value: str) -> bytes:
+    return _bytes_field(number, value.encode("utf-8"))
+
+
+def encode_control_request(request: dict) -> bytes:
+    """Serializes a RicControlGrpcReq given as the JSON-style dict grpcurl takes."""
+    e2ap = request.get("RICE2APHeaderData", {})
+    header = request.get("RICControlHeaderData", {})
+    message = request.get("RICControlMessageData", {})
+    return (_str_field(1, request.get("e2NodeID", ""))
+            + _str_field(2, request.get("plmnID", ""))
+            + _str_field(3, request.get("ranName", ""))
+            + _bytes_field(4, _int_field(1, int(e2ap.get("RanFuncId", 0)))
+                           + _int_field(2, int(e2ap.get("RICRequestorID", 0))))
+            + _bytes_field(5, _int_field(1, int(header.get("ControlStyle", 0)))
+                           + _int_field(2, int(header.get("ControlActionId", 0)))
+                           + _str_field(3, header.get("UEID", "")))
+            + _bytes_field(6, _int_field(1, int(message.get("RICControlCellTypeVal", 0)))
+                           + _str_field(2, message.get("TargetCellID", "")))
+            + _int_field(7, int(request.get("RICControlAckReqVal", 0))))
+
+
+def _read_varint(data: bytes, pos: int) -> Tuple[int, int]:
+    result = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        result |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return result, pos
+        shift += 7
+
+
+def decode_fields(data: bytes) -> Dict[int, object]:
+    """Generic decoder: field number -> int (varint) or bytes (length-delimited). Last value wins."""
+    fields = {}
+    pos = 0
+    while pos < len(data):
+        key, pos = _read_varint(data, pos)
+        number, wire_type = key >> 3, key & 7
+        if wire_type == 0:
+            fields[number], pos = _read_varint(data, pos)
+        elif wire_type == 2:
+            length, pos = _read_varint(data, pos)
+            fields[number] = data[pos:pos + length]
+            pos += length
+        elif wire_type == 1:
+            fields[number] = data[pos:pos + 8]
+            pos += 8
+        elif wire_type == 5:
+            fields[number] = data[pos:pos + 4]
+            pos += 4
+        else:
+            raise ValueError(f"unsupported wire type {wire_type}")
+    return fields
+
+
+def decode_control_request(data: bytes) -> dict:
+    """Inverse of encode_control_request (used by the mock server)."""
+    fields = decode_fields(data)
+    text = lambda value: value.decode("utf-8") if isinstance(value, bytes) else ""
+    e2ap = decode_fields(fields.get(4, b""))
+    header = decode_fields(fields.get(5, b""))
+    message = decode_fields(fields.get(6, b""))
+    return {
+        "e2NodeID": text(fields.get(1)),
+        "plmnID": text(fields.get(2)),
+        "ranName": text(fields.get(3)),
+        "RICE2APHeaderData": {"RanFuncId": e2ap.get(1, 0), "RICRequestorID": e2ap.get(2, 0)},
+        "RICControlHeaderData": {"ControlStyle": header.get(1, 0), "ControlActionId": header.get(2, 0),
+                                 "UEID": text(header.get(3))},
+        "RICControlMessageData": {"RICControlCellTypeVal": message.get(1, 0),
+                                  "TargetCellID": text(message.get(2))},
+        "RICControlAckReqVal": fields.get(7, 0),
+    }
+
+
+def encode_control_response(code: int, description: str) -> bytes:
+    return _int_field(1, code) + _str_field(2, description)
+
+
+def decode_control_response(data: bytes) -> Tuple[int, str]:
+    fields = decode_fields(data)
+    code = fields.get(1, 0)
+    if code >= 1 << 31:  # negative int32
+        code -= 1 << 64
+    description = fields.get(2, b"")
+    return code, description.decode("utf-8", errors="replace") if isinstance(description, bytes) else ""
+
+
+# --------------------------
+# Client
+# --------------------------
+class RcControlClient:
+    """
+    Long-lived client of the RC xApp gRPC endpoint.
+
+    One channel (one HTTP/2 connection) is opened at start-up and reused for
+    every request; send_batch issues all its requests before waiting for any
+    answer, so a batch of handovers costs about one round trip. If grpcio is
+    not installed, or use_grpcurl is set, every request falls back to one
+    grpcurl process, as before.
+    """
+
+    def __init__(self, address: str, request_fields: dict, timeout: float = 2.0,
+                 use_grpcurl: bool = False, grpcurl_path: str = "grpcurl"):
+        self.address = address
+        self.request_fields = request_fields
+        self.timeout = timeout
+        self.grpcurl_path = grpcurl_path
+        self.use_grpcurl = use_grpcurl or grpc is None
+        self._channel = None
+        self._call = None
+        if not self.use_grpcurl:
+            self._channel = grpc.insecure_channel(address, options=[
+                ("grpc.keepalive_time_ms", 10000),
+                ("grpc.keepalive_permit_without_calls", 1)])
+            self._call = self._channel.unary_unary(
+                METHOD,
+                request_serializer=encode_control_request,
+                response_deserializer=decode_control_response)
+
+    def build_request(self, ueid: str, target_cell: str) -> dict:
+        request = {key: (dict(value) if isinstance(value, dict) else value)
+                   for key, value in self.request_fields.items()}
+        request.setdefault("RICControlHeaderData", {})["UEID"] = ueid
+        request.setdefault("RICControlMessageData", {})["TargetCellID"] = target_cell
+        return request
+
+    def wait_ready(self, timeout: float) -> bool:
+        """Connects the channel ahead of the first request."""
+        if self.use_grpcurl:
+            return True
+        try:
+            grpc.channel_ready_future(self._channel).result(timeout=timeout)
+            return True
+        except grpc.FutureTimeoutError:
+            return False
+
+    def send_batch(self, requests: List[Tuple[str, str]]) -> List[dict]:
+        """
+        Sends (ueid, target cell) handover requests. Returns one result per
+        request: ueid, target_cell, sent_at / acked_at (time.time()), code,
+        description, error (None on success).
+        """
+        if self.use_grpcurl:
+            return [self._send_grpcurl(ueid, target) for ueid, target in requests]
+
+        pending = []
+        for ueid, target in requests:
+            sent_at = time.time()
+            future = self._call.future(self.build_request(ueid, target), timeout=self.timeout)
+            pending.append((ueid, target, sent_at, future))
+
+        results = []
+        for ueid, target, sent_at, future in pending:
+            result = {"ueid": ueid, "target_cell": target, "sent_at": sent_at,
+                      "acked_at": None, "code": None, "description": "", "error": None}
+            try:
+                result["code"], result["description"] = future.result()
+            except grpc.RpcError as error:
+                result["error"] = f"{error.code().name}: {error.details()}"
+            result["acked_at"] = time.time()
+            results.append(result)
+        return results
+
+    def _send_grpcurl(self, ueid: str, target: str) -> dict:
+        import json
+        sent_at = time.time()
+        result = {"ueid": ueid, "target_cell": target, "sent_at": sent_at,
+                  "acked_at": None, "code": None, "description": "", "error": None}
+        try:
+            completed = subprocess.run(
+                [self.grpcurl_path, "-plaintext", "-d", json.dumps(self.build_request(ueid, target)),
+                 self.address, METHOD.strip("/").replace("/", ".")],
+                check=True, capture_output=True, text=True, timeout=self.timeout + 5)
+            result["description"] = completed.stdout.strip()
+            result["code"] = 0
+        except (subprocess.CalledProcessError, subprocess.TimeoutExpired, OSError) as error:
+            result["error"] = str(error)
+        result["acked_at"] = time.time()
+        return result
+
+    def close(self):
+        if self._channel is not None:
+            self._channel.close()
@@ -0,0 +1,228 @@
+# stream_join.py -- incremental (UE, timestamp) join of the cu_cp, du and cu_up buckets
+# for the ABD xApp. Only new points are pulled from InfluxDB; the join state is a
+# bounded window, so the cost of a poll does not grow with the length of the run.
+
+import time
+from collections import OrderedDict
+from typing import Dict, Iterator, List, Optional, Tuple
+
+SIDES = ("cu_cp", "du", "cu_up")
+
+
+class StreamJoin:
+
+	"""
+	Joins points of the three sides on (ue, time) as they arrive.
+
+	A key is emitted as soon as its three sides are present. Keys older than window_ns behind the newest time seen (the watermark), or beyond max_keys, are evicted; evicted keys that never completed are counted as unmatched, per missing side. Emitted keys stay in the index until evicted, so a point delivered twice (overlapping polls) is ignored.
+
+	Attributes
+	----------
+	window_ns : int
+		Width of the join window behind the watermark, in ns.
+
+	max_keys : int
+		Largest number of keys kept in the index.
+
+	watermark : int
+		Newest point time seen, in ns.
+
+	counters : dict
+		Points, duplicates, late points, joined and unmatched keys, and missing sides of the unmatched keys.
+
+	Methods
+	-------
+	add(side, ue, t_ns, point)
+		Adds one point and returns its joined triple once the three sides are present.
+
+	evict()
+		Drops the keys that left the window or exceed max_keys.
+
+	stats()
+		Counters, pending keys and join lag percentiles.
+	"""
+
+	def __init__(self, window_ns: int = 5_000_000_000, max_keys: int = 200_000, lag_samples: int = 10_000):
+
+		"""
+		Initializes the class
+		"""
+
+		self.window_ns = int(window_ns)
+		self.max_keys = int(max_keys)
+		self.lag_samples = int(lag_samples)
+		# key -> [cu_cp, du, cu_up, first arrival (monotonic), emitted]
+		self._index: "OrderedDict[Tuple[str, int], list]" = OrderedDict()
+		self._lags: List[float] = []
+		self.watermark = 0
+		self.counters = {"points": 0, "duplicates": 0, "late": 0, "joined": 0,
+						 "unmatched": 0, "missing_cu_cp": 0, "missing_du": 0, "missing_cu_up": 0}
+
+	def add(self, side: str, ue, t_ns: int, point: dict) -> Optional[Tuple[dict, dict, dict]]:
+
+		"""
+		Adds one point; returns (cu_cp, du, cu_up) if it completes its key.
+		"""
+
+		slot = SIDES.index(side)
+		t_ns = int(t_ns)
+		self.counters["points"] += 1
+
+		if t_ns < self.watermark - self.window_ns:
+			self.counters["late"] += 1
+			return None
+
+		key = (str(ue), t_ns)
+		entry = self._index.get(key)
+		if entry is None:
+			entry = [None, None, None, time.monotonic(), False]
+			self._index[key] = entry
+		if entry[4] or entry[slot] is not None:
+			self.counters["duplicates"] += 1
+			return None
+		entry[slot] = point
+
+		if t_ns > self.watermark:
+			self.watermark = t_ns
+
+		if entry[0] is not None and entry[1] is not None and entry[2] is not None:
+			entry[4] = True
+			self.counters["joined"] += 1
+			if len(self._lags) >= self.lag_samples:
+				del self._lags[:self.lag_samples // 2]
+			self._lags.append(time.monotonic() - entry[3])
+			joined = (entry[0], entry[1], entry[2])
+			entry[0] = entry[1] = entry[2] = None   # keep only the emitted marker
+			return joined
+		return None
+
+	def evict(self) -> int:
+
+		"""
+		Drops the keys outside the window, and the oldest ones beyond max_keys; returns how many were dropped.
+
+		Keys are inserted in arrival order, which follows time order up to the span of one poll (a point older than the window is rejected by add), so only the front of the index is visited: a poll costs the keys it drops, not the size of the window. A key inserted behind a newer one leaves when that one does.
+		"""
+
+		horizon = self.watermark - self.window_ns
+		dropped = 0
+		while self._index:
+			key = next(iter(self._index))
+			if key[1] >= horizon and len(self._index) <= self.max_keys:
+				break
+			self._drop(key)
+			dropped += 1
+		return dropped
+
+	def _drop(self, key):
+
+		entry = self._index.pop(key)
+		if entry[4]:
+			return
+		self.counters["unmatched"] += 1
+		for slot, side in enumerate(SIDES):
+			if entry[slot] is None:
+				self.counters["missing_" + side] += 1
+
+	def stats(self) -> dict:
+
+		"""
+		Counters, index size and join lag (first side -> last side, wall clock) in ms.
+		"""
+
+		stats = dict(self.counters)
+		stats["pending"] = sum(1 for entry in self._index.values() if not entry[4])
+		if self._lags:
+			lags = sorted(self._lags)
+			stats["lag_ms_p50"] = round(1000 * lags[len(lags) // 2], 3)
+			stats["lag_ms_p99"] = round(1000 * lags[min(len(lags) - 1, int(0.99 * len(lags)))], 3)
+			stats["lag_ms_max"] = round(1000 * lags[-1], 3)
+		return stats
+
+
+class InfluxJoinSource:
+
+	"""
+	Polls only the new points of each measurement (time > last time seen on that measurement, minus a small overlap for points written out of order) and feeds them to a StreamJoin. Times are requested as integer ns, so the bookmarks compare exactly.
+
+	Attributes
+	----------
+	queries : Dict[str, str]
+		SELECT ... FROM ... of every side, without WHERE / ORDER BY.
+
+	overlap_ns : int
+		How far before the last time seen each poll starts again, in ns.
+
+	last_seen : Dict[str, int]
+		Newest point time seen per side, in ns.
+
+	Methods
+	-------
+	poll()
+		One round over the three measurements; returns the newly joined triples.
+
+	stream_batches(interval, stats_every)
+		Polls forever, yielding the triples joined by each poll as one list.
+
+	stream(interval, stats_every)
+		Like stream_batches, one triple at a time.
+	"""
+
+	def __init__(self, client, queries: Dict[str, str], join: StreamJoin, overlap_ns: int = 500_000_000):
+
+		"""
+		Initializes the class
+		"""
+
+		self.client = client
+		self.queries = queries
+		self.join = join
+		self.overlap_ns = int(overlap_ns)
+		self.last_seen = {side: 0 for side in SIDES}
+
+	def poll(self) -> List[Tuple[dict, dict, dict]]:
+
+		"""
+		One round over the three measurements; returns the newly joined triples.
+		"""
+
+		joined = []
+		for side in SIDES:
+			since = max(0, self.last_seen[side] - self.overlap_ns)
+			query = f"{self.queries[side]} WHERE time > {since} ORDER BY time ASC"
+			for point in self.client.query(query, epoch="ns").get_points():
+				t_ns = int(point["time"])
+				if t_ns > self.last_seen[side]:
+					self.last_seen[side] = t_ns
+				result = self.join.add(side, point["ue_imsi_complete"], t_ns, point)
+				if result is not None:
+					joined.append(result)
+		self.join.evict()
+		return joined
+
+	def stream_batches(self, interval: float, stats_every: float = 0) -> Iterator[List[Tuple[dict, dict, dict]]]:
+
+		"""
+		Polls forever, yielding the joined triples of each poll as one list; prints the join stats every stats_every seconds.
+		"""
+
+		last_stats = time.monotonic()
+		while True:
+			joined = self.poll()
+			if joined:
+				yield joined
+			if stats_every and time.monotonic() - last_stats >= stats_every:
+				last_stats = time.monotonic()
+				print("[JOIN] {}".format(self.join.stats()))
+			if not joined:
+				time.sleep(interval)
+
+	def stream(self, interval: float, stats_every: float = 0) -> Iterator[Tuple[dict, dict, dict]]:
+
+		"""
+		Like stream_batches, one triple at a time.
+		"""
+
+		for joined in self.stream_batches(interval, stats_every):
+			for triple in joined:
+				yield triple
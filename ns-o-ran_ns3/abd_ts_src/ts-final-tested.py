@@ -1,135 +1,200 @@
 import re
 import os
+import csv
 import time
-import subprocess
+from datetime import datetime
+
+from rc_control_client import RcControlClient
 
 # --------------------------
 # Configuration
 # --------------------------
 LOG_FILE = 'anomalies.log'
-LINES_TO_CHECK = 50          # Process 50-line batches
-CHECK_INTERVAL = 2           # seconds between polls
+POLL_INTERVAL = 0.05         # seconds between reads of new log lines
+LATENCY_FILE = 'control_latency.csv'
+
+# RC xApp gRPC endpoint; TS_CONTROL_MODE=grpcurl sends each request with a grpcurl process instead
+RC_XAPP_ADDR = os.environ.get("RC_XAPP_ADDR", "10.244.0.26:7777")
+CONTROL_MODE = os.environ.get("TS_CONTROL_MODE", "grpc")
+GRPCURL_PATH = "grpcurl"
 
 # Regex to parse new "Mismatch:" lines produced by AD
 MISMATCH_REGEX = re.compile(
     r'Mismatch:\s*UE ID\s*([0-9.]+)\s*\|\s*time\s*([^\|]+)\|\s*Cluster=\d+\([^)]+\)\s*->\s*expected CellID\s*(\d+)\([^)]+\)\s*\|\s*Current CellID\s*(\d+)\([^)]+\)',
     re.IGNORECASE
 )
-
-# gRPC command template (unchanged)
-GRPCURL_PATH = "grpcurl"
-COMMAND_TEMPLATE = '''{grpcurl} -plaintext -d "{{ \\
-    \\"e2NodeID\\": \\"36000000\\", \\
-    \\"plmnID\\": \\"313131\\", \\
-    \\"ranName\\": \\"gnb_131_133_31000000\\", \\
-    \\"RICE2APHeaderData\\": {{ \\
-        \\"RanFuncId\\": 300, \\
-        \\"RICRequestorID\\": 1001 \\
-    }}, \\
-    \\"RICControlHeaderData\\": {{ \\
-        \\"ControlStyle\\": 3, \\
-        \\"ControlActionId\\": 1, \\
-        \\"UEID\\": \\"{ueid}\\" \\
-    }}, \\
-    \\"RICControlMessageData\\": {{ \\
-        \\"RICControlCellTypeVal\\": 4, \\
-        \\"TargetCellID\\": \\"{target_cell}\\" \\
-    }}, \\
-    \\"RICControlAckReqVal\\": 0 \\
-}}" 10.244.0.26:7777 rc.MsgComm.SendRICControlReqServiceGrpc'''
+# asctime prefix of the AD log lines: the detection time
+ASCTIME_REGEX = re.compile(r'^(\d{4}-\d{2}-\d{2} \d{2}:\d{2}:\d{2},\d{3})')
+
+# RicControlGrpcReq fields (UEID and TargetCellID are set per request)
+REQUEST_FIELDS = {
+    "e2NodeID": "36000000",
+    "plmnID": "313131",
+    "ranName": "gnb_131_133_31000000",
+    "RICE2APHeaderData": {
+        "RanFuncId": 300,
+        "RICRequestorID": 1001
+    },
+    "RICControlHeaderData": {
+        "ControlStyle": 3,
+        "ControlActionId": 1
+    },
+    "RICControlMessageData": {
+        "RICControlCellTypeVal": 4
+    },
+    "RICControlAckReqVal": 0
+}
 
 def compute_target_cell(cell_id: int) -> str:
     return f"1110{int(cell_id)}"
 
 # --------------------------
-# Run gRPC Command
+# AD log stream
 # --------------------------
-def run_grpc_command_for_slice(ueid: int, expected_cell_id: int):
-    formatted_ueid = f"{ueid:05d}"
-    target_cell = compute_target_cell(expected_cell_id)
-
-    print(f"[INFO] Handover request → UEID={formatted_ueid} to TargetCellID={target_cell} (expected slice cell {expected_cell_id})")
+class LogFollower:
+    """Returns the complete lines appended to a file since the previous call."""
+
+    def __init__(self, path: str):
+        self.path = path
+        self.offset = 0
+        self.partial = ""
+
+    def read_new_lines(self):
+        try:
+            size = os.path.getsize(self.path)
+        except OSError:
+            return []
+        if size < self.offset:  # truncated or recreated
+            self.offset, self.partial = 0, ""
+        if size == self.offset:
+            return []
+        with open(self.path, 'r', errors='replace') as f:
+            f.seek(self.offset)
+            data = f.read()
+            self.offset = f.tell()
+        data = self.partial + data
+        lines = data.split("\n")
+        self.partial = lines.pop()
+        return lines
+
+def parse_detection(line: str):
+    """(ueid, expected cell, AD row time, detection time) of a Mismatch line, else None."""
+    m = MISMATCH_REGEX.search(line)
+    if not m:
+        return None
+
+    ueid_raw, ts_str, expected_cell_str, current_cell_str = m.groups()
+
+    # normalize UEID (handles "23.0" → 23)
+    try:
+        ueid = int(float(ueid_raw))
+    except ValueError:
+        print(f"[WARN] Could not parse UEID from line: {line.strip()}")
+        return None
 
     try:
-        command = COMMAND_TEMPLATE.format(
-            grpcurl=GRPCURL_PATH,
-            ueid=formatted_ueid,
-            target_cell=target_cell
-        )
-        subprocess.run(command, shell=True, check=True, executable="/bin/bash")
-        print(f"[OK] gRPC sent for UEID {formatted_ueid} → {target_cell}")
-    except subprocess.CalledProcessError as e:
-        print(f"[ERROR] gRPC failed for UEID {formatted_ueid}: {e}")
-    finally:
-        print("[INFO] Waiting 5 seconds before next command...")
-        time.sleep(5)
+        expected_cell = int(expected_cell_str)
+    except ValueError:
+        print(f"[WARN] Could not parse expected CellID from line: {line.strip()}")
+        return None
+
+    detected_at = None
+    a = ASCTIME_REGEX.match(line)
+    if a:
+        detected_at = datetime.strptime(a.group(1), "%Y-%m-%d %H:%M:%S,%f").timestamp()
+
+    return ueid, expected_cell, ts_str.strip(), detected_at
+
+# --------------------------
+# Handover requests
+# --------------------------
+def send_handovers(client: RcControlClient, actions, latency_writer):
+    """Sends one batch of (ueid, expected cell, ts, detected_at) handovers and logs their latency."""
+    requests = [(f"{ueid:05d}", compute_target_cell(expected_cell)) for ueid, expected_cell, _, _ in actions]
+    for (formatted_ueid, target_cell), (_, expected_cell, _, _) in zip(requests, actions):
+        print(f"[INFO] Handover request → UEID={formatted_ueid} to TargetCellID={target_cell} (expected slice cell {expected_cell})")
+
+    results = client.send_batch(requests)
+
+    for result, (ueid, expected_cell, ts_str, detected_at) in zip(results, actions):
+        detect_to_sent = (result["sent_at"] - detected_at) * 1000 if detected_at else None
+        rtt = (result["acked_at"] - result["sent_at"]) * 1000
+        if result["error"]:
+            print(f"[ERROR] gRPC failed for UEID {result['ueid']}: {result['error']}")
+        else:
+            message = f"[OK] gRPC sent for UEID {result['ueid']} → {result['target_cell']} (rtt {rtt:.1f} ms"
+            if detect_to_sent is not None:
+                message += f", detection→sent {detect_to_sent:.1f} ms"
+            print(message + ")")
+        latency_writer.writerow({
+            "ueid": ueid, "target_cell": result["target_cell"], "expected_cell": expected_cell,
+            "ad_row_time": ts_str, "detected_at": detected_at, "sent_at": result["sent_at"],
+            "acked_at": result["acked_at"],
+            "detect_to_sent_ms": round(detect_to_sent, 3) if detect_to_sent is not None else "",
+            "rtt_ms": round(rtt, 3), "rsp_code": result["code"], "error": result["error"] or ""})
+    return results
 
 # --------------------------
 # Main Execution Loop
 # --------------------------
 def main():
     print("[INFO] Starting ts-final-tested.py (slice-based handover)...")
-    current_position = 0  # Start from beginning of log file
+    follower = LogFollower(LOG_FILE)  # Start from beginning of log file
     processed_ueids = set()  # Avoid duplicate handovers per UE
 
-    while True:
-        if not os.path.exists(LOG_FILE):
-            print(f"[INFO] Log file '{LOG_FILE}' not found.")
-            time.sleep(CHECK_INTERVAL)
-            continue
-
-        with open(LOG_FILE, 'r') as f:
-            all_lines = f.readlines()
-
-        total_lines = len(all_lines)
-        remaining_lines = total_lines - current_position
-
-        if remaining_lines < LINES_TO_CHECK:
-            print(f"[INFO] Not enough new lines ({remaining_lines}) at position {current_position}. Waiting for new data...")
-            time.sleep(CHECK_INTERVAL)
-            continue
-
-        batch_lines = all_lines[current_position:current_position + LINES_TO_CHECK]
-        print(f"[DEBUG] Parsing {len(batch_lines)} lines from position {current_position}")
-
-        # Parse only "Mismatch:" lines emitted by AD
-        actions = []
-        for line in batch_lines:
-            m = MISMATCH_REGEX.search(line)
-            if not m:
-                continue
-
-            ueid_raw, ts_str, expected_cell_str, current_cell_str = m.groups()
-
-            # normalize UEID (handles "23.0" → 23)
-            try:
-                ueid = int(float(ueid_raw))
-            except ValueError:
-                print(f"[WARN] Could not parse UEID from line: {line.strip()}")
-                continue
-
-            try:
-                expected_cell = int(expected_cell_str)
-            except ValueError:
-                print(f"[WARN] Could not parse expected CellID from line: {line.strip()}")
-                continue
-
-            # Deduplicate per-batch
-            actions.append((ueid, expected_cell, ts_str.strip()))
-
-        # Execute handovers for UEs we haven't processed yet
-        for ueid, expected_cell, ts_str in actions:
-            if ueid in processed_ueids:
-                print(f"[INFO] Skipping UEID {ueid}: already processed.")
+    client = RcControlClient(RC_XAPP_ADDR, REQUEST_FIELDS,
+                             use_grpcurl=(CONTROL_MODE == "grpcurl"), grpcurl_path=GRPCURL_PATH)
+    if client.use_grpcurl:
+        print("[INFO] Control channel: grpcurl per request")
+    elif not client.wait_ready(5):
+        print(f"[WARN] RC xApp at {RC_XAPP_ADDR} not reachable yet; requests will retry the connection.")
+    else:
+        print(f"[INFO] Control channel to {RC_XAPP_ADDR} connected.")
+
+    write_header = not os.path.exists(LATENCY_FILE)
+    latency_file = open(LATENCY_FILE, 'a', newline='')
+    latency_writer = csv.DictWriter(latency_file, fieldnames=[
+        "ueid", "target_cell", "expected_cell", "ad_row_time", "detected_at", "sent_at", "acked_at",
+        "detect_to_sent_ms", "rtt_ms", "rsp_code", "error"])
+    if write_header:
+        latency_writer.writeheader()
+
+    waiting_logged = False
+    try:
+        while True:
+            if not os.path.exists(LOG_FILE):
+                if not waiting_logged:
+                    print(f"[INFO] Log file '{LOG_FILE}' not found. Waiting for it...")
+                    waiting_logged = True
+                time.sleep(POLL_INTERVAL)
                 continue
 
-            print(f"[INFO] From log @ {ts_str}: UEID {ueid} → expected CellID {expected_cell}")
-            run_grpc_command_for_slice(ueid, expected_cell)
-            processed_ueids.add(ueid)
-
-        current_position += LINES_TO_CHECK
-        print(f"[INFO] Batch complete. Next batch starts at line {current_position}")
-        time.sleep(CHECK_INTERVAL)
+            # Parse only "Mismatch:" lines emitted by AD
+            actions = []
+            for line in follower.read_new_lines():
+                detection = parse_detection(line)
+                if detection is None:
+                    continue
+                ueid, expected_cell, ts_str, _ = detection
+
+                # Execute handovers for UEs we haven't processed yet
+                if ueid in processed_ueids:
+                    print(f"[INFO] Skipping UEID {ueid}: already processed.")
+                    continue
+                print(f"[INFO] From log @ {ts_str}: UEID {ueid} → expected CellID {expected_cell}")
+                processed_ueids.add(ueid)
+                actions.append(detection)
+
+            if actions:
+                send_handovers(client, actions, latency_writer)
+                latency_file.flush()
+            else:
+                time.sleep(POLL_INTERVAL)
+    except KeyboardInterrupt:
+        print("\n[INFO] Shutting down...")
+    finally:
+        latency_file.close()
+        client.close()
 
 if __name__ == "__main__":
-    main()
\ No newline at end of file
+    main()
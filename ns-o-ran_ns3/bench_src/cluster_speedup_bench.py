@@ -0,0 +1,113 @@
+import os
+import sys
+import time
+import shlex
+import argparse
+import subprocess
+from pathlib import Path
+from concurrent.futures import ThreadPoolExecutor
+
+
+def run_cluster(binary: str, options: list, run_dir: Path, clusters: int, cluster: int) -> float:
+
+	"""
+	Runs one process of the scenario in run_dir and returns its wall time.
+	"""
+
+	run_dir.mkdir(parents=True, exist_ok=True)
+	command = [binary] + options + [f"--outputDir={run_dir}"]
+	if clusters > 1:
+		command += [f"--numIsolatedClusters={clusters}", f"--isolatedClusterIndex={cluster}"]
+	start = time.perf_counter()
+	with open(run_dir / "run.log", "w") as log_file:
+		return_code = subprocess.run(command, cwd=run_dir, stdout=log_file, stderr=subprocess.STDOUT).returncode
+	if return_code != 0:
+		raise RuntimeError(f"{' '.join(command)} failed, see {run_dir / 'run.log'}")
+	return time.perf_counter() - start
+
+
+def run_partitioned(binary: str, options: list, output_dir: Path, clusters: int) -> tuple:
+
+	"""
+	Runs the clusters of one partition concurrently, one core each. Returns the wall time of the whole partition and the longest cluster.
+	"""
+
+	start = time.perf_counter()
+	with ThreadPoolExecutor(max_workers=clusters) as executor:
+		futures = [executor.submit(run_cluster, binary, options, output_dir / f"cluster_{cluster}", clusters, cluster)
+				   for cluster in range(clusters)]
+		cluster_times = [future.result() for future in futures]
+	return time.perf_counter() - start, max(cluster_times)
+
+
+def slice_throughputs(output_dir: Path) -> dict:
+
+	"""
+	Mean throughput [Mbps] of every slice over all the reports of its UEs, and the number of UEs, from the <slice>_ue_<n>_datarate.txt files of all the clusters of a run.
+	"""
+
+	totals = {}
+	for path in output_dir.glob("**/*_datarate.txt"):
+		slice_name = path.name.split("_ue_")[0]
+		with open(path, "r") as report:
+			next(report, None)
+			values = [float(line.split("\t")[1]) for line in report if "\t" in line]
+		total, rows, ues = totals.get(slice_name, (0.0, 0, 0))
+		totals[slice_name] = (total + sum(values), rows + len(values), ues + 1)
+	return {slice_name: (total / rows if rows else 0.0, ues) for slice_name, (total, rows, ues) in totals.items()}
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Wall time of slicing_AD_v5 split into 1, 2, 4... isolated cell clusters run on as many cores, against the whole topology in one process. The clusters do not interact, so their KPIs only approximate those of the whole run: the mean throughput of every slice must stay within --tolerance of it, the exit code is 1 otherwise.")
+	parser.add_argument("--binary", default="./build/scratch/ns3.38.rc1-slicing_AD_v5-default")
+	parser.add_argument("--cores", type=int, nargs="+", default=[1, 2, 4], help="numbers of clusters, one core each")
+	parser.add_argument("--options", default="--layout=hex --nMmWaveEnbNodes=37 --nLteEnbNodes=7 --ues=4 --simTime=2",
+						help="scenario options shared by all runs")
+	parser.add_argument("--mobility-trace", help="trajectory file replayed in all runs (sim_tools/trajectory_gen.py), so that the UEs of the clusters follow the paths they follow in the sequential run")
+	parser.add_argument("--tolerance", type=float, default=10, help="largest relative difference [%%] of the mean throughput of a slice from the sequential run")
+	parser.add_argument("--output", default="cluster_bench_output")
+	args = parser.parse_args()
+
+	binary = str(Path(args.binary).resolve())
+	if not Path(binary).exists():
+		print(f"scenario binary {binary} not found")
+		sys.exit(1)
+	options = shlex.split(args.options)
+	if args.mobility_trace:
+		options.append(f"--mobilityTrace={Path(args.mobility_trace).resolve()}")
+	output = Path(args.output).resolve()
+	print(f"{os.cpu_count()} cores, options: {' '.join(options)}")
+
+	sequential_dir = output / "sequential"
+	sequential_time = run_cluster(binary, options, sequential_dir, 1, 0)
+	sequential = slice_throughputs(sequential_dir)
+	print(f"sequential: {sequential_time:.2f} s, " +
+		  ", ".join(f"{name} {mean:.3f} Mbps ({ues} UEs)" for name, (mean, ues) in sorted(sequential.items())))
+	if not sequential:
+		print("no <ue>_datarate.txt report in the sequential run, the comparison needs --dataRateFormat=text")
+		sys.exit(1)
+
+	print(f"cores\twall [s]\tslowest cluster [s]\tspeedup\tefficiency\tlargest slice throughput difference [%] (tolerance {args.tolerance:g})")
+	failures = 0
+	for cores in args.cores:
+		if cores < 2:
+			continue
+		run_dir = output / f"clusters_{cores}"
+		wall_time, slowest = run_partitioned(binary, options, run_dir, cores)
+		clustered = slice_throughputs(run_dir)
+		differences = {}
+		for name, (mean, ues) in sequential.items():
+			found, found_ues = clustered.get(name, (0.0, 0))
+			differences[name] = 100 * abs(found - mean) / mean if mean else (0 if found == 0 else float("inf"))
+			if found_ues != ues:
+				print(f"  {name}: {found_ues} UEs in the clusters, {ues} in the sequential run")
+				failures += 1
+		speedup = sequential_time / wall_time
+		print(f"{cores}\t{wall_time:.2f}\t{slowest:.2f}\t{speedup:.2f}\t{speedup / cores:.2f}\t{max(differences.values()):.2f}")
+		for name in sorted(differences):
+			if differences[name] > args.tolerance:
+				print(f"  {name}: {clustered.get(name, (0.0, 0))[0]:.3f} Mbps vs {sequential[name][0]:.3f} Mbps ({differences[name]:.2f} %)")
+				failures += 1
+	if failures:
+		print(f"FAIL: {failures} slices out of tolerance or with missing UEs")
+		sys.exit(1)
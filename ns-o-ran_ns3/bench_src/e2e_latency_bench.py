@@ -0,0 +1,468 @@
+import os
+import re
+import sys
+import json
+import time
+import bisect
+import random
+import logging
+import argparse
+import tempfile
+import threading
+import importlib.util
+from pathlib import Path
+from urllib.parse import urlparse, parse_qs
+from typing import Dict, List, Optional
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+ROOT = Path(__file__).resolve().parent.parent
+sys.path.insert(0, str(ROOT))
+sys.path.insert(0, str(ROOT / "abd_ts_src"))
+
+import yaml
+
+TAG_BASE = 100000   # IMSIs of the injected anomalies, one fresh UE each (the TS hands a UE over once)
+MEASUREMENTS = ("cu_cp_bucket", "du_bucket", "cu_up_bucket")
+
+
+class LatencyTracker:
+
+	"""
+	Times of every tagged anomaly along the pipeline: emitted (generator), ingest (its three points written to InfluxDB), poll (its three points returned to the AD), detect (its Mismatch line) and action (its handover at the RC endpoint).
+
+	Methods
+	-------
+	mark(imsi, stage, when)
+		Records the first time imsi reaches stage.
+
+	summary(imsis)
+		Per-stage and total latency percentiles of the given anomalies.
+	"""
+
+	stages = ["emitted", "ingest", "poll", "detect", "action"]
+
+	def __init__(self):
+
+		"""
+		Initializes the class
+		"""
+
+		self.times: Dict[int, Dict[str, float]] = {}
+		self._seen: Dict[tuple, set] = {}   # (imsi, stage) -> measurements seen
+		self._lock = threading.Lock()
+
+	def mark(self, imsi: int, stage: str, when: float):
+
+		with self._lock:
+			self.times.setdefault(imsi, {}).setdefault(stage, when)
+
+	def mark_side(self, imsi: int, stage: str, measurement: str, when: float):
+
+		"""
+		Marks stage once the point of every measurement of imsi has been seen.
+		"""
+
+		with self._lock:
+			seen = self._seen.setdefault((imsi, stage), set())
+			seen.add(measurement)
+			if len(seen) == len(MEASUREMENTS):
+				self.times.setdefault(imsi, {}).setdefault(stage, when)
+
+	def summary(self, imsis: List[int]) -> Dict[str, dict]:
+
+		with self._lock:
+			records = [dict(self.times.get(imsi, {})) for imsi in imsis]
+		result = {}
+		pairs = list(zip(self.stages, self.stages[1:])) + [("emitted", "action")]
+		for start, end in pairs:
+			values = sorted(1000 * (record[end] - record[start]) for record in records
+							if start in record and end in record)
+			name = "total" if (start, end) == ("emitted", "action") else end
+			result[name] = {"count": len(values)}
+			if values:
+				result[name].update(p50=values[len(values) // 2], p99=values[min(len(values) - 1, int(0.99 * len(values)))],
+									max=values[-1])
+		return result
+
+
+class StubInfluxServer:
+
+	"""
+	In-memory stand-in for the InfluxDB 1.x HTTP API, limited to what the pipeline uses: /write in line protocol (sim_watcher.py through InfluxWriter), SHOW/CREATE DATABASE, and SELECT <fields> FROM <measurement> WHERE time > <ns> ORDER BY time ASC (the AD's InfluxJoinSource).
+
+	Attributes
+	----------
+	points_written : int
+		Points received on /write.
+
+	points_served : int
+		Points returned by queries.
+	"""
+
+	select_regex = re.compile(r"SELECT\s+(.*?)\s+FROM\s+(\w+)(?:\s+WHERE\s+time\s*>\s*(\d+))?", re.IGNORECASE | re.DOTALL)
+
+	def __init__(self, tracker: LatencyTracker, port: int = 0):
+
+		"""
+		Initializes the class and starts serving in a background thread
+		"""
+
+		self.tracker = tracker
+		self.series: Dict[str, list] = {}   # measurement -> sorted [(time, sequence, fields)]
+		self.points_written = 0
+		self.points_served = 0
+		self._served = set()
+		self._sequence = 0
+		self._lock = threading.Lock()
+		stub = self
+
+		class Handler(BaseHTTPRequestHandler):
+
+			def do_POST(self):
+				body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+				url = urlparse(self.path)
+				if url.path == "/write":
+					stub.write(body.decode("utf-8", errors="replace"))
+					self.send_response(204)
+					self.end_headers()
+				else:
+					query = parse_qs(url.query).get("q", [""])[0] or parse_qs(body.decode()).get("q", [""])[0]
+					self.reply(stub.query(query))
+
+			def do_GET(self):
+				parameters = parse_qs(urlparse(self.path).query)
+				self.reply(stub.query(parameters.get("q", [""])[0]))
+
+			def reply(self, result: dict):
+				body = json.dumps({"results": [dict(statement_id=0, **result)]}).encode()
+				self.send_response(200)
+				self.send_header("Content-Type", "application/json")
+				self.send_header("Content-Length", str(len(body)))
+				self.end_headers()
+				self.wfile.write(body)
+
+			def log_message(self, *args):
+				pass
+
+		self.server = ThreadingHTTPServer(("127.0.0.1", port), Handler)
+		self.port = self.server.server_address[1]
+		threading.Thread(target=self.server.serve_forever, daemon=True).start()
+
+	@staticmethod
+	def _split(text: str, separator: str) -> List[str]:
+
+		"""
+		Splits on unescaped separators outside double quotes.
+		"""
+
+		parts, current, quoted, escaped = [], "", False, False
+		for character in text:
+			if escaped:
+				current += character
+				escaped = False
+			elif character == "\\":
+				escaped = True
+			elif character == '"':
+				quoted = not quoted
+				current += character
+			elif character == separator and not quoted:
+				parts.append(current)
+				current = ""
+			else:
+				current += character
+		parts.append(current)
+		return parts
+
+	def write(self, body: str):
+
+		now = time.time()
+		for line in body.splitlines():
+			parts = self._split(line, " ")
+			if len(parts) < 2:
+				continue
+			measurement = self._split(parts[0], ",")[0]
+			fields = {}
+			for field in self._split(parts[1], ","):
+				key, _, value = field.partition("=")
+				if value.startswith('"'):
+					fields[key] = value.strip('"')
+				elif value in ("t", "true", "f", "false"):
+					fields[key] = value in ("t", "true")
+				else:
+					fields[key] = float(value.rstrip("i"))
+			timestamp = int(parts[2]) if len(parts) > 2 else time.time_ns()
+			with self._lock:
+				self._sequence += 1
+				bisect.insort(self.series.setdefault(measurement, []), (timestamp, self._sequence, fields))
+				self.points_written += 1
+			imsi = int(fields.get("ue_imsi_complete", 0))
+			if imsi >= TAG_BASE and measurement in MEASUREMENTS:
+				self.tracker.mark_side(imsi, "ingest", measurement, now)
+
+	def query(self, query: str) -> dict:
+
+		if re.match(r"\s*SHOW\s+DATABASES", query, re.IGNORECASE):
+			return {"series": [{"name": "databases", "columns": ["name"], "values": [["ns3_metrics"]]}]}
+		match = self.select_regex.search(query)
+		if not match:
+			return {}
+		columns = [column.strip().strip('"') for column in match.group(1).split(",")]
+		measurement, since = match.group(2), int(match.group(3) or 0)
+		with self._lock:
+			series = self.series.get(measurement, [])
+			selected = series[bisect.bisect_right(series, (since, float("inf"))):]
+			self.points_served += len(selected)
+		if not selected:
+			return {}
+		now = time.time()
+		values = []
+		for timestamp, _, fields in selected:
+			values.append([timestamp] + [fields.get(column) for column in columns])
+			imsi = int(fields.get("ue_imsi_complete", 0))
+			if imsi >= TAG_BASE and measurement in MEASUREMENTS:
+				self.tracker.mark_side(imsi, "poll", measurement, now)
+		return {"series": [{"name": measurement, "columns": ["time"] + columns, "values": values}]}
+
+
+class SyntheticKpmGenerator:
+
+	"""
+	Writes cu-cp-cell-N, cu-up-cell-N and du-cell-N logs like the scenario: every period one row per UE and file for ues UEs spread over cells 2 to 4, plus tagged anomalous reports at rate per second, each from a fresh UE (IMSI TAG_BASE + n) with a collapsed serving SINR and a serving cell outside the slice cells, so that a detection is always a mismatch.
+	"""
+
+	cells = [2, 3, 4]
+
+	def __init__(self, directory: Path, tracker: LatencyTracker, seed: int = 1):
+
+		"""
+		Initializes the class and creates the log files with the columns of field_maps.yml
+		"""
+
+		self.tracker = tracker
+		self.random = random.Random(seed)
+		with open(ROOT / "metric_src" / "field_maps.yml", "r") as input_file:
+			field_maps = yaml.safe_load(input_file)
+		self.columns = {kind: list(field_maps[kind]) for kind in ("cu_cp", "cu_up", "du")}
+		self.files = {}
+		for cell in self.cells:
+			for kind, prefix in (("cu_cp", "cu-cp"), ("cu_up", "cu-up"), ("du", "du")):
+				path = directory / f"{prefix}-cell-{cell}.txt"
+				path.unlink(missing_ok=True)
+				self.files[(kind, cell)] = open(path, "w")
+				self.files[(kind, cell)].write(",".join(self.columns[kind]) + "\n")
+				self.files[(kind, cell)].flush()
+		self.next_tag = TAG_BASE
+		self.rows = 0
+
+	def _row(self, kind: str, timestamp: int, imsi: int, cell: int, anomalous: bool) -> str:
+
+		values = {"timestamp": timestamp, "ueImsiComplete": f"{imsi:05d}", "numActiveUes": 10, "nrCellId": cell,
+				  "L3 serving Id(m_cellId)": 5 if anomalous else cell,
+				  "L3 serving SINR": -40.0 if anomalous else self.random.gauss(15, 3),
+				  "L3 serving SINR 3gpp": -40.0 if anomalous else self.random.gauss(12, 3),
+				  "DRB.UEThpDl.UEID": 0.0 if anomalous else self.random.gauss(50, 5),
+				  "RRU.PrbUsedDl": 100.0 if anomalous else self.random.uniform(5, 30),
+				  "TB.ErrTotalNbrDl.1": 1e4 if anomalous else self.random.uniform(0, 5),
+				  "DRB.PdcpSduDelayDl.UEID (pdcpLatency)": 1e4 if anomalous else self.random.uniform(1, 10)}
+		for neighbour in range(1, 9):
+			values[f"L3 neigh Id {neighbour} (cellId)"] = self.cells[(cell + neighbour) % len(self.cells)]
+			values[f"L3 neigh SINR {neighbour}"] = self.random.gauss(5, 3)
+		return ",".join(str(values.get(column, 0)) for column in self.columns[kind])
+
+	def _report(self, imsis: List[int], cells: List[int], anomalous: bool):
+
+		timestamp = int(1000 * time.time())
+		lines = {}
+		for imsi, cell in zip(imsis, cells):
+			for kind in self.columns:
+				lines.setdefault((kind, cell), []).append(self._row(kind, timestamp, imsi, cell, anomalous))
+		for key, rows in lines.items():
+			self.files[key].write("\n".join(rows) + "\n")
+			self.files[key].flush()
+			self.rows += len(rows)
+
+	def run(self, ues: int, rate: float, duration: float, period: float = 0.1) -> List[int]:
+
+		"""
+		Emits for duration seconds; returns the IMSIs of the injected anomalies.
+		"""
+
+		tags = []
+		start = time.time()
+		next_report = start
+		next_anomaly = start + (1 / rate if rate > 0 else duration)
+		normal_imsis = list(range(1, ues + 1))
+		normal_cells = [self.cells[imsi % len(self.cells)] for imsi in normal_imsis]
+		while True:
+			now = time.time()
+			if now >= start + duration:
+				return tags
+			if now >= next_report:
+				self._report(normal_imsis, normal_cells, False)
+				next_report += period
+			if rate > 0 and now >= next_anomaly:
+				imsi = self.next_tag
+				self.next_tag += 1
+				self.tracker.mark(imsi, "emitted", time.time())
+				self._report([imsi], [self.cells[imsi % len(self.cells)]], True)
+				tags.append(imsi)
+				next_anomaly += 1 / rate
+			time.sleep(max(0.0, min(next_report, next_anomaly if rate > 0 else next_report, start + duration) - time.time()))
+
+
+def load_script(name: str, path: Path):
+
+	"""
+	Imports one of the service scripts (their file names are not module names).
+	"""
+
+	spec = importlib.util.spec_from_file_location(name, path)
+	module = importlib.util.module_from_spec(spec)
+	spec.loader.exec_module(module)
+	return module
+
+
+def start_watcher(directory: Path, influx_port: int):
+
+	os.environ["INFLUX_HOST"] = "127.0.0.1"
+	os.environ["INFLUX_PORT"] = str(influx_port)
+	# The watcher also sends StatsD gauges to the "telegraf" host: send them to localhost, where they are dropped
+	import statsd
+	statsd_client = statsd.StatsClient
+	statsd.StatsClient = lambda host, port, prefix=None: statsd_client("127.0.0.1", port, prefix=prefix)
+	from watchdog.observers import Observer
+	from sim_watcher import SimWatcher
+	observer = Observer()
+	observer.schedule(SimWatcher(), str(directory), recursive=False)
+	observer.start()
+	return observer
+
+
+def start_detector(kind: str, influx_port: int, query_interval: Optional[float]):
+
+	"""
+	Runs the AD (ad-slicing.py, or the stub that flags the collapsed serving SINR without a model) against the stub InfluxDB.
+	"""
+
+	from influxdb import InfluxDBClient
+	client_factory = lambda host=None, port=None, database=None: InfluxDBClient(host="127.0.0.1", port=influx_port,
+																				database=database)
+	if kind == "ad":
+		ad = load_script("ad_slicing", ROOT / "abd_ts_src" / "ad-slicing.py")
+		ad.InfluxDBClient = client_factory
+		ad.MODELS_DIR = ROOT / "abd_ts_src" / "models_dir"
+		ad.DEBUG = False
+		if query_interval is not None:
+			ad.QUERY_INTERVAL = query_interval
+		target = ad.main
+	else:
+		from stream_join import StreamJoin, InfluxJoinSource
+		logging.basicConfig(filename="anomalies.log", level=logging.WARNING, format="%(asctime)s - %(message)s")
+		source = InfluxJoinSource(client_factory(database="ns3_metrics"), {
+			"cu_cp": "SELECT ue_imsi_complete, l3_serving_sinr, l3_serving_id_m_cellid FROM cu_cp_bucket",
+			"du": "SELECT ue_imsi_complete, drb_uethp_dl_ueid FROM du_bucket",
+			"cu_up": "SELECT ue_imsi_complete, drb_pdcp_sdu_delay_dl_ueid_pdcp_latency FROM cu_up_bucket",
+		}, StreamJoin())
+
+		def target():
+			for joined in source.stream_batches(0.001 if query_interval is None else query_interval):
+				for cu_cp, _, _ in joined:
+					if cu_cp["l3_serving_sinr"] < -20:
+						logging.warning(f"Mismatch: UE ID {int(cu_cp['ue_imsi_complete'])} | time {cu_cp['time']} | "
+										f"Cluster=0(eMBB) -> expected CellID 2(eMBB) | "
+										f"Current CellID {int(cu_cp['l3_serving_id_m_cellid'])}(unknown)")
+	threading.Thread(target=target, daemon=True).start()
+
+
+def start_ts(rc_port: int, poll_interval: Optional[float]):
+
+	ts = load_script("ts_final_tested", ROOT / "abd_ts_src" / "ts-final-tested.py")
+	ts.RC_XAPP_ADDR = f"127.0.0.1:{rc_port}"
+	ts.CONTROL_MODE = "grpc"
+	if poll_interval is not None:
+		ts.POLL_INTERVAL = poll_interval
+	threading.Thread(target=ts.main, daemon=True).start()
+	return ts
+
+
+def collect(tracker: LatencyTracker, ts, servicer):
+
+	"""
+	Detection times from the Mismatch lines of anomalies.log, action times from the requests received by the mock RC server.
+	"""
+
+	if os.path.exists("anomalies.log"):
+		with open("anomalies.log", "r", errors="replace") as log_file:
+			for line in log_file:
+				detection = ts.parse_detection(line)
+				if detection is not None and detection[0] >= TAG_BASE and detection[3] is not None:
+					tracker.mark(detection[0], "detect", detection[3])
+	for received_at, request in list(servicer.requests):
+		imsi = int(request["RICControlHeaderData"]["UEID"])
+		if imsi >= TAG_BASE:
+			tracker.mark(imsi, "action", received_at)
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Detection-to-action latency of the ABD/TS pipeline (CSV logs -> sim_watcher.py -> InfluxDB -> ad-slicing.py -> anomalies.log -> ts-final-tested.py -> RC gRPC), with a synthetic KPM generator, a stub InfluxDB and the mock RC server.")
+	parser.add_argument("--ues", type=int, nargs="+", default=[10, 100], help="normal UEs reporting every period")
+	parser.add_argument("--rates", type=float, nargs="+", default=[1, 10], help="tagged anomalies injected per second")
+	parser.add_argument("--period", type=float, default=0.1, help="report period of the normal UEs [s]")
+	parser.add_argument("--duration", type=float, default=20.0, help="injection time per load step [s]")
+	parser.add_argument("--drain", type=float, default=5.0, help="time left to the pipeline after each step [s]")
+	parser.add_argument("--detector", choices=["ad", "stub"], default="ad",
+						help="ad-slicing.py with its models, or a stub that flags the anomalies without torch")
+	parser.add_argument("--query-interval", type=float, help="override QUERY_INTERVAL of the AD [s]")
+	parser.add_argument("--poll-interval", type=float, help="override POLL_INTERVAL of the TS [s]")
+	parser.add_argument("--rc-delay", type=float, default=0.0, help="processing delay of the mock RC server [s]")
+	parser.add_argument("--workdir", help="directory of the logs (default: a temporary directory)")
+	args = parser.parse_args()
+
+	report = sys.stdout
+	workdir = Path(args.workdir or tempfile.mkdtemp(prefix="e2e_latency_")).resolve()
+	workdir.mkdir(parents=True, exist_ok=True)
+	os.chdir(workdir)   # the services use relative paths (anomalies.log, control_latency.csv)
+	for name in ("anomalies.log", "control_latency.csv"):
+		Path(name).unlink(missing_ok=True)
+	print(f"work directory {workdir}, service output in pipeline.log", file=report)
+	sys.stdout = open(workdir / "pipeline.log", "w", buffering=1)
+
+	from mock_rc_server import serve
+	tracker = LatencyTracker()
+	influx = StubInfluxServer(tracker)
+	rc_server, servicer, rc_port = serve(0, args.rc_delay, quiet=True)
+	generator = SyntheticKpmGenerator(workdir, tracker)
+	observer = start_watcher(workdir, influx.port)
+	start_detector(args.detector, influx.port, args.query_interval)
+	ts = start_ts(rc_port, args.poll_interval)
+
+	columns = ["ingest", "poll", "detect", "action", "total"]
+	print("UEs\tanomalies/s\trows/s\tinflux writes/s\tinflux reads/s\thandovers/s\tcompleted\t" +
+		  "\t".join(f"{stage} p50/p99/max [ms]" for stage in columns), file=report)
+	ceiling = None
+	for ues in args.ues:
+		for rate in args.rates:
+			counters = (generator.rows, influx.points_written, influx.points_served, len(servicer.requests))
+			tags = generator.run(ues, rate, args.duration, args.period)
+			time.sleep(args.drain)
+			collect(tracker, ts, servicer)
+			summary = tracker.summary(tags)
+			completed = summary["total"]["count"]
+			rows, written, served, handovers = (now - before for now, before in zip(
+				(generator.rows, influx.points_written, influx.points_served, len(servicer.requests)), counters))
+			cells = []
+			for stage in columns:
+				s = summary[stage]
+				cells.append(f"{s['p50']:.1f}/{s['p99']:.1f}/{s['max']:.1f}" if s["count"] else "-")
+			print(f"{ues}\t{rate:g}\t{rows / args.duration:.0f}\t{written / args.duration:.0f}\t"
+				  f"{served / args.duration:.0f}\t{handovers / args.duration:.1f}\t{completed}/{len(tags)}\t" +
+				  "\t".join(cells), file=report)
+			if tags and completed == len(tags) and (ceiling is None or rows / args.duration > ceiling[2]):
+				ceiling = (ues, rate, rows / args.duration)
+	if ceiling:
+		print(f"highest load with every anomaly handed over: {ceiling[0]} UEs, {ceiling[1]:g} anomalies/s, "
+			  f"{ceiling[2]:.0f} rows/s", file=report)
+	else:
+		print("no load step handed over every anomaly, see pipeline.log", file=report)
+	observer.stop()
+	rc_server.stop(0)
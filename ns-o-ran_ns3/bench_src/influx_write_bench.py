@@ -0,0 +1,139 @@
+import sys
+import time
+import argparse
+import threading
+import urllib.request
+from pathlib import Path
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+sys.path.insert(0, str(Path(__file__).resolve().parent.parent))
+from influx_db.influx_writer import InfluxWriter
+
+
+class StubInfluxServer:
+
+	"""
+	Minimal stand-in for the InfluxDB /write endpoint: counts the received lines and answers 204 after a fixed delay, the round trip time to emulate.
+
+	Attributes
+	----------
+	latency : float
+		Seconds slept before answering each request.
+
+	requests : int
+		Number of /write requests received.
+
+	lines : int
+		Number of line protocol lines received.
+	"""
+
+	def __init__(self, latency: float = 0.002, port: int = 0):
+
+		"""
+		Initializes the class and starts serving in a background thread
+		"""
+
+		self.latency = latency
+		self.requests = 0
+		self.lines = 0
+		self._lock = threading.Lock()
+		stub = self
+
+		class Handler(BaseHTTPRequestHandler):
+
+			def do_POST(self):
+				body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+				time.sleep(stub.latency)
+				with stub._lock:
+					stub.requests += 1
+					stub.lines += body.count(b"\n")
+				self.send_response(204)
+				self.end_headers()
+
+			def log_message(self, *args):
+				pass
+
+		self.server = ThreadingHTTPServer(("127.0.0.1", port), Handler)
+		self.port = self.server.server_address[1]
+		threading.Thread(target=self.server.serve_forever, daemon=True).start()
+
+	def stop(self):
+
+		self.server.shutdown()
+
+
+def make_points(ues: int, indications: int) -> list:
+
+	"""
+	Points shaped like the cu_cp_bucket and ue_cell_bucket points of one cu-cp row per UE and indication.
+	"""
+
+	points = []
+	for indication in range(indications):
+		timestamp = 1_700_000_000_000_000_000 + indication * 100_000_000
+		for ue in range(1, ues + 1):
+			tags = {"ueImsiComplete": str(ue), "L3ServingId": str(2 + ue % 3)}
+			points.append({"measurement": "cu_cp_bucket", "tags": tags, "time": timestamp,
+						   "fields": {f"field_{index}": float(ue * index) for index in range(30)}})
+			points.append({"measurement": "ue_cell_bucket", "tags": {"ueImsiComplete": str(ue)}, "time": timestamp,
+						   "fields": {f"cell_{cell}_sinr": float(cell) for cell in range(2, 8)}})
+	return points
+
+
+def per_point(points: list, port: int) -> float:
+
+	"""
+	The previous behaviour: one synchronous POST per point.
+	"""
+
+	url = f"http://127.0.0.1:{port}/write?db=ns3_metrics&precision=ns"
+	start = time.perf_counter()
+	for point in points:
+		body = (InfluxWriter.to_line_protocol(point) + "\n").encode()
+		with urllib.request.urlopen(urllib.request.Request(url, data=body, method="POST")) as response:
+			response.read()
+	return time.perf_counter() - start
+
+
+def batched(points: list, port: int, batch_size: int, max_age: float) -> tuple:
+
+	writer = InfluxWriter("127.0.0.1", port, "ns3_metrics", batch_size=batch_size, max_age=max_age)
+	start = time.perf_counter()
+	for point in points:
+		writer.write(point)
+	enqueue_time = time.perf_counter() - start
+	writer.flush()
+	total_time = time.perf_counter() - start
+	writer.close()
+	return enqueue_time, total_time, writer.stats()
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Compare per-point and batched InfluxDB writes against a local stub server.")
+	parser.add_argument("--ues", type=int, default=48)
+	parser.add_argument("--indications", type=int, default=50)
+	parser.add_argument("--latency", type=float, default=0.002, help="stub server response delay [s]")
+	parser.add_argument("--batch-size", type=int, default=5000)
+	parser.add_argument("--max-age", type=float, default=0.5)
+	parser.add_argument("--skip-per-point", action="store_true")
+	args = parser.parse_args()
+
+	points = make_points(args.ues, args.indications)
+	print(f"{len(points)} points ({args.ues} UEs x {args.indications} indications x 2 measurements), "
+		  f"stub latency {1000 * args.latency:.1f} ms")
+
+	if not args.skip_per_point:
+		stub = StubInfluxServer(args.latency)
+		elapsed = per_point(points, stub.port)
+		stub.stop()
+		print(f"per-point: {elapsed:.2f} s, {len(points) / elapsed:.0f} points/s, {stub.requests} requests")
+
+	stub = StubInfluxServer(args.latency)
+	enqueue_time, total_time, stats = batched(points, stub.port, args.batch_size, args.max_age)
+	stub.stop()
+	print(f"batched:   {total_time:.2f} s, {len(points) / total_time:.0f} points/s, {stub.requests} requests, "
+		  f"producer blocked {enqueue_time:.2f} s")
+	print(f"writer stats: {stats}")
+	if stub.lines != len(points):
+		print(f"stub received {stub.lines} lines, expected {len(points)}")
+		sys.exit(1)
@@ -1,12 +1,19 @@
 import os
 import re
+import threading
 from traceback import format_exc
 from influxdb import InfluxDBClient
+from influx_db.influx_writer import InfluxWriter
 from metric_src.metric_utils import MetricUtils
 
 
 class InfluxUtils:
 
+	# One batched writer shared by every InfluxUtils of the process (the watcher
+	# has one per worker thread). INFLUX_BATCH=0 restores the per-point writes
+	shared_writer = None
+	shared_writer_lock = threading.Lock()
+
 	def __init__(self):
 		
 		self.initiate_connection()
@@ -33,8 +40,24 @@ class InfluxUtils:
 		self.influx_client.switch_database(
 			database=influx_config["database"])
 
+		self.influx_writer = None
+		if (os.environ.get("INFLUX_BATCH") or "1") != "0":
+			with InfluxUtils.shared_writer_lock:
+				if InfluxUtils.shared_writer is None:
+					InfluxUtils.shared_writer = InfluxWriter(
+						host=influx_config["host"],
+						port=influx_config["port"],
+						database=influx_config["database"],
+						batch_size=int(os.environ.get("INFLUX_BATCH_SIZE") or 5000),
+						max_age=float(os.environ.get("INFLUX_BATCH_AGE") or 0.5))
+			self.influx_writer = InfluxUtils.shared_writer
+
 	def insert_influx_data(self, data: dict):
 
+		if self.influx_writer is not None:
+			self.influx_writer.write(data)
+			return
+
 		try:
 			self.influx_client.write_points(points=[data])
 		
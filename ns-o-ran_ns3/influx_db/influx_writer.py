@@ -0,0 +1,271 @@
+import math
+import time
+import queue
+import threading
+import urllib.error
+import urllib.parse
+import urllib.request
+from traceback import format_exc
+from typing import Dict, List, Optional
+
+
+class InfluxWriter:
+
+	"""
+	Batched, asynchronous InfluxDB writer.
+
+	Points are put on a bounded queue by the producers (the watcher threads) and consumed by one background thread, which keeps a buffer per measurement and flushes it as a single line protocol POST to /write when it reaches batch_size points or when its oldest point is max_age seconds old. The producers never wait on HTTP: when the queue is full the point is dropped and counted.
+
+	Attributes
+	----------
+	url : str
+		The /write endpoint, with the database and the ns precision as query parameters.
+
+	batch_size : int
+		Number of points of a measurement that triggers a flush.
+
+	max_age : float
+		Maximum time in seconds a point waits in a buffer before it is flushed.
+
+	max_retries : int
+		Number of times a failed flush is retried, with exponential backoff, before its points are dropped.
+
+	counters : Dict[str, int]
+		enqueued, written, dropped (queue full), failed (given up after the retries), retried (points sent again) and flushes.
+
+	Methods
+	-------
+	write(point)
+		Queues one point, a dictionary with measurement, tags, fields and time as accepted by InfluxDBClient.write_points.
+
+	flush()
+		Blocks until every point queued so far has been sent.
+
+	stats()
+		Returns the counters and the flush latency percentiles.
+
+	close()
+		Flushes the buffers and stops the background thread.
+	"""
+
+	def __init__(self, host: str, port: int, database: str, batch_size: int = 5000,
+				 max_age: float = 0.5, queue_size: int = 100000, max_retries: int = 3, timeout: float = 5.0):
+
+		"""
+		Initializes the class and starts the background thread
+		"""
+
+		query = urllib.parse.urlencode({"db": database, "precision": "ns"})
+		self.url = f"http://{host}:{port}/write?{query}"
+		self.batch_size = batch_size
+		self.max_age = max_age
+		self.max_retries = max_retries
+		self.timeout = timeout
+
+		self.counters = {"enqueued": 0, "written": 0, "dropped": 0, "failed": 0, "retried": 0, "flushes": 0}
+		self._counters_lock = threading.Lock()
+		self._flush_latencies: List[float] = []
+		self._max_latency_samples = 10000
+
+		self._queue: queue.Queue = queue.Queue(maxsize=queue_size)
+		self._buffers: Dict[str, List[str]] = {}
+		self._first_point_time: Dict[str, float] = {}
+		self._closed = False
+		self._thread = threading.Thread(target=self._run, name="influx-writer", daemon=True)
+		self._thread.start()
+
+	def write(self, point: dict) -> bool:
+
+		"""
+		Queues point without blocking. Returns False if the queue is full and the point was dropped.
+		"""
+
+		try:
+			self._queue.put_nowait(point)
+		except queue.Full:
+			self._count("dropped")
+			return False
+		self._count("enqueued")
+		return True
+
+	def flush(self, timeout: Optional[float] = None) -> bool:
+
+		"""
+		Waits until the background thread has sent every point queued before the call. Returns False on timeout.
+		"""
+
+		done = threading.Event()
+		try:
+			self._queue.put(done, timeout=timeout)
+		except queue.Full:
+			return False
+		return done.wait(timeout)
+
+	def close(self, timeout: Optional[float] = None):
+
+		"""
+		Sends the buffered points and stops the background thread.
+		"""
+
+		if self._closed:
+			return
+		self._closed = True
+		self._queue.put(None)
+		self._thread.join(timeout)
+
+	def stats(self) -> dict:
+
+		"""
+		Returns a copy of the counters, the queue depth and the flush latency (p50, p99, max) in milliseconds.
+		"""
+
+		with self._counters_lock:
+			stats = dict(self.counters)
+			latencies = sorted(self._flush_latencies)
+		stats["queued"] = self._queue.qsize()
+		if latencies:
+			stats["flush_ms_p50"] = round(1000 * latencies[len(latencies) // 2], 3)
+			stats["flush_ms_p99"] = round(1000 * latencies[min(len(latencies) - 1, int(0.99 * len(latencies)))], 3)
+			stats["flush_ms_max"] = round(1000 * latencies[-1], 3)
+		return stats
+
+	def _count(self, name: str, value: int = 1):
+
+		with self._counters_lock:
+			self.counters[name] += value
+
+	def _run(self):
+
+		while True:
+			timeout = self._time_to_next_flush()
+			try:
+				item = self._queue.get(timeout=timeout)
+			except queue.Empty:
+				item = False
+
+			if item is None:
+				self._flush_all()
+				return
+
+			if isinstance(item, threading.Event):
+				self._flush_all()
+				item.set()
+				continue
+
+			if item is not False:
+				try:
+					measurement = item["measurement"]
+					line = self.to_line_protocol(item)
+				except Exception:
+					print(f"Error in InfluxDB point encoding:\n\n{format_exc()}")
+					self._count("failed")
+					continue
+				buffer = self._buffers.setdefault(measurement, [])
+				if not buffer:
+					self._first_point_time[measurement] = time.monotonic()
+				buffer.append(line)
+				if len(buffer) >= self.batch_size:
+					self._flush(measurement)
+
+			now = time.monotonic()
+			for measurement, first_time in list(self._first_point_time.items()):
+				if now - first_time >= self.max_age:
+					self._flush(measurement)
+
+	def _time_to_next_flush(self) -> Optional[float]:
+
+		if not self._first_point_time:
+			return None
+		oldest = min(self._first_point_time.values())
+		return max(0.0, oldest + self.max_age - time.monotonic())
+
+	def _flush_all(self):
+
+		for measurement in list(self._buffers):
+			self._flush(measurement)
+
+	def _flush(self, measurement: str):
+
+		lines = self._buffers.pop(measurement, [])
+		self._first_point_time.pop(measurement, None)
+		if not lines:
+			return
+
+		body = ("\n".join(lines) + "\n").encode("utf-8")
+		start = time.monotonic()
+		for attempt in range(self.max_retries + 1):
+			if attempt:
+				self._count("retried", len(lines))
+				time.sleep(min(2.0, 0.1 * 2 ** (attempt - 1)))
+			try:
+				request = urllib.request.Request(self.url, data=body, method="POST",
+												 headers={"Content-Type": "text/plain; charset=utf-8"})
+				with urllib.request.urlopen(request, timeout=self.timeout) as response:
+					response.read()
+				break
+			except urllib.error.HTTPError as error:
+				# 4xx: the batch itself is rejected, sending it again won't help
+				if 400 <= error.code < 500:
+					print(f"Error in InfluxDB insertion: {error.code} {error.read()[:200]!r}")
+					self._count("failed", len(lines))
+					return
+			except (urllib.error.URLError, OSError):
+				pass
+		else:
+			print(f"Error in InfluxDB insertion: {len(lines)} {measurement} points dropped after {self.max_retries} retries")
+			self._count("failed", len(lines))
+			return
+
+		with self._counters_lock:
+			self.counters["written"] += len(lines)
+			self.counters["flushes"] += 1
+			if len(self._flush_latencies) >= self._max_latency_samples:
+				self._flush_latencies = self._flush_latencies[self._max_latency_samples // 2:]
+			self._flush_latencies.append(time.monotonic() - start)
+
+	@staticmethod
+	def _escape(value: str, characters: str) -> str:
+
+		for character in "\\" + characters:
+			value = value.replace(character, "\\" + character)
+		return value
+
+	@classmethod
+	def _field_value(cls, value) -> Optional[str]:
+
+		if isinstance(value, bool):
+			return "true" if value else "false"
+		if isinstance(value, int):
+			return f"{value}i"
+		if isinstance(value, float):
+			return repr(value) if math.isfinite(value) else None
+		if value is None:
+			return None
+		return '"' + str(value).replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+	@classmethod
+	def to_line_protocol(cls, point: dict) -> str:
+
+		"""
+		Encodes a write_points style dictionary as one line of the InfluxDB line protocol. Fields with a None key or a non-finite value are skipped.
+		"""
+
+		line = cls._escape(point["measurement"], ", ")
+		for key, value in sorted(point.get("tags", {}).items()):
+			if key is None or value is None or str(value) == "":
+				continue
+			line += f",{cls._escape(str(key), ',= ')}={cls._escape(str(value), ',= ')}"
+
+		fields = []
+		for key, value in point["fields"].items():
+			encoded = cls._field_value(value)
+			if key is None or encoded is None:
+				continue
+			fields.append(f"{cls._escape(str(key), ',= ')}={encoded}")
+		if not fields:
+			raise ValueError(f"point of {point['measurement']} has no valid field")
+		line += " " + ",".join(fields)
+
+		if point.get("time") is not None:
+			line += f" {int(point['time'])}"
+		return line
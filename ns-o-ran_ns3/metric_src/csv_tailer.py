@@ -0,0 +1,106 @@
+import os
+import csv
+import threading
+from typing import Dict, List, Optional
+
+
+class CsvTailer:
+
+	"""
+	Incremental reader of CSV files that only grow, such as the E2 KPM logs written by the scenario.
+
+	For every file it remembers the header, the byte offset already consumed and the trailing partial line, so each call to read_new_rows parses only the complete lines appended since the previous call. A file that shrinks (rewritten by a new run) is read again from the start.
+
+	Attributes
+	----------
+	states : Dict[str, dict]
+		Per-file state: offset, header, partial line and lock.
+
+	Methods
+	-------
+	read_new_rows(path)
+		Returns the rows appended to path since the last call, as dictionaries.
+
+	forget(path)
+		Drops the state of path.
+	"""
+
+	def __init__(self):
+
+		"""
+		Initializes the class
+		"""
+
+		self.states: Dict[str, dict] = {}
+		self._states_lock = threading.Lock()
+
+	def _state(self, path: str) -> dict:
+
+		with self._states_lock:
+			state = self.states.get(path)
+			if state is None:
+				state = {"offset": 0, "header": None, "partial": b"", "lock": threading.Lock()}
+				self.states[path] = state
+			return state
+
+	def read_new_rows(self, path: str) -> List[Dict[str, str]]:
+
+		"""
+		Returns the rows appended to path since the last call. Calls for different files can run concurrently; calls for the same file are serialized.
+		"""
+
+		state = self._state(path)
+		with state["lock"]:
+			try:
+				size = os.path.getsize(path)
+			except OSError:
+				return []
+
+			if size < state["offset"]:
+				# The file was truncated or replaced: start over
+				state.update(offset=0, header=None, partial=b"")
+			if size == state["offset"]:
+				return []
+
+			with open(path, "rb") as csv_file:
+				csv_file.seek(state["offset"])
+				data = csv_file.read(size - state["offset"])
+			state["offset"] += len(data)
+
+			data = state["partial"] + data
+			end = data.rfind(b"\n")
+			if end < 0:
+				state["partial"] = data
+				return []
+			state["partial"] = data[end + 1:]
+
+			lines = data[:end].decode("utf-8", errors="replace").splitlines()
+			rows = []
+			for values in csv.reader(lines):
+				if not values:
+					continue
+				if state["header"] is None:
+					state["header"] = values
+					continue
+				# Like csv.DictReader, with missing trailing values read as ''
+				rows.append({name: values[i] if i < len(values) else ""
+							 for i, name in enumerate(state["header"])})
+			return rows
+
+	def header(self, path: str) -> Optional[List[str]]:
+
+		"""
+		Returns the header of path, once it has been read.
+		"""
+
+		state = self.states.get(path)
+		return state["header"] if state else None
+
+	def forget(self, path: str):
+
+		"""
+		Drops the state of path, e.g. when it is deleted.
+		"""
+
+		with self._states_lock:
+			self.states.pop(path, None)
@@ -0,0 +1,199 @@
+import os
+import sys
+import mmap
+import time
+from typing import List, Tuple
+
+import numpy as np
+
+
+class KpmShmReader:
+
+	"""
+	Follows the shared-memory KPM ring published by the slicing scenario with --kpmShm=<name>.
+
+	The segment /dev/shm/<name> is a 128-byte header followed by a ring of fixed 64-byte records (see kpm-shm-ring.h). The records are exposed as numpy structured views of the mapping, with no copy and no parsing; the producer never waits, so a reader that falls more than one ring behind loses the oldest records, which are counted in lost.
+
+	Attributes
+	----------
+	record_types : list
+		Names of the record types, indexed by the "type" field.
+
+	dtype : np.dtype
+		Layout of one record, see kpm-shm-ring.h.
+
+	lost : int
+		Records overwritten before this reader got to them.
+
+	Methods
+	-------
+	read(max_records)
+		Returns the views of the records published since the last call.
+
+	read_frame(max_records)
+		Same as read, as one pandas DataFrame.
+	"""
+
+	magic = b"SADKPM01"
+	header_size = 128
+	record_types = ["cu_cp", "cu_up", "du", "ue_throughput"]
+	dtype = np.dtype([
+		("time", "<f8"),
+		("imsi", "<u8"),
+		("ue", "<u4"),
+		("cell_id", "<u2"),
+		("type", "u1"),
+		("flags", "u1"),
+		("count", "<u4"),
+		("reserved", "<u4"),
+		("v0", "<f8"),
+		("v1", "<f8"),
+		("v2", "<f8"),
+		("v3", "<f8")])
+
+	def __init__(self, name: str, from_start: bool = True):
+
+		"""
+		Maps the segment; raises FileNotFoundError until the scenario has created it. from_start = False skips the records already published.
+		"""
+
+		self.path = os.path.join("/dev/shm", name.lstrip("/"))
+		with open(self.path, "rb") as shm_file:
+			self._map = mmap.mmap(shm_file.fileno(), 0, access=mmap.ACCESS_READ)
+		header = np.frombuffer(self._map, dtype=np.uint8, count=self.header_size)
+		if bytes(header[:8]) != self.magic:
+			raise ValueError(f"{self.path} is not a KPM ring")
+		record_size = int(header[8:12].view("<u4")[0])
+		if record_size != self.dtype.itemsize:
+			raise ValueError(f"unexpected record size {record_size}")
+		self.capacity = int(header[16:24].view("<u8")[0])
+		self.start_wall_ns = int(header[24:32].view("<u8")[0])
+		# Live views of the fields the producer updates; each is one aligned load
+		self._closed = header[12:16].view("<u4")
+		self._write_index = header[64:72].view("<u8")
+		self.records = np.frombuffer(self._map, dtype=self.dtype, count=self.capacity, offset=self.header_size)
+		written = self.written()
+		self.read_index = max(written + 1 - self.capacity, 0) if from_start else written
+		self.lost = 0
+
+	def written(self) -> int:
+
+		"""
+		Returns the number of records published since the start.
+		"""
+
+		return int(self._write_index[0])
+
+	def closed(self) -> bool:
+
+		"""
+		Returns True once the scenario is done publishing.
+		"""
+
+		return int(self._closed[0]) != 0
+
+	def read(self, max_records: int = 0) -> List[np.ndarray]:
+
+		"""
+		Returns the records published since the last call, up to max_records (0 for all), as at most two views of the ring (the second one after the wrap).
+
+		The views point into the shared memory: they are only guaranteed to hold the returned records until the producer publishes capacity more records, so copy what is kept beyond that. Records already overwritten when the call returns are dropped from the views and counted in lost.
+		"""
+
+		written = self.written()
+		if written + 1 - self.read_index > self.capacity:
+			self.lost += written + 1 - self.read_index - self.capacity
+			self.read_index = written + 1 - self.capacity
+		count = written - self.read_index
+		if max_records:
+			count = min(count, max_records)
+		if count == 0:
+			return []
+
+		first, count = self._validate(self.read_index, count)
+		self.read_index = first + count
+		return self._views(first, count)
+
+	def _validate(self, first: int, count: int) -> Tuple[int, int]:
+
+		# Re-read the write index: the records below written + 1 - capacity may
+		# have been overwritten since it was first read (the producer writes
+		# record written over record written - capacity before publishing it)
+		oldest = self.written() - self.capacity + 1
+		if oldest > first:
+			skipped = min(count, oldest - first)
+			self.lost += skipped
+			return first + skipped, count - skipped
+		return first, count
+
+	def _views(self, first: int, count: int) -> List[np.ndarray]:
+
+		if count == 0:
+			return []
+		slot = first % self.capacity
+		head = min(count, self.capacity - slot)
+		views = [self.records[slot:slot + head]]
+		if head < count:
+			views.append(self.records[:count - head])
+		return views
+
+	def read_frame(self, max_records: int = 0):
+
+		"""
+		Returns the records published since the last call as a pandas DataFrame (a copy), with the record type names as a categorical column. The meaning of count and v0..v3 depends on the record type, see kpm-shm-ring.h.
+		"""
+
+		import pandas as pd
+
+		views = self.read(max_records)
+		records = np.concatenate(views) if views else np.empty(0, dtype=self.dtype)
+		frame = pd.DataFrame(records)
+		frame["type"] = pd.Categorical.from_codes(frame["type"], categories=self.record_types)
+		return frame
+
+	def close(self):
+
+		"""
+		Unmaps the segment. Views returned by read that are still referenced keep the mapping alive until they are released.
+		"""
+
+		self.records = self._closed = self._write_index = None
+		try:
+			self._map.close()
+		except BufferError:
+			pass
+
+
+if __name__ == "__main__":
+	# Prints the record rate every second until the scenario closes the ring
+	name = sys.argv[1] if len(sys.argv) > 1 else "/sad_kpm"
+	while True:
+		try:
+			reader = KpmShmReader(name)
+			break
+		except FileNotFoundError:
+			time.sleep(0.1)
+
+	per_type = np.zeros(len(KpmShmReader.record_types), dtype=np.int64)
+	total = last_total = 0
+	last_print = time.time()
+	while True:
+		closed = reader.closed()
+		views = reader.read()
+		for view in views:
+			per_type += np.bincount(view["type"], minlength=len(per_type))[:len(per_type)]
+			total += len(view)
+		if not views:
+			if closed:
+				break
+			time.sleep(0.001)
+		now = time.time()
+		if now - last_print >= 1:
+			print(f"records {total} ({(total - last_total) / (now - last_print):.0f}/s), lost {reader.lost}", flush=True)
+			last_print, last_total = now, total
+
+	views = view = None  # release the views before unmapping
+	print(f"Ring closed: {total} records, lost {reader.lost}")
+	for name, count in zip(KpmShmReader.record_types, per_type):
+		print(f"  {name}: {count}")
+	reader.close()
@@ -0,0 +1,63 @@
+import sys
+import numpy as np
+
+
+class ScenarioLogReader:
+
+	"""
+	Loads the scenario_log.bin file written by the slicing scenario with --logMode=binary.
+
+	The file is the 8-byte magic "SADLOG01", the record size (uint32) and fixed 32-byte records, so it is read in one call as a numpy structured array.
+
+	Attributes
+	----------
+	categories : list
+		Names of the log categories, indexed by the "category" field.
+
+	dtype : np.dtype
+		Layout of one record, see scenario-logger.h.
+	"""
+
+	magic = b"SADLOG01"
+	categories = ["throughput", "slice"]
+	dtype = np.dtype([
+		("time", "<f8"),
+		("category", "u1"),
+		("pad", "u1", (3,)),
+		("ue", "<u4"),
+		("v0", "<f8"),
+		("v1", "<f8")])
+
+	def load(self, file_name: str) -> np.ndarray:
+
+		"""
+		Returns all the records of file_name.
+		"""
+
+		with open(file_name, "rb") as log_file:
+			header = log_file.read(12)
+			if header[:8] != self.magic:
+				raise ValueError(f"{file_name} is not a scenario log file")
+			record_size = int(np.frombuffer(header[8:12], dtype="<u4")[0])
+			if record_size != self.dtype.itemsize:
+				raise ValueError(f"unexpected record size {record_size}")
+			return np.fromfile(log_file, dtype=self.dtype)
+
+	def load_frame(self, file_name: str):
+
+		"""
+		Returns the records as a pandas DataFrame, with the category names as a categorical column. For "throughput" v0 is the rate in Mbps; for "slice" v0 is the slice index and v1 the node id.
+		"""
+
+		import pandas as pd
+
+		records = self.load(file_name)
+		frame = pd.DataFrame({name: records[name] for name in ("time", "category", "ue", "v0", "v1")})
+		frame["category"] = pd.Categorical.from_codes(frame["category"], categories=self.categories)
+		return frame
+
+
+if __name__ == "__main__":
+	records = ScenarioLogReader().load(sys.argv[1])
+	for category_id, name in enumerate(ScenarioLogReader.categories):
+		print(f"{name}: {int(np.count_nonzero(records['category'] == category_id))} records")
@@ -0,0 +1,66 @@
+import sys
+import numpy as np
+
+
+class TraceReader:
+
+	"""
+	Loads the traces.bin file written by the slicing scenario with --traceSelection.
+
+	The file is the 8-byte magic "SADTRC01", the record size (uint32) and fixed 40-byte records, so it is read in one call as a numpy structured array.
+
+	Attributes
+	----------
+	record_types : list
+		Names of the record types, indexed by the "type" field.
+
+	dtype : np.dtype
+		Layout of one record, see trace-record-sink.h.
+	"""
+
+	magic = b"SADTRC01"
+	record_types = ["phy_dl", "phy_ul", "mac_lte", "rlc_dl", "pdcp_dl"]
+	dtype = np.dtype([
+		("time", "<f8"),
+		("cell_id", "<u4"),
+		("ue", "<u4"),
+		("type", "u1"),
+		("flags", "u1"),
+		("lcid", "<u2"),
+		("size", "<u4"),
+		("v0", "<f8"),
+		("v1", "<f8")])
+
+	def load(self, file_name: str) -> np.ndarray:
+
+		"""
+		Returns all the records of file_name.
+		"""
+
+		with open(file_name, "rb") as trace_file:
+			header = trace_file.read(12)
+			if header[:8] != self.magic:
+				raise ValueError(f"{file_name} is not a scenario trace file")
+			record_size = int(np.frombuffer(header[8:12], dtype="<u4")[0])
+			if record_size != self.dtype.itemsize:
+				raise ValueError(f"unexpected record size {record_size}")
+			return np.fromfile(trace_file, dtype=self.dtype)
+
+	def load_frame(self, file_name: str):
+
+		"""
+		Returns the records as a pandas DataFrame, with the record type names as a categorical column. The meaning of v0 and v1 depends on the record type, see trace-record-sink.h.
+		"""
+
+		import pandas as pd
+
+		records = self.load(file_name)
+		frame = pd.DataFrame(records)
+		frame["type"] = pd.Categorical.from_codes(frame["type"], categories=self.record_types)
+		return frame
+
+
+if __name__ == "__main__":
+	records = TraceReader().load(sys.argv[1])
+	for type_id, name in enumerate(TraceReader.record_types):
+		print(f"{name}: {int(np.count_nonzero(records['type'] == type_id))} records")
@@ -0,0 +1,441 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef CACHED_UMI_PROPAGATION_LOSS_MODEL_H
+#define CACHED_UMI_PROPAGATION_LOSS_MODEL_H
+
+#include "pathloss-map.h"
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/network-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/spectrum-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+namespace ns3 {
+
+/**
+ * The 3GPP UMi street canyon pathloss, read from a precomputed map (see
+ * pathloss-map.h) instead of computed per link and per channel update.
+ *
+ * It is a ThreeGppUmiStreetCanyonPropagationLossModel, put in place of the
+ * helpers' one with UseCachedUmiPathloss below. The end of a link
+ * with a ConstantPositionMobilityModel is the site: the grid of a site is
+ * built with the exact model the first time it is seen, or found in
+ * MapFile, which is memory-mapped at the first query and rewritten at
+ * Simulator::Destroy when new sites were built.
+ *
+ * Approximations, measured by pathloss-map-benchmark: the pathloss is
+ * interpolated between grid points (the exact model is used within two
+ * grid steps of the site, where the loss varies the most); the
+ * shadowing is a fixed field with a correlation distance of about the
+ * grid resolution, instead of a per-link process. Links outside Bounds,
+ * with UEs at another height than UeHeight, or between two sites, use the
+ * exact model. The LOS state comes from the shared channel condition
+ * model, the one the fast fading uses; LosFromMap takes that of the
+ * nearest grid point instead, which is cheaper but can disagree with the
+ * fading.
+ */
+class CachedUmiPropagationLossModel : public ThreeGppUmiStreetCanyonPropagationLossModel
+{
+public:
+  static TypeId
+  GetTypeId ()
+  {
+    static TypeId tid =
+        TypeId ("ns3::CachedUmiPropagationLossModel")
+            .SetParent<ThreeGppUmiStreetCanyonPropagationLossModel> ()
+            .SetGroupName ("Propagation")
+            .AddConstructor<CachedUmiPropagationLossModel> ()
+            .AddAttribute ("MapFile",
+                           "Map file to load and update, empty to keep the map in memory",
+                           StringValue (""),
+                           MakeStringAccessor (&CachedUmiPropagationLossModel::m_mapFile),
+                           MakeStringChecker ())
+            .AddAttribute ("Resolution", "Grid step [m]", DoubleValue (10),
+                           MakeDoubleAccessor (&CachedUmiPropagationLossModel::m_resolution),
+                           MakeDoubleChecker<double> (0.1))
+            .AddAttribute ("Bounds", "Area covered by the grid",
+                           RectangleValue (Rectangle (0, 4000, 0, 4000)),
+                           MakeRectangleAccessor (&CachedUmiPropagationLossModel::m_bounds),
+                           MakeRectangleChecker ())
+            .AddAttribute ("UeHeight", "Height of the UEs [m]", DoubleValue (1.5),
+                           MakeDoubleAccessor (&CachedUmiPropagationLossModel::m_ueHeight),
+                           MakeDoubleChecker<double> ())
+            .AddAttribute ("Seed", "Seed of the LOS states and shadowing of the map",
+                           UintegerValue (1),
+                           MakeUintegerAccessor (&CachedUmiPropagationLossModel::m_seed),
+                           MakeUintegerChecker<uint64_t> ())
+            .AddAttribute ("LosFromMap",
+                           "Take the LOS state from the map, else from the channel condition model",
+                           BooleanValue (false),
+                           MakeBooleanAccessor (&CachedUmiPropagationLossModel::m_losFromMap),
+                           MakeBooleanChecker ());
+    return tid;
+  }
+
+  struct Stats
+  {
+    uint64_t queries = 0;
+    uint64_t mapHits = 0;   ///< interpolated from the map
+    uint64_t nearSite = 0;  ///< exact pathloss close to the site, LOS and shadowing from the map
+    uint64_t fallbacks = 0; ///< exact model
+    uint32_t sitesBuilt = 0;
+    uint32_t sitesLoaded = 0;
+    double buildSeconds = 0;
+  };
+
+  const Stats &
+  GetStats () const
+  {
+    return m_stats;
+  }
+
+  /**
+   * Map values of the link, for the accuracy report: pathloss and shadowing
+   * [dB] and LOS state, the one the model uses (see LosFromMap).
+   * \return false if the link is not served by the map
+   */
+  bool
+  LookupMap (Ptr<MobilityModel> a, Ptr<MobilityModel> b, double &pathlossDb, double &shadowDb,
+             bool &los) const
+  {
+    Init ();
+    int32_t site;
+    Vector ue;
+    if (!FindLink (a, b, site, ue))
+      {
+        return false;
+      }
+    bool conditionLos =
+        !m_losFromMap && GetChannelConditionModel ()->GetChannelCondition (a, b)->IsLos ();
+    return m_map.Lookup (site, ue.x, ue.y, pathlossDb, shadowDb, los,
+                         m_losFromMap ? nullptr : &conditionLos);
+  }
+
+  /// Pathloss of the exact model for the given LOS state, without shadowing [dB]
+  double
+  CalcExactLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b, bool los) const
+  {
+    Init ();
+    return -(los ? m_losModel : m_nlosModel)->CalcRxPower (0, a, b);
+  }
+
+protected:
+  void
+  DoDispose () override
+  {
+    m_exact = nullptr;
+    m_losModel = nullptr;
+    m_nlosModel = nullptr;
+    m_siteOf.clear ();
+    ThreeGppUmiStreetCanyonPropagationLossModel::DoDispose ();
+  }
+
+private:
+  double
+  DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const override
+  {
+    Init ();
+    ++m_stats.queries;
+    int32_t site;
+    Vector ue;
+    double pathlossDb, shadowDb;
+    bool los;
+    if (!FindLink (a, b, site, ue))
+      {
+        ++m_stats.fallbacks;
+        return m_exact->CalcRxPower (txPowerDbm, a, b);
+      }
+    bool conditionLos =
+        !m_losFromMap && GetChannelConditionModel ()->GetChannelCondition (a, b)->IsLos ();
+    if (!m_map.Lookup (site, ue.x, ue.y, pathlossDb, shadowDb, los,
+                       m_losFromMap ? nullptr : &conditionLos))
+      {
+        ++m_stats.fallbacks;
+        return m_exact->CalcRxPower (txPowerDbm, a, b);
+      }
+    const pathlossmap::Site &s = m_map.GetSite (site);
+    if (std::hypot (ue.x - s.x, ue.y - s.y) < 2 * m_resolution)
+      {
+        ++m_stats.nearSite;
+        pathlossDb = -(los ? m_losModel : m_nlosModel)->CalcRxPower (0, a, b);
+      }
+    else
+      {
+        ++m_stats.mapHits;
+      }
+    return txPowerDbm - pathlossDb - (m_shadowing ? shadowDb : 0);
+  }
+
+  void
+  Init () const
+  {
+    if (m_initialized)
+      {
+        return;
+      }
+    m_initialized = true;
+    BooleanValue shadowing;
+    GetAttribute ("ShadowingEnabled", shadowing);
+    m_shadowing = shadowing.Get ();
+
+    m_exact = CreateObject<ThreeGppUmiStreetCanyonPropagationLossModel> ();
+    m_exact->SetAttribute ("ShadowingEnabled", BooleanValue (m_shadowing));
+    m_exact->SetFrequency (GetFrequency ());
+    m_exact->SetChannelConditionModel (GetChannelConditionModel ());
+    m_losModel = CreateObject<ThreeGppUmiStreetCanyonPropagationLossModel> ();
+    m_losModel->SetAttribute ("ShadowingEnabled", BooleanValue (false));
+    m_losModel->SetFrequency (GetFrequency ());
+    m_losModel->SetChannelConditionModel (CreateObject<AlwaysLosChannelConditionModel> ());
+    m_nlosModel = CreateObject<ThreeGppUmiStreetCanyonPropagationLossModel> ();
+    m_nlosModel->SetAttribute ("ShadowingEnabled", BooleanValue (false));
+    m_nlosModel->SetFrequency (GetFrequency ());
+    m_nlosModel->SetChannelConditionModel (CreateObject<NeverLosChannelConditionModel> ());
+
+    pathlossmap::GridSpec spec;
+    spec.minX = m_bounds.xMin;
+    spec.minY = m_bounds.yMin;
+    spec.maxX = m_bounds.xMax;
+    spec.maxY = m_bounds.yMax;
+    spec.resolution = m_resolution;
+    spec.frequency = GetFrequency ();
+    spec.ueHeight = m_ueHeight;
+    spec.seed = m_seed;
+    m_map.SetSpec (spec);
+    if (!m_mapFile.empty ())
+      {
+        std::string error = m_map.Load (m_mapFile);
+        m_stats.sitesLoaded = m_map.GetNSites ();
+        NS_LOG_UNCOND ("Pathloss map " << m_mapFile << ": "
+                                       << (error.empty () ? std::to_string (m_stats.sitesLoaded) +
+                                                                " sites loaded"
+                                                          : error + ", building it"));
+      }
+    Simulator::ScheduleDestroy (&CachedUmiPropagationLossModel::Finish,
+                                Ptr<const CachedUmiPropagationLossModel> (this));
+  }
+
+  /**
+   * Site index and UE position of the link, building the grid of a new
+   * site. \return false if the map does not apply to the link
+   */
+  bool
+  FindLink (Ptr<MobilityModel> a, Ptr<MobilityModel> b, int32_t &site, Vector &ue) const
+  {
+    int32_t siteA = SiteOf (a);
+    int32_t siteB = SiteOf (b);
+    if ((siteA < 0) == (siteB < 0))
+      {
+        return false;
+      }
+    site = siteA >= 0 ? siteA : siteB;
+    ue = (siteA >= 0 ? b : a)->GetPosition ();
+    return std::abs (ue.z - m_ueHeight) < 0.01;
+  }
+
+  int32_t
+  SiteOf (Ptr<MobilityModel> m) const
+  {
+    auto it = m_siteOf.find (PeekPointer (m));
+    if (it != m_siteOf.end ())
+      {
+        return it->second;
+      }
+    int32_t site = -1;
+    if (DynamicCast<ConstantPositionMobilityModel> (m))
+      {
+        Vector p = m->GetPosition ();
+        site = m_map.FindSite (p.x, p.y, p.z);
+        if (site < 0)
+          {
+            auto start = std::chrono::steady_clock::now ();
+            Ptr<ConstantPositionMobilityModel> bs = CreateObject<ConstantPositionMobilityModel> ();
+            Ptr<ConstantPositionMobilityModel> ut = CreateObject<ConstantPositionMobilityModel> ();
+            bs->SetPosition (p);
+            auto exact = [&] (double x, double y, double &lossLos, double &lossNlos) {
+              ut->SetPosition (Vector (x, y, m_ueHeight));
+              lossLos = -m_losModel->CalcRxPower (0, bs, ut);
+              lossNlos = -m_nlosModel->CalcRxPower (0, bs, ut);
+            };
+            site = m_map.BuildSite (p.x, p.y, p.z, exact);
+            ++m_stats.sitesBuilt;
+            m_stats.buildSeconds +=
+                std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+          }
+      }
+    m_siteOf[PeekPointer (m)] = site;
+    return site;
+  }
+
+  void
+  Finish () const
+  {
+    NS_LOG_UNCOND ("Pathloss map: " << m_stats.queries << " queries, " << m_stats.mapHits
+                                    << " from the map, " << m_stats.nearSite << " near a site, "
+                                    << m_stats.fallbacks << " exact; " << m_stats.sitesLoaded
+                                    << " sites loaded, " << m_stats.sitesBuilt << " built in "
+                                    << m_stats.buildSeconds << " s");
+    if (!m_mapFile.empty () && m_map.IsDirty ())
+      {
+        NS_LOG_UNCOND ((m_map.Save (m_mapFile) ? "Pathloss map written to " : "Can't write ")
+                       << m_mapFile);
+      }
+  }
+
+  std::string m_mapFile;
+  double m_resolution = 10;
+  Rectangle m_bounds;
+  double m_ueHeight = 1.5;
+  uint64_t m_seed = 1;
+  bool m_losFromMap = false;
+
+  // Built at the first query, once the helpers have set the frequency and condition model
+  mutable bool m_initialized = false;
+  mutable bool m_shadowing = true;
+  mutable pathlossmap::Map m_map;
+  mutable std::unordered_map<const MobilityModel *, int32_t> m_siteOf;
+  mutable Ptr<ThreeGppUmiStreetCanyonPropagationLossModel> m_exact;
+  mutable Ptr<ThreeGppUmiStreetCanyonPropagationLossModel> m_losModel;
+  mutable Ptr<ThreeGppUmiStreetCanyonPropagationLossModel> m_nlosModel;
+  mutable Stats m_stats;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (CachedUmiPropagationLossModel);
+
+/// A stock UMi model of a channel and the CachedUmiPropagationLossModel put in its place
+struct CachedUmiSwap
+{
+  Ptr<SpectrumChannel> channel;
+  Ptr<ThreeGppUmiStreetCanyonPropagationLossModel> stock;
+  Ptr<CachedUmiPropagationLossModel> cached;
+};
+
+/**
+ * Replace the ThreeGppUmiStreetCanyonPropagationLossModel of every spectrum
+ * channel with a CachedUmiPropagationLossModel, with the same frequency,
+ * channel condition model and shadowing setting. Call it once the devices
+ * are installed. The helpers are given the stock model because they derive
+ * the 3GPP channel scenario from the name of the pathloss type.
+ * \return the models replaced, for CheckCachedUmiPathloss
+ */
+inline std::vector<CachedUmiSwap>
+UseCachedUmiPathloss ()
+{
+  std::vector<CachedUmiSwap> swaps;
+  for (uint32_t i = 0; i < ChannelList::GetNChannels (); ++i)
+    {
+      Ptr<SpectrumChannel> channel = DynamicCast<SpectrumChannel> (ChannelList::GetChannel (i));
+      Ptr<PropagationLossModel> head = channel ? channel->GetPropagationLossModel () : nullptr;
+      if (!head ||
+          head->GetInstanceTypeId () != ThreeGppUmiStreetCanyonPropagationLossModel::GetTypeId ())
+        {
+          continue;
+        }
+      Ptr<ThreeGppUmiStreetCanyonPropagationLossModel> umi =
+          DynamicCast<ThreeGppUmiStreetCanyonPropagationLossModel> (head);
+      Ptr<CachedUmiPropagationLossModel> cached = CreateObject<CachedUmiPropagationLossModel> ();
+      BooleanValue shadowing;
+      umi->GetAttribute ("ShadowingEnabled", shadowing);
+      cached->SetAttribute ("ShadowingEnabled", shadowing);
+      cached->SetFrequency (umi->GetFrequency ());
+      cached->SetChannelConditionModel (umi->GetChannelConditionModel ());
+      // The new head of the chain, followed by what followed the stock model
+      channel->AddPropagationLossModel (cached);
+      cached->SetNext (umi->GetNext ());
+      swaps.push_back (CachedUmiSwap{channel, umi, cached});
+    }
+  return swaps;
+}
+
+/**
+ * Check the replacements of UseCachedUmiPathloss on site-UE pairs: the
+ * stock model must be out of the channel's loss chain, and the chain must
+ * give the pathloss of the stock model, shadowing aside, within toleranceDb
+ * on every pair served by the map. The stock models are left without
+ * shadowing, they are no longer used by the channels.
+ * \return an empty string, or the first failure
+ */
+inline std::string
+CheckCachedUmiPathloss (const std::vector<CachedUmiSwap> &swaps, const NodeContainer &sites,
+                        const NodeContainer &ues, double toleranceDb, double &maxErrorDb,
+                        uint32_t &pairs)
+{
+  maxErrorDb = 0;
+  pairs = 0;
+  for (const CachedUmiSwap &swap : swaps)
+    {
+      Ptr<PropagationLossModel> chain = swap.channel->GetPropagationLossModel ();
+      if (chain != swap.cached)
+        {
+          return "the pathloss map is not the head of the channel's loss chain";
+        }
+      for (Ptr<PropagationLossModel> m = chain; m; m = m->GetNext ())
+        {
+          if (m == swap.stock)
+            {
+              return "the stock UMi model is still in the channel's loss chain";
+            }
+        }
+      if (chain->GetNext ())
+        {
+          // Only the map is compared below: other losses in the chain add to it
+          continue;
+        }
+      BooleanValue shadowing;
+      swap.cached->GetAttribute ("ShadowingEnabled", shadowing);
+      swap.stock->SetAttribute ("ShadowingEnabled", BooleanValue (false));
+      for (uint32_t s = 0; s < sites.GetN (); ++s)
+        {
+          Ptr<MobilityModel> site = sites.Get (s)->GetObject<MobilityModel> ();
+          for (uint32_t u = 0; u < ues.GetN (); ++u)
+            {
+              Ptr<MobilityModel> ue = ues.Get (u)->GetObject<MobilityModel> ();
+              double pathlossDb, shadowDb;
+              bool los;
+              if (!swap.cached->LookupMap (site, ue, pathlossDb, shadowDb, los))
+                {
+                  continue;
+                }
+              double mapped = -chain->CalcRxPower (0, site, ue) - (shadowing.Get () ? shadowDb : 0);
+              double exact = -swap.stock->CalcRxPower (0, site, ue);
+              double error = std::abs (mapped - exact);
+              maxErrorDb = std::max (maxErrorDb, error);
+              ++pairs;
+              if (error > toleranceDb)
+                {
+                  std::ostringstream message;
+                  message << "pathloss " << mapped << " dB from the map, " << exact
+                          << " dB from the stock model, between site " << site->GetPosition ()
+                          << " and UE " << ue->GetPosition ();
+                  return message.str ();
+                }
+            }
+        }
+    }
+  return "";
+}
+
+} // namespace ns3
+
+#endif /* CACHED_UMI_PROPAGATION_LOSS_MODEL_H */
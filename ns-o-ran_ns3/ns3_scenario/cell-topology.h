@@ -0,0 +1,300 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef CELL_TOPOLOGY_H
+#define CELL_TOPOLOGY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+/**
+ * Site layouts and a uniform-grid spatial index for the base stations of
+ * the slicing scenario. Positions are 2D offsets in meters; the scenario
+ * adds the center of the area and the antenna height.
+ */
+namespace topology {
+
+struct Point2d
+{
+  double x;
+  double y;
+};
+
+/**
+ * The original layout: one site at the center and the others on a single
+ * ring of radius isd.
+ */
+inline std::vector<Point2d>
+RingPositions (uint32_t n, double isd)
+{
+  std::vector<Point2d> positions;
+  if (n == 0)
+    {
+      return positions;
+    }
+  positions.push_back ({0, 0});
+  double nConstellation = n - 1;
+  for (uint32_t i = 0; i < n - 1; ++i)
+    {
+      positions.push_back ({isd * std::cos ((2 * M_PI * i) / nConstellation),
+                            isd * std::sin ((2 * M_PI * i) / nConstellation)});
+    }
+  return positions;
+}
+
+/**
+ * The first n sites of a hexagonal grid with inter-site distance isd,
+ * ring by ring: the center, then the 6 sites of ring 1, the 12 of ring 2...
+ */
+inline std::vector<Point2d>
+HexPositions (uint32_t n, double isd)
+{
+  // Axial steps along the six sides of a hexagonal ring
+  static const int kDirections[6][2] = {{1, 0}, {1, -1}, {0, -1}, {-1, 0}, {-1, 1}, {0, 1}};
+
+  std::vector<Point2d> positions;
+  positions.reserve (n);
+  auto add = [&] (int q, int r) {
+    positions.push_back ({isd * (q + r / 2.0), isd * r * std::sqrt (3.0) / 2});
+  };
+
+  if (n > 0)
+    {
+      add (0, 0);
+    }
+  for (int ring = 1; positions.size () < n; ++ring)
+    {
+      // Start on the corner (-ring, ring) and walk the six sides of the ring
+      int q = -ring;
+      int r = ring;
+      for (int side = 0; side < 6 && positions.size () < n; ++side)
+        {
+          for (int step = 0; step < ring && positions.size () < n; ++step)
+            {
+              add (q, r);
+              q += kDirections[side][0];
+              r += kDirections[side][1];
+            }
+        }
+    }
+  return positions;
+}
+
+/// Largest distance of a position from the origin
+inline double
+Extent (const std::vector<Point2d> &positions)
+{
+  double extent = 0;
+  for (const Point2d &p : positions)
+    {
+      extent = std::max (extent, std::hypot (p.x, p.y));
+    }
+  return extent;
+}
+
+/**
+ * Splits the sites into n clusters of contiguous angular sectors around the
+ * origin, with about the same number of sites each. Sites at the origin go
+ * to cluster 0.
+ *
+ * \return the cluster of every site
+ */
+inline std::vector<uint32_t>
+SectorClusters (const std::vector<Point2d> &positions, uint32_t n)
+{
+  std::vector<uint32_t> clusters (positions.size (), 0);
+  std::vector<std::pair<double, uint32_t>> sectors; // (angle, site)
+  for (uint32_t i = 0; i < positions.size (); ++i)
+    {
+      if (std::hypot (positions[i].x, positions[i].y) > 1e-9)
+        {
+          sectors.emplace_back (std::atan2 (positions[i].y, positions[i].x), i);
+        }
+    }
+  std::sort (sectors.begin (), sectors.end ());
+  if (n == 0 || sectors.empty ())
+    {
+      return clusters;
+    }
+  // The center site counts towards cluster 0, which then takes one site less
+  uint32_t centers = positions.size () - sectors.size ();
+  for (uint32_t k = 0; k < sectors.size (); ++k)
+    {
+      clusters[sectors[k].second] =
+          std::min<uint32_t> (n - 1, uint64_t (k + centers) * n / positions.size ());
+    }
+  return clusters;
+}
+
+/**
+ * Uniform-grid index over a fixed set of points. Queries visit the grid
+ * cells in growing square rings around the query point and stop as soon as
+ * no unvisited cell can hold a closer point, so with cells about one
+ * inter-site distance wide a k-nearest query touches O(k) points instead
+ * of all of them.
+ */
+class GridIndex
+{
+public:
+  GridIndex (const std::vector<Point2d> &points, double cellSize)
+    : m_points (points),
+      m_cellSize (cellSize > 0 ? cellSize : 1)
+  {
+    if (points.empty ())
+      {
+        m_minX = m_minY = 0;
+        m_cols = m_rows = 1;
+        m_cells.resize (1);
+        return;
+      }
+    double maxX = points[0].x;
+    double maxY = points[0].y;
+    m_minX = points[0].x;
+    m_minY = points[0].y;
+    for (const Point2d &p : points)
+      {
+        m_minX = std::min (m_minX, p.x);
+        m_minY = std::min (m_minY, p.y);
+        maxX = std::max (maxX, p.x);
+        maxY = std::max (maxY, p.y);
+      }
+    m_cols = static_cast<int> ((maxX - m_minX) / m_cellSize) + 1;
+    m_rows = static_cast<int> ((maxY - m_minY) / m_cellSize) + 1;
+    m_cells.resize (static_cast<size_t> (m_cols) * m_rows);
+    for (uint32_t i = 0; i < points.size (); ++i)
+      {
+        m_cells[CellOf (points[i].x, points[i].y)].push_back (i);
+      }
+  }
+
+  /// \return the index of the point closest to (x, y), ties to the lowest index
+  uint32_t
+  Nearest (double x, double y) const
+  {
+    std::vector<uint32_t> nearest = KNearest (x, y, 1);
+    return nearest.empty () ? 0 : nearest[0];
+  }
+
+  /// \return the indices of the k points closest to (x, y), closest first
+  std::vector<uint32_t>
+  KNearest (double x, double y, uint32_t k) const
+  {
+    k = std::min<uint32_t> (k, m_points.size ());
+    std::vector<std::pair<double, uint32_t>> found; // (squared distance, index)
+    if (k == 0)
+      {
+        return {};
+      }
+
+    int cx = Clamp (static_cast<int> (std::floor ((x - m_minX) / m_cellSize)), m_cols);
+    int cy = Clamp (static_cast<int> (std::floor ((y - m_minY) / m_cellSize)), m_rows);
+
+    for (int ring = 0;; ++ring)
+      {
+        if (ring > 0)
+          {
+            // Distance from the query point to the closest grid cell that has
+            // not been visited yet, i.e., outside the square of radius ring - 1
+            double bound = std::numeric_limits<double>::infinity ();
+            if (cx - ring >= 0)
+              {
+                bound = std::min (bound, x - (m_minX + (cx - ring + 1) * m_cellSize));
+              }
+            if (cx + ring < m_cols)
+              {
+                bound = std::min (bound, m_minX + (cx + ring) * m_cellSize - x);
+              }
+            if (cy - ring >= 0)
+              {
+                bound = std::min (bound, y - (m_minY + (cy - ring + 1) * m_cellSize));
+              }
+            if (cy + ring < m_rows)
+              {
+                bound = std::min (bound, m_minY + (cy + ring) * m_cellSize - y);
+              }
+            if (std::isinf (bound))
+              {
+                break; // the whole grid has been visited
+              }
+            if (found.size () >= k && bound > 0)
+              {
+                std::nth_element (found.begin (), found.begin () + (k - 1), found.end ());
+                if (bound * bound > found[k - 1].first)
+                  {
+                    break;
+                  }
+              }
+          }
+
+        for (int gy = std::max (cy - ring, 0); gy <= std::min (cy + ring, m_rows - 1); ++gy)
+          {
+            bool edgeRow = (gy == cy - ring || gy == cy + ring);
+            for (int gx = cx - ring; gx <= cx + ring; gx += (edgeRow || ring == 0) ? 1 : 2 * ring)
+              {
+                if (gx < 0 || gx >= m_cols)
+                  {
+                    continue;
+                  }
+                for (uint32_t i : m_cells[static_cast<size_t> (gy) * m_cols + gx])
+                  {
+                    double dx = m_points[i].x - x;
+                    double dy = m_points[i].y - y;
+                    found.emplace_back (dx * dx + dy * dy, i);
+                  }
+              }
+          }
+      }
+
+    std::sort (found.begin (), found.end ());
+    std::vector<uint32_t> result;
+    for (uint32_t i = 0; i < k; ++i)
+      {
+        result.push_back (found[i].second);
+      }
+    return result;
+  }
+
+private:
+  static int
+  Clamp (int value, int size)
+  {
+    return std::min (std::max (value, 0), size - 1);
+  }
+
+  size_t
+  CellOf (double x, double y) const
+  {
+    int gx = Clamp (static_cast<int> ((x - m_minX) / m_cellSize), m_cols);
+    int gy = Clamp (static_cast<int> ((y - m_minY) / m_cellSize), m_rows);
+    return static_cast<size_t> (gy) * m_cols + gx;
+  }
+
+  std::vector<Point2d> m_points;
+  double m_cellSize;
+  double m_minX;
+  double m_minY;
+  int m_cols;
+  int m_rows;
+  std::vector<std::vector<uint32_t>> m_cells;
+};
+
+} // namespace topology
+
+#endif /* CELL_TOPOLOGY_H */
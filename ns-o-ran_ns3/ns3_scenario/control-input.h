@@ -0,0 +1,278 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef CONTROL_INPUT_H
+#define CONTROL_INPUT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Control commands received on a local Unix datagram socket, one command
+ * per datagram, as a line of text:
+ *
+ *   ho <seq> <sentNs> <imsi> <targetCellId>
+ *   slice <seq> <sentNs> <slice name> [interval=<s>] [size=<bytes>]
+ *
+ * seq is echoed in the latency report, sentNs is the CLOCK_REALTIME of the
+ * sender in ns (0 if unknown). A receiver thread blocks on the socket and
+ * hands every parsed command to a callback as soon as it arrives; the
+ * scenario forwards it to the simulator thread with ScheduleWithContext,
+ * so it is applied before the next event, with no polling period. See
+ * sim_tools/control_sender.py for a sender.
+ *
+ * Only the parsing and the thread live here, without ns-3 types, so that
+ * the same code can be exercised outside of the scenario.
+ */
+namespace controlinput {
+
+inline uint64_t
+WallNs ()
+{
+  struct timespec now;
+  clock_gettime (CLOCK_REALTIME, &now);
+  return uint64_t (now.tv_sec) * 1000000000ull + now.tv_nsec;
+}
+
+struct Command
+{
+  enum Type
+  {
+    HANDOVER,
+    SLICE
+  };
+
+  Type type = HANDOVER;
+  uint64_t seq = 0;
+  uint64_t sentNs = 0;
+  uint64_t arrivalNs = 0; ///< set by the receiver thread
+  uint64_t imsi = 0;      ///< HANDOVER
+  uint16_t targetCellId = 0;
+  std::string slice; ///< SLICE
+  double interval = 0; ///< [s], 0 to keep
+  uint32_t packetSize = 0; ///< [bytes], 0 to keep
+};
+
+/**
+ * Parse one datagram into command.
+ * \return an empty string, or the reason why the line is rejected
+ */
+inline std::string
+ParseCommand (const std::string &line, Command &command)
+{
+  std::istringstream in (line);
+  std::string type;
+  if (!(in >> type >> command.seq >> command.sentNs))
+    {
+      return "expected \"<type> <seq> <sentNs> ...\"";
+    }
+  if (type == "ho")
+    {
+      uint32_t cell;
+      if (!(in >> command.imsi >> cell) || cell == 0 || cell > 0xffff)
+        {
+          return "expected \"ho <seq> <sentNs> <imsi> <targetCellId>\"";
+        }
+      command.type = Command::HANDOVER;
+      command.targetCellId = cell;
+      return "";
+    }
+  if (type == "slice")
+    {
+      if (!(in >> command.slice))
+        {
+          return "expected \"slice <seq> <sentNs> <slice> [interval=<s>] [size=<bytes>]\"";
+        }
+      command.type = Command::SLICE;
+      std::string option;
+      while (in >> option)
+        {
+          size_t eq = option.find ('=');
+          std::string key = option.substr (0, eq);
+          const char *value = eq == std::string::npos ? "" : option.c_str () + eq + 1;
+          char *end;
+          if (key == "interval")
+            {
+              command.interval = std::strtod (value, &end);
+              if (*end != '\0' || !(command.interval > 0))
+                {
+                  return "invalid interval " + option;
+                }
+            }
+          else if (key == "size")
+            {
+              unsigned long size = std::strtoul (value, &end, 10);
+              if (*end != '\0' || size < 12 || size > 65507)
+                {
+                  return "invalid size " + option + " (12 to 65507 bytes)";
+                }
+              command.packetSize = size;
+            }
+          else
+            {
+              return "unknown slice option " + option;
+            }
+        }
+      if (command.interval == 0 && command.packetSize == 0)
+        {
+          return "slice command without interval or size";
+        }
+      return "";
+    }
+  return "unknown command type " + type;
+}
+
+class Receiver
+{
+public:
+  using CommandCallback = std::function<void (const Command &)>;
+  using ErrorCallback = std::function<void (const std::string &line, const std::string &error)>;
+
+  ~Receiver ()
+  {
+    Stop ();
+  }
+
+  /**
+   * Bind the socket at path (replacing a stale one) and start the thread.
+   * Both callbacks are called from the receiver thread.
+   */
+  bool
+  Start (const std::string &path, CommandCallback onCommand, ErrorCallback onError)
+  {
+    Stop ();
+    struct sockaddr_un addr;
+    if (path.empty () || path.size () >= sizeof (addr.sun_path))
+      {
+        return false;
+      }
+    m_fd = ::socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_fd < 0)
+      {
+        return false;
+      }
+    std::memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy (addr.sun_path, path.c_str (), path.size ());
+    ::unlink (path.c_str ());
+    if (::bind (m_fd, reinterpret_cast<struct sockaddr *> (&addr), sizeof (addr)) != 0)
+      {
+        ::close (m_fd);
+        m_fd = -1;
+        return false;
+      }
+    m_path = path;
+    m_stop = false;
+    m_thread = std::thread (&Receiver::Run, this, onCommand, onError);
+    return true;
+  }
+
+  /// Join the thread and remove the socket; no callback is called afterwards
+  void
+  Stop ()
+  {
+    if (m_fd < 0)
+      {
+        return;
+      }
+    m_stop = true;
+    m_thread.join ();
+    ::close (m_fd);
+    ::unlink (m_path.c_str ());
+    m_fd = -1;
+  }
+
+  bool
+  IsRunning () const
+  {
+    return m_fd >= 0;
+  }
+
+  uint64_t
+  GetReceived () const
+  {
+    return m_received;
+  }
+
+  uint64_t
+  GetRejected () const
+  {
+    return m_rejected;
+  }
+
+private:
+  void
+  Run (CommandCallback onCommand, ErrorCallback onError)
+  {
+    char buffer[1024];
+    struct pollfd pfd;
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    while (!m_stop.load (std::memory_order_relaxed))
+      {
+        // Bounded wait, so that Stop never waits more than 50 ms
+        if (::poll (&pfd, 1, 50) <= 0)
+          {
+            continue;
+          }
+        ssize_t n = ::recv (m_fd, buffer, sizeof (buffer) - 1, MSG_DONTWAIT);
+        if (n <= 0)
+          {
+            continue;
+          }
+        uint64_t arrivalNs = WallNs ();
+        std::string line (buffer, n);
+        while (!line.empty () && (line.back () == '\n' || line.back () == '\r'))
+          {
+            line.pop_back ();
+          }
+        Command command;
+        std::string error = ParseCommand (line, command);
+        if (!error.empty ())
+          {
+            ++m_rejected;
+            onError (line, error);
+            continue;
+          }
+        ++m_received;
+        command.arrivalNs = arrivalNs;
+        onCommand (command);
+      }
+  }
+
+  int m_fd = -1;
+  std::string m_path;
+  std::thread m_thread;
+  std::atomic<bool> m_stop{false};
+  std::atomic<uint64_t> m_received{0};
+  std::atomic<uint64_t> m_rejected{0};
+};
+
+} // namespace controlinput
+
+#endif /* CONTROL_INPUT_H */
@@ -0,0 +1,394 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef DATARATE_COLUMNAR_FILE_H
+#define DATARATE_COLUMNAR_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Single-file, block-buffered columnar storage for the per-UE throughput
+ * samples of slicing_AD_v5, used instead of one *_datarate.txt file per UE.
+ *
+ * Layout (host byte order, little endian on every supported target):
+ *
+ *   header:  char magic[8] = "SADRCOL1"
+ *            uint32 nSlices, then per slice: uint16 length + name
+ *            uint32 nUes,    then per UE:    uint8 slice + uint16 length + name
+ *   blocks:  uint32 rows
+ *            double time[rows]
+ *            uint32 ue[rows]
+ *            uint8  slice[rows]
+ *            double mbps[rows]
+ *
+ * Blocks are only written when full (or on Close), so the simulator issues
+ * one write per block instead of one flush per UE per report.
+ */
+namespace datarate {
+
+static const char kMagic[8] = {'S', 'A', 'D', 'R', 'C', 'O', 'L', '1'};
+
+class ColumnarWriter
+{
+public:
+  explicit ColumnarWriter (uint32_t blockRows = 8192)
+    : m_file (nullptr),
+      m_blockRows (blockRows),
+      m_good (true)
+  {
+  }
+
+  ~ColumnarWriter ()
+  {
+    Close ();
+  }
+
+  /**
+   * Create the file and write the header.
+   * \param ueNames friendly UE names, e.g. "urllc_ue_0", indexed by UE index
+   * \param ueSlices slice index of each UE, into sliceNames
+   * \return false if the file could not be created or the header not written
+   */
+  bool
+  Open (const std::string &filename, const std::vector<std::string> &sliceNames,
+        const std::vector<std::string> &ueNames, const std::vector<uint8_t> &ueSlices)
+  {
+    Close ();
+    m_file = std::fopen (filename.c_str (), "wb");
+    if (!m_file)
+      {
+        return false;
+      }
+    m_good = true;
+    m_ueSlices = ueSlices;
+    Write (kMagic, 1, sizeof (kMagic));
+    WriteU32 (sliceNames.size ());
+    for (const std::string &name : sliceNames)
+      {
+        WriteString (name);
+      }
+    WriteU32 (ueNames.size ());
+    for (uint32_t i = 0; i < ueNames.size (); ++i)
+      {
+        uint8_t slice = i < ueSlices.size () ? ueSlices[i] : 0;
+        Write (&slice, 1, 1);
+        WriteString (ueNames[i]);
+      }
+    if (!m_good)
+      {
+        std::fclose (m_file);
+        m_file = nullptr;
+        return false;
+      }
+    m_time.reserve (m_blockRows);
+    m_ue.reserve (m_blockRows);
+    m_slice.reserve (m_blockRows);
+    m_mbps.reserve (m_blockRows);
+    return true;
+  }
+
+  bool
+  IsOpen () const
+  {
+    return m_file != nullptr;
+  }
+
+  void
+  Append (double time, uint32_t ue, double mbps)
+  {
+    m_time.push_back (time);
+    m_ue.push_back (ue);
+    m_slice.push_back (ue < m_ueSlices.size () ? m_ueSlices[ue] : 0);
+    m_mbps.push_back (mbps);
+    if (m_time.size () >= m_blockRows)
+      {
+        FlushBlock ();
+      }
+  }
+
+  /// \return false if a write has failed since Open (e.g. the disk is full)
+  bool
+  IsGood () const
+  {
+    return m_good;
+  }
+
+  /// \return false if a write, the final flush or the close failed
+  bool
+  Close ()
+  {
+    if (!m_file)
+      {
+        return m_good;
+      }
+    FlushBlock ();
+    if (std::fclose (m_file) != 0)
+      {
+        m_good = false;
+      }
+    m_file = nullptr;
+    return m_good;
+  }
+
+private:
+  void
+  FlushBlock ()
+  {
+    uint32_t rows = m_time.size ();
+    if (rows == 0 || !m_file)
+      {
+        return;
+      }
+    WriteU32 (rows);
+    Write (m_time.data (), sizeof (double), rows);
+    Write (m_ue.data (), sizeof (uint32_t), rows);
+    Write (m_slice.data (), sizeof (uint8_t), rows);
+    Write (m_mbps.data (), sizeof (double), rows);
+    if (std::fflush (m_file) != 0)
+      {
+        m_good = false;
+      }
+    m_time.clear ();
+    m_ue.clear ();
+    m_slice.clear ();
+    m_mbps.clear ();
+  }
+
+  void
+  Write (const void *data, size_t size, size_t count)
+  {
+    if (std::fwrite (data, size, count, m_file) != count)
+      {
+        m_good = false;
+      }
+  }
+
+  void
+  WriteU32 (uint32_t v)
+  {
+    Write (&v, sizeof (v), 1);
+  }
+
+  void
+  WriteString (const std::string &s)
+  {
+    uint16_t len = s.size ();
+    Write (&len, sizeof (len), 1);
+    Write (s.data (), 1, len);
+  }
+
+  std::FILE *m_file;
+  uint32_t m_blockRows;
+  bool m_good; //!< false once a write has failed
+  std::vector<uint8_t> m_ueSlices;
+  std::vector<double> m_time;
+  std::vector<uint32_t> m_ue;
+  std::vector<uint8_t> m_slice;
+  std::vector<double> m_mbps;
+};
+
+/**
+ * Sequential reader for files produced by ColumnarWriter.
+ */
+class ColumnarReader
+{
+public:
+  struct Row
+  {
+    double time;
+    uint32_t ue;
+    uint8_t slice;
+    double mbps;
+  };
+
+  ColumnarReader ()
+    : m_file (nullptr),
+      m_next (0),
+      m_truncated (false)
+  {
+  }
+
+  ~ColumnarReader ()
+  {
+    if (m_file)
+      {
+        std::fclose (m_file);
+      }
+  }
+
+  /// \return false if the file cannot be opened or has a wrong header
+  bool
+  Open (const std::string &filename)
+  {
+    m_file = std::fopen (filename.c_str (), "rb");
+    if (!m_file)
+      {
+        return false;
+      }
+    char magic[sizeof (kMagic)];
+    if (std::fread (magic, 1, sizeof (magic), m_file) != sizeof (magic)
+        || std::string (magic, sizeof (magic)) != std::string (kMagic, sizeof (kMagic)))
+      {
+        return Fail ();
+      }
+    uint32_t nSlices;
+    if (!ReadU32 (nSlices))
+      {
+        return Fail ();
+      }
+    m_sliceNames.resize (nSlices);
+    for (std::string &name : m_sliceNames)
+      {
+        if (!ReadString (name))
+          {
+            return Fail ();
+          }
+      }
+    uint32_t nUes;
+    if (!ReadU32 (nUes))
+      {
+        return Fail ();
+      }
+    m_ueNames.resize (nUes);
+    m_ueSlices.resize (nUes);
+    for (uint32_t i = 0; i < nUes; ++i)
+      {
+        if (std::fread (&m_ueSlices[i], 1, 1, m_file) != 1 || !ReadString (m_ueNames[i]))
+          {
+            return Fail ();
+          }
+      }
+    return true;
+  }
+
+  const std::vector<std::string> &
+  GetSliceNames () const
+  {
+    return m_sliceNames;
+  }
+
+  const std::vector<std::string> &
+  GetUeNames () const
+  {
+    return m_ueNames;
+  }
+
+  /**
+   * \return false at the end of the file, or on a truncated or corrupt
+   * block: IsTruncated tells them apart
+   */
+  bool
+  Next (Row &row)
+  {
+    if (m_next >= m_block.size () && !ReadBlock ())
+      {
+        return false;
+      }
+    row = m_block[m_next++];
+    return true;
+  }
+
+  /// \return true if reading stopped on an incomplete block instead of the end of the file
+  bool
+  IsTruncated () const
+  {
+    return m_truncated;
+  }
+
+private:
+  bool
+  Fail ()
+  {
+    std::fclose (m_file);
+    m_file = nullptr;
+    return false;
+  }
+
+  bool
+  ReadBlock ()
+  {
+    if (!m_file || m_truncated)
+      {
+        return false;
+      }
+    uint32_t rows;
+    size_t got = std::fread (&rows, 1, sizeof (rows), m_file);
+    if (got != sizeof (rows))
+      {
+        // Nothing left is the clean end of the file, part of a row count is not
+        m_truncated = got != 0 || std::ferror (m_file);
+        return false;
+      }
+    if (rows == 0)
+      {
+        // The writer never writes an empty block
+        m_truncated = true;
+        return false;
+      }
+    std::vector<double> time (rows);
+    std::vector<uint32_t> ue (rows);
+    std::vector<uint8_t> slice (rows);
+    std::vector<double> mbps (rows);
+    if (std::fread (time.data (), sizeof (double), rows, m_file) != rows
+        || std::fread (ue.data (), sizeof (uint32_t), rows, m_file) != rows
+        || std::fread (slice.data (), sizeof (uint8_t), rows, m_file) != rows
+        || std::fread (mbps.data (), sizeof (double), rows, m_file) != rows)
+      {
+        m_truncated = true;
+        return false;
+      }
+    m_block.resize (rows);
+    for (uint32_t i = 0; i < rows; ++i)
+      {
+        m_block[i] = Row{time[i], ue[i], slice[i], mbps[i]};
+      }
+    m_next = 0;
+    return true;
+  }
+
+  bool
+  ReadU32 (uint32_t &v)
+  {
+    return std::fread (&v, sizeof (v), 1, m_file) == 1;
+  }
+
+  bool
+  ReadString (std::string &s)
+  {
+    uint16_t len;
+    if (std::fread (&len, sizeof (len), 1, m_file) != 1)
+      {
+        return false;
+      }
+    s.resize (len);
+    return len == 0 || std::fread (&s[0], 1, len, m_file) == len;
+  }
+
+  std::FILE *m_file;
+  std::vector<std::string> m_sliceNames;
+  std::vector<std::string> m_ueNames;
+  std::vector<uint8_t> m_ueSlices;
+  std::vector<Row> m_block;
+  size_t m_next;
+  bool m_truncated;
+};
+
+} // namespace datarate
+
+#endif /* DATARATE_COLUMNAR_FILE_H */
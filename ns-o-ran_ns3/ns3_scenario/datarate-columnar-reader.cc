@@ -0,0 +1,93 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/**
+ * Converts the columnar data rate file written by slicing_AD_v5 with
+ * --dataRateFormat=columnar back to the per-UE text layout
+ * (<outputDir>/urllc_ue_0_datarate.txt, ...) expected by existing scripts.
+ *
+ *   ./ns3 run "datarate-columnar-reader datarate.col out/"
+ *
+ * The UE files are written one at a time, so the tool never holds more than
+ * one extra file descriptor open.
+ */
+
+#include "datarate-columnar-file.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::cerr << "Usage: " << argv[0] << " <datarate.col> [outputDir]" << std::endl;
+      return 1;
+    }
+  std::string inputFile = argv[1];
+  std::string outputDir = argc > 2 ? argv[2] : ".";
+
+  datarate::ColumnarReader reader;
+  if (!reader.Open (inputFile))
+    {
+      std::cerr << "Can't read columnar data rate file " << inputFile << std::endl;
+      return 1;
+    }
+
+  // Group the samples per UE, keeping their original order
+  const std::vector<std::string> &ueNames = reader.GetUeNames ();
+  std::vector<std::vector<std::pair<double, double>>> samples (ueNames.size ());
+  datarate::ColumnarReader::Row row;
+  uint64_t rows = 0;
+  while (reader.Next (row))
+    {
+      if (row.ue < samples.size ())
+        {
+          samples[row.ue].emplace_back (row.time, row.mbps);
+        }
+      ++rows;
+    }
+
+  for (uint32_t ue = 0; ue < ueNames.size (); ++ue)
+    {
+      std::string filename = outputDir + "/" + ueNames[ue] + "_datarate.txt";
+      std::ofstream outFile (filename.c_str (), std::ios_base::out | std::ios_base::trunc);
+      if (!outFile.is_open ())
+        {
+          std::cerr << "Can't open file " << filename << std::endl;
+          return 1;
+        }
+      outFile << "Time (s)\tThroughput (Mbps)" << "\n";
+      for (const auto &sample : samples[ue])
+        {
+          outFile << sample.first << "\t" << sample.second << "\n";
+        }
+    }
+
+  std::cout << "Converted " << rows << " samples for " << ueNames.size () << " UEs into "
+            << outputDir << std::endl;
+  if (reader.IsTruncated ())
+    {
+      // The samples before the incomplete block are written, but the file lost its tail
+      std::cerr << inputFile << " is truncated: its last block is incomplete, the samples after "
+                << rows << " are missing" << std::endl;
+      return 1;
+    }
+  return 0;
+}
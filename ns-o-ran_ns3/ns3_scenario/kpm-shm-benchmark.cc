@@ -0,0 +1,279 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/**
+ * Records/s and producer-to-consumer latency of the two KPM export paths,
+ * with the producer and the consumer in different threads:
+ *
+ *  - csv: one text line per record appended to a file and flushed per
+ *    indication, as with enableE2FileLogging, tailed and parsed by the
+ *    consumer (what sim_watcher.py does, without Python);
+ *  - shm: the kpm-shm-ring.h ring, read in place by the consumer.
+ *
+ * Two runs per path: a saturated one for the records/s (the benchmark
+ * throttles the ring producer so that no record is lost), and a paced one,
+ * one indication every 1 ms, for the latency.
+ *
+ * It does not depend on any ns-3 module:
+ *   ./ns3 run "kpm-shm-benchmark -- 2000000 48"
+ * (records, records per indication)
+ */
+
+#include "kpm-shm-ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+uint64_t
+NowNs ()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds> (
+             std::chrono::steady_clock::now ().time_since_epoch ())
+      .count ();
+}
+
+struct Result
+{
+  uint64_t records = 0;
+  double seconds = 0;
+  std::vector<uint64_t> latencyNs; // one sample every sampleEvery records
+  uint64_t lost = 0;
+};
+
+void
+Print (const std::string &name, Result &r)
+{
+  std::sort (r.latencyNs.begin (), r.latencyNs.end ());
+  double p50 = r.latencyNs.empty () ? 0 : r.latencyNs[r.latencyNs.size () / 2] / 1e3;
+  double p99 = r.latencyNs.empty () ? 0 : r.latencyNs[r.latencyNs.size () * 99 / 100] / 1e3;
+  std::cout << name << ": " << r.records << " records in " << r.seconds << " s = "
+            << uint64_t (r.records / r.seconds) << " records/s, latency p50 " << p50
+            << " us, p99 " << p99 << " us, lost " << r.lost << std::endl;
+}
+
+void
+Pace (uint64_t i, uint32_t perIndication, uint32_t paceUs)
+{
+  if (paceUs > 0 && (i + 1) % perIndication == 0)
+    {
+      std::this_thread::sleep_for (std::chrono::microseconds (paceUs));
+    }
+}
+
+Result
+RunCsv (uint64_t records, uint32_t perIndication, uint32_t paceUs, const std::string &filename)
+{
+  std::ofstream(filename.c_str (), std::ios_base::trunc).close ();
+  std::atomic<bool> done (false);
+  Result result;
+  uint64_t sampleEvery = paceUs > 0 ? 1 : 64;
+
+  std::thread consumer ([&] () {
+    std::FILE *in = nullptr;
+    while (!(in = std::fopen (filename.c_str (), "r")))
+      {
+        std::this_thread::yield ();
+      }
+    std::vector<char> buffer (1 << 20);
+    std::string partial;
+    uint64_t seen = 0;
+    bool header = true;
+    while (seen < records)
+      {
+        size_t n = std::fread (buffer.data (), 1, buffer.size (), in);
+        if (n == 0)
+          {
+            std::clearerr (in);
+            std::this_thread::yield ();
+            continue;
+          }
+        partial.append (buffer.data (), n);
+        size_t begin = 0;
+        size_t end;
+        while ((end = partial.find ('\n', begin)) != std::string::npos)
+          {
+            if (header)
+              {
+                header = false;
+              }
+            else
+              {
+                // Parse every column, as the watcher does with csv.DictReader
+                const char *p = partial.data () + begin;
+                double values[16];
+                for (int c = 0; c < 16; ++c)
+                  {
+                    char *next;
+                    values[c] = std::strtod (p, &next);
+                    p = next + 1;
+                  }
+                if (seen % sampleEvery == 0)
+                  {
+                    result.latencyNs.push_back (NowNs () - uint64_t (values[15]));
+                  }
+                ++seen;
+              }
+            begin = end + 1;
+          }
+        partial.erase (0, begin);
+      }
+    std::fclose (in);
+    done = true;
+  });
+
+  uint64_t start = NowNs ();
+  std::ofstream out (filename.c_str (), std::ios_base::app);
+  out << "timestamp,ueImsiComplete,cellId,numActiveUes,sinr,sinr3gpp,n1,s1,n2,s2,n3,s3,"
+         "pdcpBytes,pdcpPackets,pdcpLatency,producedNs\n";
+  for (uint64_t i = 0; i < records; ++i)
+    {
+      out << i / perIndication * 100 << "," << 1111000000001ull + i % perIndication << ","
+          << 2 + i % 3 << "," << perIndication << "," << 12.5 + i % 7 << "," << 11.25 << ",3,"
+          << 4.5 << ",4," << 2.25 << ",5," << 1.125 << "," << 1000 + i % 977 << "," << 10 << ","
+          << 5.5 << "," << NowNs () << "\n";
+      if ((i + 1) % perIndication == 0)
+        {
+          out.flush ();
+        }
+      Pace (i, perIndication, paceUs);
+    }
+  out.flush ();
+  while (!done)
+    {
+      std::this_thread::yield ();
+    }
+  consumer.join ();
+  result.seconds = (NowNs () - start) / 1e9;
+  result.records = records;
+  std::remove (filename.c_str ());
+  return result;
+}
+
+Result
+RunShm (uint64_t records, uint32_t perIndication, uint32_t paceUs, const std::string &name)
+{
+  kpmshm::RingWriter writer;
+  if (!writer.Open (name, 1 << 16))
+    {
+      std::cerr << "Can't create " << kpmshm::ShmPath (name) << std::endl;
+      std::exit (1);
+    }
+  Result result;
+  uint64_t sampleEvery = paceUs > 0 ? 1 : 64;
+  std::atomic<uint64_t> consumed (0); // benchmark only: lets the producer wait instead of overwriting
+
+  std::thread consumer ([&] () {
+    kpmshm::RingReader reader;
+    if (!reader.Attach (name))
+      {
+        std::cerr << "Can't attach to " << kpmshm::ShmPath (name) << std::endl;
+        std::exit (1);
+      }
+    uint64_t seen = 0;
+    double sum = 0;
+    while (reader.GetReadIndex () < records)
+      {
+        const kpmshm::KpmRecord *first;
+        uint64_t n = reader.Peek (first);
+        if (n == 0)
+          {
+            std::this_thread::yield ();
+            continue;
+          }
+        for (uint64_t i = 0; i < n; ++i)
+          {
+            sum += first[i].v[0];
+            if ((seen + i) % sampleEvery == 0)
+              {
+                result.latencyNs.push_back (NowNs () - uint64_t (first[i].v[3]));
+              }
+          }
+        reader.Commit (n);
+        seen += n;
+        consumed.store (seen, std::memory_order_release);
+      }
+    result.lost = reader.GetLost ();
+    if (sum < 0)
+      {
+        std::cout << sum; // keep the reads
+      }
+  });
+
+  uint64_t start = NowNs ();
+  for (uint64_t i = 0; i < records; ++i)
+    {
+      // One slot stays free: the reader takes the oldest one as being overwritten
+      while (i + 1 - consumed.load (std::memory_order_acquire) >= (1 << 16))
+        {
+          std::this_thread::yield ();
+        }
+      kpmshm::KpmRecord r;
+      r.time = (i / perIndication) * 0.1;
+      r.imsi = 1111000000001ull + i % perIndication;
+      r.ue = i % perIndication;
+      r.cellId = 2 + i % 3;
+      r.type = kpmshm::CU_CP;
+      r.flags = 0;
+      r.count = 1;
+      r.reserved = 0;
+      r.v[0] = 12.5 + i % 7;
+      r.v[1] = 11.25;
+      r.v[2] = perIndication;
+      r.v[3] = NowNs ();
+      writer.Publish (r);
+      Pace (i, perIndication, paceUs);
+    }
+  consumer.join ();
+  result.seconds = (NowNs () - start) / 1e9;
+  result.records = records;
+  writer.Close ();
+  ::unlink (kpmshm::ShmPath (name).c_str ());
+  return result;
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  uint64_t records = argc > 1 ? std::strtoull (argv[1], nullptr, 10) : 2000000;
+  uint32_t perIndication = argc > 2 ? std::strtoul (argv[2], nullptr, 10) : 48;
+
+  Result csv = RunCsv (records, perIndication, 0, "kpm-shm-benchmark.csv");
+  Print ("csv saturated", csv);
+  Result shm = RunShm (records, perIndication, 0, "/kpm-shm-benchmark");
+  Print ("shm saturated", shm);
+  std::cout << "records/s speedup " << (shm.records / shm.seconds) / (csv.records / csv.seconds)
+            << "x" << std::endl;
+
+  // 1000 indications, one per ms
+  uint64_t paced = 1000 * uint64_t (perIndication);
+  Result csvPaced = RunCsv (paced, perIndication, 1000, "kpm-shm-benchmark.csv");
+  Print ("csv paced", csvPaced);
+  Result shmPaced = RunShm (paced, perIndication, 1000, "/kpm-shm-benchmark");
+  Print ("shm paced", shmPaced);
+  return 0;
+}
@@ -0,0 +1,137 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/**
+ * Follows the shared-memory KPM ring published by slicing_AD_v5 with
+ * --kpmShm=<name> until the scenario closes it. Prints the record rate every
+ * second, or every record as CSV with --csv.
+ *
+ *   ./ns3 run "kpm-shm-reader /sad_kpm"
+ *   ./build/scratch/ns3.38.rc1-kpm-shm-reader-default /sad_kpm --csv > kpm.csv
+ *
+ * The ring is created by the scenario at start-up; start the reader while
+ * the scenario runs (it waits for the segment to appear).
+ */
+
+#include "kpm-shm-ring.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int
+main (int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      std::cerr << "Usage: " << argv[0] << " <shm name> [--csv] [--unlink]" << std::endl;
+      return 1;
+    }
+  std::string name = argv[1];
+  bool csv = false;
+  bool unlinkAtEnd = false;
+  for (int i = 2; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      csv = csv || arg == "--csv";
+      unlinkAtEnd = unlinkAtEnd || arg == "--unlink";
+    }
+
+  kpmshm::RingReader reader;
+  while (!reader.Attach (name))
+    {
+      std::this_thread::sleep_for (std::chrono::milliseconds (100));
+    }
+  std::cerr << "Attached to " << kpmshm::ShmPath (name) << std::endl;
+
+  if (csv)
+    {
+      std::printf ("time,imsi,ue,cellId,type,count,v0,v1,v2,v3\n");
+    }
+
+  const char *typeNames[kpmshm::N_RECORD_TYPES] = {"cu_cp", "cu_up", "du", "ue_throughput"};
+  uint64_t perType[kpmshm::N_RECORD_TYPES] = {};
+  std::vector<kpmshm::KpmRecord> batch;
+  uint64_t total = 0;
+  uint64_t lastTotal = 0;
+  auto start = std::chrono::steady_clock::now ();
+  auto lastPrint = start;
+  bool closed = false;
+  while (true)
+    {
+      // Read the close flag first, so the records published before it are drained
+      closed = closed || reader.IsClosed ();
+      const kpmshm::KpmRecord *first;
+      uint64_t n = reader.Peek (first);
+      if (n == 0)
+        {
+          if (closed)
+            {
+              break;
+            }
+          std::this_thread::sleep_for (std::chrono::microseconds (200));
+        }
+      else
+        {
+          // Copy the batch out before Commit tells which of its records the
+          // producer may have overwritten meanwhile; only [overwritten, n) are used
+          batch.assign (first, first + n);
+          uint64_t overwritten = reader.Commit (n);
+          for (uint64_t i = overwritten; i < n; ++i)
+            {
+              const kpmshm::KpmRecord &r = batch[i];
+              if (r.type < kpmshm::N_RECORD_TYPES)
+                {
+                  ++perType[r.type];
+                }
+              if (csv)
+                {
+                  std::printf ("%.6f,%llu,%u,%u,%s,%u,%.9g,%.9g,%.9g,%.9g\n", r.time,
+                               (unsigned long long) r.imsi, r.ue, r.cellId,
+                               r.type < kpmshm::N_RECORD_TYPES ? typeNames[r.type] : "?", r.count,
+                               r.v[0], r.v[1], r.v[2], r.v[3]);
+                }
+            }
+          total += n - overwritten;
+        }
+
+      auto now = std::chrono::steady_clock::now ();
+      if (!csv && now - lastPrint >= std::chrono::seconds (1))
+        {
+          double seconds = std::chrono::duration<double> (now - lastPrint).count ();
+          std::cerr << "records " << total << " (" << uint64_t ((total - lastTotal) / seconds)
+                    << "/s), lost " << reader.GetLost () << std::endl;
+          lastPrint = now;
+          lastTotal = total;
+        }
+    }
+
+  double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  std::cerr << "Ring closed: " << total << " records in " << seconds << " s, lost "
+            << reader.GetLost () << std::endl;
+  for (uint32_t t = 0; t < kpmshm::N_RECORD_TYPES; ++t)
+    {
+      std::cerr << "  " << typeNames[t] << ": " << perType[t] << std::endl;
+    }
+  if (unlinkAtEnd)
+    {
+      ::unlink (kpmshm::ShmPath (name).c_str ());
+    }
+  return 0;
+}
@@ -0,0 +1,343 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef KPM_SHM_RING_H
+#define KPM_SHM_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Single-producer ring of fixed-layout KPM records in POSIX shared memory.
+ *
+ * The scenario is the only producer and never waits for the consumers: when
+ * the ring is full the oldest records are overwritten. Every consumer keeps
+ * its own read index, reads the records in place and detects the ones
+ * overwritten under it by re-reading the write index afterwards (see
+ * RingReader::Commit), so any number of readers can attach, in C++ (this
+ * header) or Python (metric_src/kpm_shm_reader.py). Record i overwrites
+ * record i - capacity before the write index moves to i + 1, so with the
+ * write index at w only the records from w + 1 - capacity on are intact.
+ *
+ * Layout of /dev/shm/<name>, little-endian:
+ *
+ *   0    char[8]  magic "SADKPM01"
+ *   8    uint32   record size (64)
+ *   12   uint32   closed (1 once the producer is done)
+ *   16   uint64   capacity in records, a power of two
+ *   24   uint64   producer start time, CLOCK_REALTIME [ns]
+ *   64   uint64   write index: records published since the start
+ *   128  records, record i in slot i % capacity
+ *
+ * The segment is opened through /dev/shm directly, as shm_open does, so
+ * that the tools don't depend on librt.
+ */
+namespace kpmshm {
+
+enum RecordType : uint8_t
+{
+  CU_CP = 0,         ///< v0 = mean serving SINR [dB], v1 = last SINR [dB], v2 = UEs served by the cell
+  CU_UP = 1,         ///< count = PDCP PDUs, v0 = PDCP bytes, v1 = PDCP throughput [Mbps], v2 = mean PDCP delay [ms]
+  DU = 2,            ///< count = TBs, v0 = TB bytes, v1 = corrupted TBs, v2 = mean MCS, v3 = PHY throughput [Mbps]
+  UE_THROUGHPUT = 3, ///< v0 = application throughput [Mbps], as in the data rate reports
+  N_RECORD_TYPES
+};
+
+struct KpmRecord
+{
+  double time;     ///< simulation time [s]
+  uint64_t imsi;   ///< ueImsiComplete of the E2 reports
+  uint32_t ue;     ///< UE index in the scenario
+  uint16_t cellId; ///< serving cell, 0 if unknown
+  uint8_t type;    ///< RecordType
+  uint8_t flags;
+  uint32_t count;
+  uint32_t reserved;
+  double v[4];
+};
+
+static_assert (sizeof (KpmRecord) == 64, "KpmRecord must stay 64 bytes");
+
+struct RingHeader
+{
+  char magic[8];
+  uint32_t recordSize;
+  std::atomic<uint32_t> closed;
+  uint64_t capacity;
+  uint64_t startWallNs;
+  uint8_t pad0[32];
+  std::atomic<uint64_t> writeIndex; // own cache line: the only field written per record
+  uint8_t pad1[56];
+};
+
+static_assert (sizeof (RingHeader) == 128, "RingHeader must stay 128 bytes");
+static_assert (std::atomic<uint64_t>::is_always_lock_free, "the ring needs lock-free 64-bit atomics");
+
+inline std::string
+ShmPath (const std::string &name)
+{
+  return "/dev/shm/" + (name.size () > 0 && name[0] == '/' ? name.substr (1) : name);
+}
+
+class RingWriter
+{
+public:
+  ~RingWriter ()
+  {
+    Close ();
+  }
+
+  /// Create (or replace) the segment; capacity is rounded up to a power of two
+  bool
+  Open (const std::string &name, uint64_t capacity)
+  {
+    Close ();
+    uint64_t slots = 1;
+    while (slots < capacity)
+      {
+        slots <<= 1;
+      }
+    std::string path = ShmPath (name);
+    ::unlink (path.c_str ()); // readers still attached to an old segment keep it
+    int fd = ::open (path.c_str (), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+      {
+        return false;
+      }
+    m_size = sizeof (RingHeader) + slots * sizeof (KpmRecord);
+    if (::ftruncate (fd, m_size) != 0)
+      {
+        ::close (fd);
+        return false;
+      }
+    void *base = ::mmap (nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close (fd);
+    if (base == MAP_FAILED)
+      {
+        return false;
+      }
+    m_header = static_cast<RingHeader *> (base);
+    m_records = reinterpret_cast<KpmRecord *> (static_cast<uint8_t *> (base) + sizeof (RingHeader));
+    m_mask = slots - 1;
+    m_next = 0;
+
+    std::memcpy (m_header->magic, "SADKPM01", 8);
+    m_header->recordSize = sizeof (KpmRecord);
+    m_header->capacity = slots;
+    struct timespec now;
+    clock_gettime (CLOCK_REALTIME, &now);
+    m_header->startWallNs = uint64_t (now.tv_sec) * 1000000000ull + now.tv_nsec;
+    m_header->writeIndex.store (0, std::memory_order_relaxed);
+    m_header->closed.store (0, std::memory_order_release);
+    return true;
+  }
+
+  bool
+  IsOpen () const
+  {
+    return m_header != nullptr;
+  }
+
+  void
+  Publish (const KpmRecord &record)
+  {
+    // The slot holds record m_next - capacity: a reader that sees any of the new bytes must
+    // also see the write index of the previous Publish, which marks that record overwritten.
+    // The fence keeps the record stores after that index store on weakly ordered CPUs too;
+    // the readers pair it with the acquire fence of Commit
+    std::atomic_thread_fence (std::memory_order_release);
+    m_records[m_next & m_mask] = record;
+    // Publishes the record: its stores are visible to a reader that acquires the new index
+    m_header->writeIndex.store (++m_next, std::memory_order_release);
+  }
+
+  uint64_t
+  GetPublished () const
+  {
+    return m_next;
+  }
+
+  /// Mark the ring closed and unmap it; the segment stays for late readers
+  void
+  Close ()
+  {
+    if (m_header)
+      {
+        m_header->closed.store (1, std::memory_order_release);
+        ::munmap (m_header, m_size);
+        m_header = nullptr;
+      }
+  }
+
+private:
+  RingHeader *m_header = nullptr;
+  KpmRecord *m_records = nullptr;
+  size_t m_size = 0;
+  uint64_t m_mask = 0;
+  uint64_t m_next = 0;
+};
+
+class RingReader
+{
+public:
+  ~RingReader ()
+  {
+    Detach ();
+  }
+
+  /**
+   * Map an existing segment. fromStart = false skips the records already
+   * published, else the reader starts at the oldest record still in the ring
+   */
+  bool
+  Attach (const std::string &name, bool fromStart = true)
+  {
+    Detach ();
+    int fd = ::open (ShmPath (name).c_str (), O_RDONLY);
+    if (fd < 0)
+      {
+        return false;
+      }
+    struct stat st;
+    if (::fstat (fd, &st) != 0 || size_t (st.st_size) < sizeof (RingHeader))
+      {
+        ::close (fd);
+        return false;
+      }
+    m_size = st.st_size;
+    void *base = ::mmap (nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close (fd);
+    if (base == MAP_FAILED)
+      {
+        return false;
+      }
+    m_header = static_cast<const RingHeader *> (base);
+    if (std::memcmp (m_header->magic, "SADKPM01", 8) != 0 ||
+        m_header->recordSize != sizeof (KpmRecord) ||
+        m_size < sizeof (RingHeader) + m_header->capacity * sizeof (KpmRecord))
+      {
+        Detach ();
+        return false;
+      }
+    m_records = reinterpret_cast<const KpmRecord *> (static_cast<const uint8_t *> (base) +
+                                                     sizeof (RingHeader));
+    m_capacity = m_header->capacity;
+    uint64_t written = m_header->writeIndex.load (std::memory_order_acquire);
+    m_read = fromStart ? (written + 1 > m_capacity ? written + 1 - m_capacity : 0) : written;
+    m_lost = 0;
+    return true;
+  }
+
+  void
+  Detach ()
+  {
+    if (m_header)
+      {
+        ::munmap (const_cast<RingHeader *> (m_header), m_size);
+        m_header = nullptr;
+      }
+  }
+
+  /**
+   * Zero-copy read: point first at the next unread records, contiguous in the
+   * ring (up to the wrap). The records must be validated with Commit once used.
+   * \return the number of records available at first
+   */
+  uint64_t
+  Peek (const KpmRecord *&first)
+  {
+    uint64_t written = m_header->writeIndex.load (std::memory_order_acquire);
+    if (written + 1 > m_capacity && written + 1 - m_capacity > m_read)
+      {
+        // Overrun: the producer lapped this reader, or is writing over the
+        // oldest unread record
+        m_lost += written + 1 - m_capacity - m_read;
+        m_read = written + 1 - m_capacity;
+      }
+    uint64_t slot = m_read & (m_capacity - 1);
+    uint64_t n = std::min (written - m_read, m_capacity - slot);
+    first = m_records + slot;
+    return n;
+  }
+
+  /**
+   * Consume the n records returned by Peek.
+   * \return how many of them, from the first one, may have been overwritten
+   * while they were being read (normally 0): only records [return, n) are
+   * valid. The others are counted as lost
+   */
+  uint64_t
+  Commit (uint64_t n)
+  {
+    // The record reads above may not move below the index load: paired with the release
+    // fence of Publish, any overwritten byte they saw implies a write index that covers it
+    std::atomic_thread_fence (std::memory_order_acquire);
+    uint64_t written = m_header->writeIndex.load (std::memory_order_acquire);
+    uint64_t overwritten = 0;
+    if (written + 1 > m_capacity && written + 1 - m_capacity > m_read)
+      {
+        overwritten = std::min (n, written + 1 - m_capacity - m_read);
+        m_lost += overwritten;
+      }
+    m_read += n;
+    return overwritten;
+  }
+
+  bool
+  IsClosed () const
+  {
+    return m_header->closed.load (std::memory_order_acquire) != 0;
+  }
+
+  uint64_t
+  GetLost () const
+  {
+    return m_lost;
+  }
+
+  uint64_t
+  GetReadIndex () const
+  {
+    return m_read;
+  }
+
+  uint64_t
+  GetStartWallNs () const
+  {
+    return m_header->startWallNs;
+  }
+
+private:
+  const RingHeader *m_header = nullptr;
+  const KpmRecord *m_records = nullptr;
+  size_t m_size = 0;
+  uint64_t m_capacity = 0;
+  uint64_t m_read = 0;
+  uint64_t m_lost = 0;
+};
+
+} // namespace kpmshm
+
+#endif /* KPM_SHM_RING_H */
@@ -0,0 +1,155 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+/**
+ * Fixed-memory log-linear histogram in the style of HdrHistogram.
+ *
+ * Values below 2^kSubBits are counted exactly; above that every power of
+ * two is split into 2^kSubBits linear sub-buckets, so the relative error of
+ * a reported quantile is at most 2^-kSubBits (about 3%). Recording is O(1)
+ * and the memory is constant (kBuckets counters), whatever the number of
+ * samples. Values are unsigned integers, e.g. delays in nanoseconds; values
+ * above 2^kMaxBits are clamped to the last bucket.
+ */
+namespace latency {
+
+class LogLinearHistogram
+{
+public:
+  static const uint32_t kSubBits = 5;
+  static const uint32_t kMaxBits = 37; // ~137 s in ns
+  static const uint32_t kSubBuckets = 1u << kSubBits;
+  static const uint32_t kBuckets = (kMaxBits - kSubBits + 1) * kSubBuckets;
+
+  LogLinearHistogram ()
+  {
+    Reset ();
+  }
+
+  void
+  Reset ()
+  {
+    m_counts.fill (0);
+    m_total = 0;
+    m_max = 0;
+  }
+
+  void
+  Record (uint64_t value)
+  {
+    ++m_counts[Index (value)];
+    ++m_total;
+    m_max = std::max (m_max, value);
+  }
+
+  void
+  Add (const LogLinearHistogram &other)
+  {
+    if (other.m_total == 0)
+      {
+        return;
+      }
+    for (uint32_t i = 0; i < kBuckets; ++i)
+      {
+        m_counts[i] += other.m_counts[i];
+      }
+    m_total += other.m_total;
+    m_max = std::max (m_max, other.m_max);
+  }
+
+  uint64_t
+  GetCount () const
+  {
+    return m_total;
+  }
+
+  uint64_t
+  GetMax () const
+  {
+    return m_max;
+  }
+
+  /**
+   * \param q quantile in [0, 1]
+   * \return a value within the relative error of the q-quantile, 0 if empty
+   */
+  uint64_t
+  GetQuantile (double q) const
+  {
+    if (m_total == 0)
+      {
+        return 0;
+      }
+    uint64_t rank = static_cast<uint64_t> (q * m_total);
+    rank = std::min<uint64_t> (std::max<uint64_t> (rank, 1), m_total);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < kBuckets; ++i)
+      {
+        seen += m_counts[i];
+        if (seen >= rank)
+          {
+            return std::min (Value (i), m_max);
+          }
+      }
+    return m_max;
+  }
+
+private:
+  static uint32_t
+  Index (uint64_t value)
+  {
+    if (value < kSubBuckets)
+      {
+        return value;
+      }
+    uint32_t msb = 63 - __builtin_clzll (value);
+    if (msb >= kMaxBits)
+      {
+        return kBuckets - 1;
+      }
+    uint32_t shift = msb - kSubBits;
+    uint32_t mantissa = (value >> shift) - kSubBuckets;
+    return (shift + 1) * kSubBuckets + mantissa;
+  }
+
+  /// Midpoint of the values counted by bucket index
+  static uint64_t
+  Value (uint32_t index)
+  {
+    if (index < kSubBuckets)
+      {
+        return index;
+      }
+    uint32_t shift = index / kSubBuckets - 1;
+    uint64_t low = static_cast<uint64_t> (kSubBuckets + index % kSubBuckets) << shift;
+    return low + ((1ull << shift) - 1) / 2;
+  }
+
+  std::array<uint32_t, kBuckets> m_counts;
+  uint64_t m_total;
+  uint64_t m_max;
+};
+
+} // namespace latency
+
+#endif /* LATENCY_HISTOGRAM_H */
@@ -0,0 +1,227 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/**
+ * Accuracy report of the pathloss map of slicing_AD_v5 (pathlossMap, see
+ * cached-umi-propagation-loss-model.h) against the exact 3GPP UMi street
+ * canyon model, on the hex layout of the scenario:
+ *
+ *  - pathloss error of the interpolation, for the LOS state of the map,
+ *    by distance from the site (percentiles and maximum, in dB);
+ *  - LOS fraction of the map against the TR 38.901 LOS probability;
+ *  - mean and std of the shadowing field, in units of the UMi std;
+ *  - build (or load) time, and the time per CalcRxPower of both models,
+ *    with shadowing, for UEs that move between the calls.
+ *
+ *   ./ns3 run "pathloss-map-benchmark --sites=19 --resolution=10 --samples=200000"
+ */
+
+#include "cached-umi-propagation-loss-model.h"
+#include "cell-topology.h"
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/propagation-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace ns3;
+
+namespace {
+
+const uint32_t kBins = 8;
+const double kBinEdges[kBins + 1] = {0, 20, 50, 100, 200, 500, 1000, 2000, 1e9};
+
+struct BinStats
+{
+  std::vector<double> errors;
+  uint64_t samples = 0;
+  uint64_t los = 0;
+  double expectedLos = 0; // sum of the LOS probabilities of the samples
+};
+
+double
+Percentile (std::vector<double> &values, double q)
+{
+  if (values.empty ())
+    {
+      return 0;
+    }
+  size_t k = std::min (values.size () - 1, size_t (q * values.size ()));
+  std::nth_element (values.begin (), values.begin () + k, values.end ());
+  return values[k];
+}
+
+Ptr<ThreeGppUmiStreetCanyonPropagationLossModel>
+Configure (Ptr<ThreeGppUmiStreetCanyonPropagationLossModel> model, double frequency)
+{
+  model->SetFrequency (frequency);
+  model->SetChannelConditionModel (CreateObject<ThreeGppUmiStreetCanyonChannelConditionModel> ());
+  return model;
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t sites = 19;
+  double isd = 500;
+  double area = 4000;
+  double resolution = 10;
+  double frequency = 3.5e9;
+  uint32_t samples = 200000;
+  uint32_t timedUes = 100;
+  std::string mapFile = "";
+  CommandLine cmd;
+  cmd.AddValue ("sites", "Number of sites of the hex layout", sites);
+  cmd.AddValue ("isd", "Inter-site distance [m]", isd);
+  cmd.AddValue ("area", "Side of the square area [m]", area);
+  cmd.AddValue ("resolution", "Grid step of the map [m]", resolution);
+  cmd.AddValue ("frequency", "Carrier frequency [Hz]", frequency);
+  cmd.AddValue ("samples", "Random UE positions of the accuracy report", samples);
+  cmd.AddValue ("timedUes", "UEs per site in the timing loop", timedUes);
+  cmd.AddValue ("mapFile", "Map file to load or write (empty: in memory)", mapFile);
+  cmd.Parse (argc, argv);
+
+  Config::SetDefault ("ns3::CachedUmiPropagationLossModel::Resolution", DoubleValue (resolution));
+  Config::SetDefault ("ns3::CachedUmiPropagationLossModel::Bounds",
+                      RectangleValue (Rectangle (0, area, 0, area)));
+  Config::SetDefault ("ns3::CachedUmiPropagationLossModel::MapFile", StringValue (mapFile));
+  // The report is about the map's own LOS states
+  Config::SetDefault ("ns3::CachedUmiPropagationLossModel::LosFromMap", BooleanValue (true));
+  Ptr<CachedUmiPropagationLossModel> cached = CreateObject<CachedUmiPropagationLossModel> ();
+  Configure (cached, frequency);
+  Ptr<ThreeGppUmiStreetCanyonPropagationLossModel> exact =
+      Configure (CreateObject<ThreeGppUmiStreetCanyonPropagationLossModel> (), frequency);
+
+  std::vector<Ptr<MobilityModel>> bs;
+  for (const topology::Point2d &p : topology::HexPositions (sites, isd))
+    {
+      Ptr<ConstantPositionMobilityModel> m = CreateObject<ConstantPositionMobilityModel> ();
+      m->SetPosition (Vector (area / 2 + p.x, area / 2 + p.y, 3));
+      bs.push_back (m);
+    }
+
+  // The first query of a site builds its grid, or finds it in the map file
+  Ptr<ConstantVelocityMobilityModel> ue = CreateObject<ConstantVelocityMobilityModel> ();
+  ue->SetPosition (Vector (area / 2, area / 2 + 100, 1.5));
+  auto start = std::chrono::steady_clock::now ();
+  for (Ptr<MobilityModel> site : bs)
+    {
+      cached->CalcRxPower (0, site, ue);
+    }
+  double setupSeconds =
+      std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  const CachedUmiPropagationLossModel::Stats &stats = cached->GetStats ();
+  std::cout << "map: " << sites << " sites, " << resolution << " m grid, " << stats.sitesLoaded
+            << " loaded, " << stats.sitesBuilt << " built, " << setupSeconds << " s" << std::endl;
+
+  // Accuracy
+  Ptr<UniformRandomVariable> u = CreateObject<UniformRandomVariable> ();
+  std::vector<BinStats> bins (kBins);
+  double shadowSum = 0;
+  double shadowSquares = 0;
+  uint64_t shadowCount = 0;
+  for (uint32_t k = 0; k < samples; ++k)
+    {
+      Ptr<MobilityModel> site = bs[u->GetInteger (0, bs.size () - 1)];
+      ue->SetPosition (Vector (u->GetValue (0, area), u->GetValue (0, area), 1.5));
+      double pathlossDb, shadowDb;
+      bool los;
+      if (!cached->LookupMap (site, ue, pathlossDb, shadowDb, los))
+        {
+          continue;
+        }
+      Vector s = site->GetPosition ();
+      Vector p = ue->GetPosition ();
+      double d = std::hypot (p.x - s.x, p.y - s.y);
+      uint32_t b = std::upper_bound (kBinEdges, kBinEdges + kBins + 1, d) - kBinEdges - 1;
+      BinStats &bin = bins[b];
+      bin.errors.push_back (std::abs (pathlossDb - cached->CalcExactLoss (site, ue, los)));
+      ++bin.samples;
+      bin.los += los ? 1 : 0;
+      bin.expectedLos += pathlossmap::UmiLosProbability (d);
+      double z = shadowDb / pathlossmap::UmiShadowingStd (los);
+      shadowSum += z;
+      shadowSquares += z * z;
+      ++shadowCount;
+    }
+  std::cout << std::fixed << std::setprecision (3);
+  std::cout << "distance [m]\tsamples\terr p50 [dB]\terr p99 [dB]\terr max [dB]\tLOS map\t"
+               "LOS 38.901"
+            << std::endl;
+  for (uint32_t b = 0; b < kBins; ++b)
+    {
+      BinStats &bin = bins[b];
+      if (bin.samples == 0)
+        {
+          continue;
+        }
+      double maxError = *std::max_element (bin.errors.begin (), bin.errors.end ());
+      std::cout << kBinEdges[b] << "-" << kBinEdges[b + 1] << "\t" << bin.samples << "\t"
+                << Percentile (bin.errors, 0.5) << "\t" << Percentile (bin.errors, 0.99) << "\t"
+                << maxError << "\t" << double (bin.los) / bin.samples << "\t"
+                << bin.expectedLos / bin.samples << std::endl;
+    }
+  double shadowMean = shadowSum / shadowCount;
+  std::cout << "shadowing: mean " << shadowMean << ", std "
+            << std::sqrt (shadowSquares / shadowCount - shadowMean * shadowMean)
+            << " (in units of the UMi std)" << std::endl;
+
+  // Time per query, the UEs jump to new positions between two rounds. They are not
+  // ConstantPositionMobilityModels, which the cached model takes for sites
+  std::vector<Ptr<ConstantVelocityMobilityModel>> movingUes;
+  for (uint32_t i = 0; i < timedUes; ++i)
+    {
+      movingUes.push_back (CreateObject<ConstantVelocityMobilityModel> ());
+    }
+  const uint32_t rounds = 20;
+  double elapsed[2] = {0, 0};
+  double checksum = 0;
+  for (uint32_t r = 0; r < rounds; ++r)
+    {
+      for (uint32_t i = 0; i < timedUes; ++i)
+        {
+          Vector p (u->GetValue (0, area), u->GetValue (0, area), 1.5);
+          movingUes[i]->SetPosition (p);
+        }
+      for (int m = 0; m < 2; ++m)
+        {
+          Ptr<PropagationLossModel> model = m == 0 ? Ptr<PropagationLossModel> (exact) : cached;
+          auto t0 = std::chrono::steady_clock::now ();
+          for (Ptr<MobilityModel> site : bs)
+            {
+              for (Ptr<ConstantVelocityMobilityModel> movingUe : movingUes)
+                {
+                  checksum += model->CalcRxPower (0, site, movingUe);
+                }
+            }
+          elapsed[m] +=
+              std::chrono::duration<double> (std::chrono::steady_clock::now () - t0).count ();
+        }
+    }
+  double queries = double (rounds) * bs.size () * timedUes;
+  std::cout << std::setprecision (1) << "CalcRxPower: exact " << elapsed[0] / queries * 1e9
+            << " ns, map " << elapsed[1] / queries * 1e9 << " ns, speedup "
+            << elapsed[0] / elapsed[1] << "x (checksum " << checksum << ")" << std::endl;
+  Simulator::Destroy ();
+  return 0;
+}
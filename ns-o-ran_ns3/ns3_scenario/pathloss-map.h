@@ -0,0 +1,468 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef PATHLOSS_MAP_H
+#define PATHLOSS_MAP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Precomputed large-scale fading of the 3GPP UMi street canyon model, per
+ * site, on a regular grid of UE positions (see
+ * cached-umi-propagation-loss-model.h for the propagation model that uses
+ * it).
+ *
+ * Every grid point holds the LOS and NLOS pathloss computed by the exact
+ * model, a LOS state drawn once with the TR 38.901 UMi LOS probability and
+ * a standard normal shadowing sample. The draws are hashed from the seed,
+ * the site position and the grid indices, so the same layout and seed
+ * always give the same map: the map is a fixed "city", and a UE that comes
+ * back to a place finds the same LOS state and shadowing there.
+ *
+ * A query picks the LOS state of the nearest grid point and interpolates
+ * bilinearly the pathloss of that state and the shadowing (renormalized,
+ * so the interpolated shadowing keeps a unit variance; its correlation
+ * distance is about the grid resolution).
+ *
+ * Maps can be saved to and memory-mapped from a file, little-endian:
+ *
+ *   0    FileHeader (magic "SADPLM01", grid, frequency, UE height, seed)
+ *   96   FileSite[nSites] (site position, offset of its grid points)
+ *   ...  GridPoint[nx * ny] per site, row by row (x fastest)
+ */
+namespace pathlossmap {
+
+struct GridSpec
+{
+  double minX = 0;
+  double minY = 0;
+  double maxX = 0;
+  double maxY = 0;
+  double resolution = 10; ///< [m]
+  double frequency = 0;   ///< [Hz]
+  double ueHeight = 1.5;  ///< [m]
+  uint64_t seed = 1;
+
+  uint32_t
+  GetNx () const
+  {
+    return uint32_t (std::ceil ((maxX - minX) / resolution)) + 1;
+  }
+
+  uint32_t
+  GetNy () const
+  {
+    return uint32_t (std::ceil ((maxY - minY) / resolution)) + 1;
+  }
+
+  bool
+  operator== (const GridSpec &o) const
+  {
+    return minX == o.minX && minY == o.minY && GetNx () == o.GetNx () && GetNy () == o.GetNy () &&
+           resolution == o.resolution && frequency == o.frequency && ueHeight == o.ueHeight &&
+           seed == o.seed;
+  }
+};
+
+struct GridPoint
+{
+  float lossLos;  ///< [dB]
+  float lossNlos; ///< [dB]
+  float shadow;   ///< standard normal sample
+  uint8_t los;    ///< LOS state of the point
+  uint8_t pad[3];
+};
+
+static_assert (sizeof (GridPoint) == 16, "GridPoint must stay 16 bytes");
+
+struct FileHeader
+{
+  char magic[8];
+  uint32_t nSites;
+  uint32_t nx;
+  uint32_t ny;
+  uint32_t pointSize;
+  double minX;
+  double minY;
+  double maxX;
+  double maxY;
+  double resolution;
+  double frequency;
+  double ueHeight;
+  uint64_t seed;
+  uint8_t pad[8];
+};
+
+static_assert (sizeof (FileHeader) == 96, "FileHeader must stay 96 bytes");
+
+struct FileSite
+{
+  double x;
+  double y;
+  double z;
+  uint64_t offset; ///< of the first grid point, from the start of the file
+};
+
+static_assert (sizeof (FileSite) == 32, "FileSite must stay 32 bytes");
+
+/// TR 38.901 Table 7.4.2-1, UMi street canyon
+inline double
+UmiLosProbability (double distance2d)
+{
+  if (distance2d <= 18)
+    {
+      return 1;
+    }
+  return 18 / distance2d + std::exp (-distance2d / 36) * (1 - 18 / distance2d);
+}
+
+/// TR 38.901 Table 7.4.1-1, UMi street canyon shadow fading std [dB]
+inline double
+UmiShadowingStd (bool los)
+{
+  return los ? 4.0 : 7.82;
+}
+
+inline uint64_t
+SplitMix64 (uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+/// Uniform in (0, 1) from a hash
+inline double
+HashUniform (uint64_t h)
+{
+  return ((h >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+/// Exact pathloss at a UE position: (x, y, LOS loss, NLOS loss), losses in dB
+using ExactLoss = std::function<void (double, double, double &, double &)>;
+
+struct Site
+{
+  double x = 0;
+  double y = 0;
+  double z = 0;
+  const GridPoint *points = nullptr; ///< into owned or into the mapped file
+  std::vector<GridPoint> owned;
+};
+
+class Map
+{
+public:
+  ~Map ()
+  {
+    Unmap ();
+  }
+
+  void
+  SetSpec (const GridSpec &spec)
+  {
+    m_sites.clear ();
+    Unmap ();
+    m_spec = spec;
+    m_nx = spec.GetNx ();
+    m_ny = spec.GetNy ();
+  }
+
+  const GridSpec &
+  GetSpec () const
+  {
+    return m_spec;
+  }
+
+  uint32_t
+  GetNSites () const
+  {
+    return m_sites.size ();
+  }
+
+  const Site &
+  GetSite (uint32_t site) const
+  {
+    return *m_sites[site];
+  }
+
+  /// \return the index of the site at (x, y, z), or -1
+  int32_t
+  FindSite (double x, double y, double z) const
+  {
+    for (uint32_t s = 0; s < m_sites.size (); ++s)
+      {
+        if (m_sites[s]->x == x && m_sites[s]->y == y && m_sites[s]->z == z)
+          {
+            return s;
+          }
+      }
+    return -1;
+  }
+
+  /// Compute the grid of a new site with the exact model; \return its index
+  uint32_t
+  BuildSite (double x, double y, double z, const ExactLoss &exact)
+  {
+    std::unique_ptr<Site> site (new Site);
+    site->x = x;
+    site->y = y;
+    site->z = z;
+    site->owned.resize (size_t (m_nx) * m_ny);
+    uint64_t siteHash =
+        SplitMix64 (Bits (x)) ^ SplitMix64 (Bits (y) + 1) ^ SplitMix64 (Bits (z) + 2);
+    siteHash = SplitMix64 (siteHash ^ m_spec.seed);
+    for (uint32_t j = 0; j < m_ny; ++j)
+      {
+        for (uint32_t i = 0; i < m_nx; ++i)
+          {
+            double px = m_spec.minX + i * m_spec.resolution;
+            double py = m_spec.minY + j * m_spec.resolution;
+            double lossLos, lossNlos;
+            exact (px, py, lossLos, lossNlos);
+            uint64_t h = SplitMix64 (siteHash ^ (uint64_t (j) << 32 | i));
+            double d = std::hypot (px - x, py - y);
+            GridPoint &p = site->owned[size_t (j) * m_nx + i];
+            p.lossLos = float (lossLos);
+            p.lossNlos = float (lossNlos);
+            p.los = HashUniform (h) < UmiLosProbability (d) ? 1 : 0;
+            // Box-Muller on two more hashes
+            double u1 = HashUniform (SplitMix64 (h + 1));
+            double u2 = HashUniform (SplitMix64 (h + 2));
+            p.shadow = float (std::sqrt (-2 * std::log (u1)) * std::cos (2 * M_PI * u2));
+            p.pad[0] = p.pad[1] = p.pad[2] = 0;
+          }
+      }
+    site->points = site->owned.data ();
+    m_sites.push_back (std::move (site));
+    m_dirty = true;
+    return m_sites.size () - 1;
+  }
+
+  /**
+   * Large-scale fading from the site to (x, y): the LOS state of the
+   * nearest grid point, the pathloss of that state and the shadowing, both
+   * interpolated, the shadowing scaled to the UMi std of the state [dB].
+   * With givenLos, the state is taken from there instead of the map.
+   * \return false if (x, y) is outside the grid
+   */
+  bool
+  Lookup (uint32_t site, double x, double y, double &pathlossDb, double &shadowDb, bool &los,
+          const bool *givenLos = nullptr) const
+  {
+    double fx = (x - m_spec.minX) / m_spec.resolution;
+    double fy = (y - m_spec.minY) / m_spec.resolution;
+    if (!(fx >= 0 && fy >= 0 && fx <= m_nx - 1 && fy <= m_ny - 1))
+      {
+        return false;
+      }
+    uint32_t i = std::min<uint32_t> (uint32_t (fx), m_nx - 2);
+    uint32_t j = std::min<uint32_t> (uint32_t (fy), m_ny - 2);
+    double tx = fx - i;
+    double ty = fy - j;
+    const GridPoint *p = m_sites[site]->points + size_t (j) * m_nx + i;
+    const GridPoint *c[4] = {p, p + 1, p + m_nx, p + m_nx + 1};
+    double w[4] = {(1 - tx) * (1 - ty), tx * (1 - ty), (1 - tx) * ty, tx * ty};
+    los = givenLos ? *givenLos : c[(tx < 0.5 ? 0 : 1) + (ty < 0.5 ? 0 : 2)]->los != 0;
+    double loss = 0;
+    double shadow = 0;
+    double w2 = 0;
+    for (int k = 0; k < 4; ++k)
+      {
+        loss += w[k] * (los ? c[k]->lossLos : c[k]->lossNlos);
+        shadow += w[k] * c[k]->shadow;
+        w2 += w[k] * w[k];
+      }
+    pathlossDb = loss;
+    shadowDb = shadow / std::sqrt (w2) * UmiShadowingStd (los);
+    return true;
+  }
+
+  /// true if sites were built since the map was loaded
+  bool
+  IsDirty () const
+  {
+    return m_dirty;
+  }
+
+  /**
+   * Map the sites of filename, if its grid matches the spec.
+   * \return an empty string, or the reason why the file was not used
+   */
+  std::string
+  Load (const std::string &filename)
+  {
+    int fd = ::open (filename.c_str (), O_RDONLY);
+    if (fd < 0)
+      {
+        return "can't open " + filename;
+      }
+    struct stat st;
+    if (::fstat (fd, &st) != 0 || size_t (st.st_size) < sizeof (FileHeader))
+      {
+        ::close (fd);
+        return "truncated file";
+      }
+    void *base = ::mmap (nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close (fd);
+    if (base == MAP_FAILED)
+      {
+        return "mmap failed";
+      }
+    const FileHeader *h = static_cast<const FileHeader *> (base);
+    GridSpec spec;
+    spec.minX = h->minX;
+    spec.minY = h->minY;
+    spec.maxX = h->maxX;
+    spec.maxY = h->maxY;
+    spec.resolution = h->resolution;
+    spec.frequency = h->frequency;
+    spec.ueHeight = h->ueHeight;
+    spec.seed = h->seed;
+    std::string error;
+    size_t sitesEnd = sizeof (FileHeader) + size_t (h->nSites) * sizeof (FileSite);
+    size_t gridBytes = size_t (m_nx) * m_ny * sizeof (GridPoint);
+    if (std::memcmp (h->magic, "SADPLM01", 8) != 0 || h->pointSize != sizeof (GridPoint))
+      {
+        error = "not a pathloss map";
+      }
+    else if (!(spec == m_spec) || h->nx != m_nx || h->ny != m_ny)
+      {
+        error = "built for another grid, frequency, UE height or seed";
+      }
+    else if (size_t (st.st_size) < sitesEnd)
+      {
+        error = "truncated file";
+      }
+    const FileSite *sites = reinterpret_cast<const FileSite *> (h + 1);
+    for (uint32_t s = 0; error.empty () && s < h->nSites; ++s)
+      {
+        if (sites[s].offset + gridBytes > size_t (st.st_size) || sites[s].offset % 8 != 0)
+          {
+            error = "truncated file";
+          }
+      }
+    if (!error.empty ())
+      {
+        ::munmap (base, st.st_size);
+        return error;
+      }
+    m_sites.clear ();
+    Unmap ();
+    m_mapped = base;
+    m_mappedSize = st.st_size;
+    for (uint32_t s = 0; s < h->nSites; ++s)
+      {
+        std::unique_ptr<Site> site (new Site);
+        site->x = sites[s].x;
+        site->y = sites[s].y;
+        site->z = sites[s].z;
+        site->points = reinterpret_cast<const GridPoint *> (static_cast<const uint8_t *> (base) +
+                                                            sites[s].offset);
+        m_sites.push_back (std::move (site));
+      }
+    m_dirty = false;
+    return "";
+  }
+
+  /// Write every site, mapped or built, to filename (through a temporary file and a rename)
+  bool
+  Save (const std::string &filename) const
+  {
+    std::string tmp = filename + ".tmp";
+    std::FILE *out = std::fopen (tmp.c_str (), "wb");
+    if (!out)
+      {
+        return false;
+      }
+    FileHeader h;
+    std::memset (&h, 0, sizeof (h));
+    std::memcpy (h.magic, "SADPLM01", 8);
+    h.nSites = m_sites.size ();
+    h.nx = m_nx;
+    h.ny = m_ny;
+    h.pointSize = sizeof (GridPoint);
+    h.minX = m_spec.minX;
+    h.minY = m_spec.minY;
+    h.maxX = m_spec.maxX;
+    h.maxY = m_spec.maxY;
+    h.resolution = m_spec.resolution;
+    h.frequency = m_spec.frequency;
+    h.ueHeight = m_spec.ueHeight;
+    h.seed = m_spec.seed;
+    bool ok = std::fwrite (&h, sizeof (h), 1, out) == 1;
+    size_t gridBytes = size_t (m_nx) * m_ny * sizeof (GridPoint);
+    uint64_t offset = sizeof (FileHeader) + m_sites.size () * sizeof (FileSite);
+    for (const std::unique_ptr<Site> &site : m_sites)
+      {
+        FileSite s = {site->x, site->y, site->z, offset};
+        ok = ok && std::fwrite (&s, sizeof (s), 1, out) == 1;
+        offset += gridBytes;
+      }
+    for (const std::unique_ptr<Site> &site : m_sites)
+      {
+        ok = ok && std::fwrite (site->points, gridBytes, 1, out) == 1;
+      }
+    ok = std::fclose (out) == 0 && ok;
+    // The mapped pages of the old file stay valid after the rename
+    return ok && std::rename (tmp.c_str (), filename.c_str ()) == 0;
+  }
+
+private:
+  static uint64_t
+  Bits (double v)
+  {
+    uint64_t b;
+    std::memcpy (&b, &v, sizeof (b));
+    return b;
+  }
+
+  void
+  Unmap ()
+  {
+    if (m_mapped)
+      {
+        ::munmap (m_mapped, m_mappedSize);
+        m_mapped = nullptr;
+      }
+  }
+
+  GridSpec m_spec;
+  uint32_t m_nx = 0;
+  uint32_t m_ny = 0;
+  std::vector<std::unique_ptr<Site>> m_sites;
+  void *m_mapped = nullptr;
+  size_t m_mappedSize = 0;
+  bool m_dirty = false;
+};
+
+} // namespace pathlossmap
+
+#endif /* PATHLOSS_MAP_H */
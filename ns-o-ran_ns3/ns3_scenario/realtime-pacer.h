@@ -0,0 +1,239 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef REALTIME_PACER_H
+#define REALTIME_PACER_H
+
+#include "latency-histogram.h"
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace ns3 {
+
+/**
+ * Paces a run against the wall clock at a given speed (simulated seconds
+ * per wall second), for runs with the RIC in the loop.
+ *
+ * A periodic event, every tick of simulated time, sleeps until the wall
+ * time that corresponds to its simulated time. When it is already past
+ * that time the run is late: the lateness is the lag. The pacer keeps, per
+ * report interval, histograms of the lag, of the wake-up jitter (how late
+ * the sleeps return) and of the scheduler events per tick, and writes them
+ * to a file as the run goes.
+ *
+ * When the lag stays above a threshold the run degrades: GetDegradeFactor
+ * doubles (up to 64) every 100 ms of simulated time and the scenario
+ * divides the rate of its optional outputs by it. It is halved again after
+ * each second of simulated time with a lag below half the threshold.
+ */
+class RealtimePacer
+{
+public:
+  bool
+  IsEnabled () const
+  {
+    return m_enabled;
+  }
+
+  /// 1 when on time, else the factor by which optional outputs are decimated
+  uint32_t
+  GetDegradeFactor () const
+  {
+    return m_degradeFactor;
+  }
+
+  void
+  Start (double speed, Time tick, Time lagThreshold, Time reportInterval, const std::string &filename)
+  {
+    NS_ABORT_MSG_IF (speed <= 0, "The real-time speed must be > 0");
+    NS_ABORT_MSG_IF (tick.IsZero () || tick.IsNegative (), "The real-time tick must be > 0");
+    m_out.open (filename.c_str (), std::ios_base::out | std::ios_base::trunc);
+    NS_ABORT_MSG_IF (!m_out.is_open (), "Can't open file " << filename);
+    m_out << "SimTime (s)\tWallTime (s)\tLagP50 (ms)\tLagP99 (ms)\tLagMax (ms)\tJitterP50 (ms)\t"
+             "JitterP99 (ms)\tEventsPerTickP50\tEventsPerTickMax\tLateTicks\tDegradeFactor\n";
+    m_enabled = true;
+    m_speed = speed;
+    m_tick = tick;
+    m_lagThresholdNs = lagThreshold.GetNanoSeconds ();
+    m_reportInterval = reportInterval;
+    m_simStart = Simulator::Now ();
+    m_nextReport = m_simStart + reportInterval;
+    m_wallStart = std::chrono::steady_clock::now ();
+    m_lastEvents = Simulator::GetEventCount ();
+    m_degradeTicks = std::max<uint64_t> (1, Seconds (0.1).GetTimeStep () / tick.GetTimeStep ());
+    m_recoverTicks = std::max<uint64_t> (1, Seconds (1).GetTimeStep () / tick.GetTimeStep ());
+    Simulator::ScheduleNow (&RealtimePacer::Tick, this);
+  }
+
+  /// Write the last interval and log the totals
+  void
+  Finish ()
+  {
+    if (!m_enabled)
+      {
+        return;
+      }
+    if (m_lag.GetCount () > 0)
+      {
+        Report ();
+      }
+    m_out << "# total: " << m_ticks << " ticks, " << m_totalLate << " late, max lag "
+          << m_totalMaxLagNs / 1e6 << " ms, lag p99 " << m_totalLag.GetQuantile (0.99) / 1e6
+          << " ms, jitter p99 " << m_totalJitter.GetQuantile (0.99) / 1e6 << " ms, "
+          << m_degradeChanges << " degrade changes\n";
+    m_out.close ();
+    NS_LOG_UNCOND ("Real time x" << m_speed << ": " << m_totalLate << " of " << m_ticks
+                                 << " ticks late, max lag " << m_totalMaxLagNs / 1e6
+                                 << " ms, lag p99 " << m_totalLag.GetQuantile (0.99) / 1e6 << " ms");
+    m_enabled = false;
+  }
+
+private:
+  int64_t
+  WallNs () const
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now () -
+                                                                 m_wallStart)
+        .count ();
+  }
+
+  void
+  Tick ()
+  {
+    ++m_ticks;
+    int64_t targetNs = int64_t ((Simulator::Now () - m_simStart).GetNanoSeconds () / m_speed);
+    int64_t lagNs = WallNs () - targetNs;
+    if (lagNs < 0)
+      {
+        std::this_thread::sleep_for (std::chrono::nanoseconds (-lagNs));
+        uint64_t jitterNs = std::max<int64_t> (0, WallNs () - targetNs);
+        m_jitter.Record (jitterNs);
+        m_totalJitter.Record (jitterNs);
+        lagNs = 0;
+      }
+    else
+      {
+        ++m_late;
+        ++m_totalLate;
+      }
+    m_lag.Record (lagNs);
+    m_totalLag.Record (lagNs);
+    m_maxLagNs = std::max<uint64_t> (m_maxLagNs, lagNs);
+    m_totalMaxLagNs = std::max<uint64_t> (m_totalMaxLagNs, lagNs);
+
+    uint64_t events = Simulator::GetEventCount ();
+    m_eventsPerTick.Record (events - m_lastEvents);
+    m_lastEvents = events;
+
+    UpdateDegradeFactor (lagNs);
+    if (Simulator::Now () >= m_nextReport)
+      {
+        Report ();
+        m_nextReport += m_reportInterval;
+      }
+    Simulator::Schedule (m_tick, &RealtimePacer::Tick, this);
+  }
+
+  void
+  UpdateDegradeFactor (int64_t lagNs)
+  {
+    uint32_t factor = m_degradeFactor;
+    if (lagNs > m_lagThresholdNs)
+      {
+        m_onTimeTicks = 0;
+        // Wait for the previous step to take effect before degrading further
+        if (++m_lateTicks >= m_degradeTicks && factor < 64)
+          {
+            factor *= 2;
+            m_lateTicks = 0;
+          }
+      }
+    else
+      {
+        m_lateTicks = 0;
+        if (lagNs < m_lagThresholdNs / 2 && ++m_onTimeTicks >= m_recoverTicks && factor > 1)
+          {
+            factor /= 2;
+            m_onTimeTicks = 0;
+          }
+      }
+    if (factor != m_degradeFactor)
+      {
+        NS_LOG_UNCOND ("Real time: lag " << lagNs / 1e6 << " ms at " << Simulator::Now ().GetSeconds ()
+                                         << " s, output decimation " << m_degradeFactor << " -> "
+                                         << factor);
+        m_degradeFactor = factor;
+        ++m_degradeChanges;
+      }
+  }
+
+  void
+  Report ()
+  {
+    m_out << Simulator::Now ().GetSeconds () << "\t" << WallNs () / 1e9 << "\t"
+          << m_lag.GetQuantile (0.5) / 1e6 << "\t" << m_lag.GetQuantile (0.99) / 1e6 << "\t"
+          << m_maxLagNs / 1e6 << "\t" << m_jitter.GetQuantile (0.5) / 1e6 << "\t"
+          << m_jitter.GetQuantile (0.99) / 1e6 << "\t" << m_eventsPerTick.GetQuantile (0.5) << "\t"
+          << m_eventsPerTick.GetMax () << "\t" << m_late << "\t" << m_degradeFactor << std::endl;
+    m_lag.Reset ();
+    m_jitter.Reset ();
+    m_eventsPerTick.Reset ();
+    m_maxLagNs = 0;
+    m_late = 0;
+  }
+
+  bool m_enabled = false;
+  double m_speed = 1;
+  Time m_tick;
+  int64_t m_lagThresholdNs = 0;
+  Time m_reportInterval;
+  Time m_simStart;
+  Time m_nextReport;
+  std::chrono::steady_clock::time_point m_wallStart;
+  uint64_t m_lastEvents = 0;
+  std::ofstream m_out;
+
+  // Current report interval
+  latency::LogLinearHistogram m_lag;
+  latency::LogLinearHistogram m_jitter;
+  latency::LogLinearHistogram m_eventsPerTick;
+  uint64_t m_maxLagNs = 0;
+  uint64_t m_late = 0;
+
+  // Whole run
+  latency::LogLinearHistogram m_totalLag;
+  latency::LogLinearHistogram m_totalJitter;
+  uint64_t m_totalMaxLagNs = 0;
+  uint64_t m_totalLate = 0;
+  uint64_t m_ticks = 0;
+
+  uint32_t m_degradeFactor = 1;
+  uint64_t m_lateTicks = 0;
+  uint64_t m_degradeTicks = 1;
+  uint64_t m_onTimeTicks = 0;
+  uint64_t m_recoverTicks = 1;
+  uint32_t m_degradeChanges = 0;
+};
+
+} // namespace ns3
+
+#endif /* REALTIME_PACER_H */
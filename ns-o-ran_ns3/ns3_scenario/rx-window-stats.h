@@ -0,0 +1,193 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef RX_WINDOW_STATS_H
+#define RX_WINDOW_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Per-UE receive statistics over fixed, back-to-back time windows, driven
+ * only by packet arrivals. A window is closed lazily by the first packet
+ * that falls after it (or by Flush at the end of the run), so no simulator
+ * event is needed per UE.
+ *
+ * Inter-arrival times are kept in a fixed-size ring: when a window holds
+ * more packets than the ring capacity, the percentiles are computed over
+ * the most recent ones.
+ */
+namespace rxwindow {
+
+struct WindowSummary
+{
+  double start;       ///< window start [s]
+  double end;         ///< window end [s]
+  uint64_t bytes;     ///< bytes received in the window
+  uint32_t packets;   ///< packets received in the window
+  double mbps;        ///< mean rate over the window [Mbps]
+  double iatMean;     ///< mean inter-arrival time [s]
+  double iatP50;      ///< median inter-arrival time [s]
+  double iatP99;      ///< 99th percentile of the inter-arrival time [s]
+  double jitter;      ///< mean |IAT(n) - IAT(n-1)| [s]
+};
+
+class UeRxWindow
+{
+public:
+  UeRxWindow ()
+    : m_windowLength (1),
+      m_windowIndex (0),
+      m_bytes (0),
+      m_packets (0),
+      m_lastRx (-1),
+      m_lastIat (-1),
+      m_iatSum (0),
+      m_iatCount (0),
+      m_jitterSum (0),
+      m_jitterCount (0),
+      m_ringHead (0),
+      m_ringSize (0)
+  {
+  }
+
+  void
+  Init (double windowLength, uint32_t ringCapacity)
+  {
+    m_windowLength = windowLength;
+    m_ring.assign (ringCapacity, 0);
+  }
+
+  /**
+   * Account for a packet received at time now. Every window that ends at or
+   * before now is closed first and passed to emit (empty windows included).
+   */
+  template <typename Emit>
+  void
+  OnRx (double now, uint32_t bytes, Emit &&emit)
+  {
+    uint64_t index = static_cast<uint64_t> (now / m_windowLength);
+    while (m_windowIndex < index)
+      {
+        emit (Close ((m_windowIndex + 1) * m_windowLength));
+        ++m_windowIndex;
+      }
+
+    m_bytes += bytes;
+    ++m_packets;
+    if (m_lastRx >= 0)
+      {
+        double iat = now - m_lastRx;
+        m_iatSum += iat;
+        ++m_iatCount;
+        if (m_lastIat >= 0)
+          {
+            m_jitterSum += std::fabs (iat - m_lastIat);
+            ++m_jitterCount;
+          }
+        m_lastIat = iat;
+        if (!m_ring.empty ())
+          {
+            m_ring[m_ringHead] = iat;
+            m_ringHead = (m_ringHead + 1) % m_ring.size ();
+            m_ringSize = std::min<uint32_t> (m_ringSize + 1, m_ring.size ());
+          }
+      }
+    m_lastRx = now;
+  }
+
+  /**
+   * Close every window up to now, including the current partial one.
+   */
+  template <typename Emit>
+  void
+  Flush (double now, Emit &&emit)
+  {
+    uint64_t index = static_cast<uint64_t> (now / m_windowLength);
+    while (m_windowIndex < index)
+      {
+        emit (Close ((m_windowIndex + 1) * m_windowLength));
+        ++m_windowIndex;
+      }
+    if (now > m_windowIndex * m_windowLength)
+      {
+        emit (Close (now));
+        ++m_windowIndex;
+      }
+  }
+
+private:
+  WindowSummary
+  Close (double end)
+  {
+    WindowSummary w;
+    w.start = m_windowIndex * m_windowLength;
+    w.end = end;
+    w.bytes = m_bytes;
+    w.packets = m_packets;
+    double duration = end - w.start;
+    w.mbps = duration > 0 ? (m_bytes * 8.0) / (duration * 1000000.0) : 0;
+    w.iatMean = m_iatCount > 0 ? m_iatSum / m_iatCount : 0;
+    w.jitter = m_jitterCount > 0 ? m_jitterSum / m_jitterCount : 0;
+    w.iatP50 = Percentile (0.50);
+    w.iatP99 = Percentile (0.99);
+
+    m_bytes = 0;
+    m_packets = 0;
+    m_iatSum = 0;
+    m_iatCount = 0;
+    m_jitterSum = 0;
+    m_jitterCount = 0;
+    m_ringHead = 0;
+    m_ringSize = 0;
+    return w;
+  }
+
+  double
+  Percentile (double q)
+  {
+    if (m_ringSize == 0)
+      {
+        return 0;
+      }
+    m_scratch.assign (m_ring.begin (), m_ring.begin () + m_ringSize);
+    size_t k =
+        std::min<size_t> (m_scratch.size () - 1, static_cast<size_t> (q * m_scratch.size ()));
+    std::nth_element (m_scratch.begin (), m_scratch.begin () + k, m_scratch.end ());
+    return m_scratch[k];
+  }
+
+  double m_windowLength;
+  uint64_t m_windowIndex;
+  uint64_t m_bytes;
+  uint32_t m_packets;
+  double m_lastRx;
+  double m_lastIat;
+  double m_iatSum;
+  uint32_t m_iatCount;
+  double m_jitterSum;
+  uint32_t m_jitterCount;
+  std::vector<double> m_ring;
+  uint32_t m_ringHead;
+  uint32_t m_ringSize;
+  std::vector<double> m_scratch; // reused by Percentile, so a window close does not allocate
+};
+
+} // namespace rxwindow
+
+#endif /* RX_WINDOW_STATS_H */
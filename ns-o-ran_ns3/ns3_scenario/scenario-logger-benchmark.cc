@@ -0,0 +1,111 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/**
+ * Cost, on the simulator thread, of the per-UE throughput log line of
+ * slicing_AD_v5.cc with the three logMode backends:
+ *
+ *  - ns-log: the line formatted with operator<< and written with std::endl,
+ *    as NS_LOG_UNCOND does;
+ *  - async: a record pushed to the scenario-logger.h ring, formatted by the
+ *    writer thread;
+ *  - binary: the same, written as a raw record.
+ *
+ * The output goes to the given file (default /dev/null), so that the
+ * terminal is not measured. The ring holds 2^20 records here, so that the
+ * unthrottled producer does not drop any below that many lines (the
+ * scenario uses 2^16 and logs in bursts of one line per UE per tick).
+ *
+ * It does not depend on any ns-3 module:
+ *   ./ns3 run "scenario-logger-benchmark -- 1000000 /tmp/log.txt"
+ * (log lines, output file)
+ */
+
+#include "scenario-logger.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> g_names;
+
+double
+Seconds (std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+void
+Format (std::ostream &out, const scenariolog::LogRecord &r)
+{
+  out << "UE " << g_names[r.ue] << " (Node ID: " << r.ue + 40 << ") Throughput: " << r.v0
+      << " Mbps at time " << r.time << "s";
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  uint64_t lines = argc > 1 ? std::strtoull (argv[1], nullptr, 10) : 1000000;
+  std::string output = argc > 2 ? argv[2] : "/dev/null";
+  const uint32_t ues = 1000;
+  for (uint32_t u = 0; u < ues; ++u)
+    {
+      g_names.push_back ("urllc_ue_" + std::to_string (u));
+    }
+
+  {
+    std::ofstream out (output.c_str ());
+    auto start = std::chrono::steady_clock::now ();
+    for (uint64_t i = 0; i < lines; ++i)
+      {
+        uint32_t u = i % ues;
+        out << "UE " << g_names[u] << " (Node ID: " << u + 40 << ") Throughput: " << 1.5 + u
+            << " Mbps at time " << 0.5 * (i / ues) << "s" << std::endl;
+      }
+    double s = Seconds (start);
+    std::cout << "ns-log: " << s << " s, " << s / lines * 1e9 << " ns per line" << std::endl;
+  }
+
+  for (auto mode : {scenariolog::AsyncLogger::TEXT, scenariolog::AsyncLogger::BINARY})
+    {
+      scenariolog::AsyncLogger logger;
+      if (!logger.Start (mode, output, &Format, 1 << 20, {}, {}))
+        {
+          std::cerr << "Can't open " << output << std::endl;
+          return 1;
+        }
+      auto start = std::chrono::steady_clock::now ();
+      for (uint64_t i = 0; i < lines; ++i)
+        {
+          uint32_t u = i % ues;
+          logger.Log (scenariolog::THROUGHPUT, 0.5 * (i / ues), u, 1.5 + u);
+        }
+      double producer = Seconds (start);
+      logger.Stop ();
+      double total = Seconds (start);
+      std::string summary = logger.GetSummary ();
+      std::cout << (mode == scenariolog::AsyncLogger::TEXT ? "async" : "binary") << ": "
+                << producer / lines * 1e9 << " ns per line on the simulator thread, " << total
+                << " s until written; " << summary.substr (0, summary.find ('\n')) << std::endl;
+    }
+  return 0;
+}
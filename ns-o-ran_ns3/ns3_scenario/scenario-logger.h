@@ -0,0 +1,341 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef SCENARIO_LOGGER_H
+#define SCENARIO_LOGGER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Asynchronous logger for the per-UE messages of the scenario hot paths.
+ *
+ * The simulator thread only fills a fixed 32-byte record (no formatting)
+ * and pushes it into a single-producer single-consumer ring; a background
+ * thread formats the records as text lines, or writes them as they are
+ * to a binary file (magic "SADLOG01", record size, records; see
+ * metric_src/scenario_log_reader.py). When the ring is full the record is
+ * dropped and counted, the simulation never waits for the output.
+ *
+ * Every category can be sampled (keep one record out of N) and rate
+ * limited (at most N records per simulated second, a token bucket on the
+ * record time, so the output does not depend on the machine speed).
+ *
+ * Building with -DSCENARIO_LOG_DISABLE_HOT_PATH turns SCENARIO_LOG_HOT
+ * into nothing, so that the hot-path logs, whatever their backend, are
+ * compiled out entirely.
+ */
+namespace scenariolog {
+
+enum Category : uint8_t
+{
+  THROUGHPUT = 0,       ///< ue, v0 = throughput [Mbps]
+  SLICE_ASSIGNMENT = 1, ///< ue, v0 = slice index, v1 = node id
+  N_CATEGORIES
+};
+
+inline const char *
+CategoryName (uint32_t category)
+{
+  static const char *names[N_CATEGORIES] = {"throughput", "slice"};
+  return category < N_CATEGORIES ? names[category] : "?";
+}
+
+struct LogRecord
+{
+  double time; ///< simulation time [s]
+  uint8_t category;
+  uint8_t pad[3];
+  uint32_t ue;
+  double v0;
+  double v1;
+};
+
+static_assert (sizeof (LogRecord) == 32, "LogRecord must stay 32 bytes");
+
+class AsyncLogger
+{
+public:
+  enum Mode
+  {
+    TEXT,  ///< formatted lines, like the NS_LOG_UNCOND output
+    BINARY ///< raw records
+  };
+
+  using Formatter = std::function<void (std::ostream &, const LogRecord &)>;
+
+  ~AsyncLogger ()
+  {
+    Stop ();
+  }
+
+  /**
+   * Parse "category=N,..." into the per-category limits, e.g. sampling
+   * "throughput=10" or rate limit "throughput=1000".
+   * \return an empty string, or the reason why spec is rejected
+   */
+  static std::string
+  ParseLimits (const std::string &spec, std::vector<uint64_t> &limits)
+  {
+    limits.assign (N_CATEGORIES, 0);
+    std::istringstream entries (spec);
+    std::string entry;
+    while (std::getline (entries, entry, ','))
+      {
+        size_t eq = entry.find ('=');
+        if (entry.empty ())
+          {
+            continue;
+          }
+        uint32_t c = 0;
+        while (c < N_CATEGORIES && entry.substr (0, eq) != CategoryName (c))
+          {
+            ++c;
+          }
+        if (eq == std::string::npos || c == N_CATEGORIES)
+          {
+            return "expected <category>=<n>, got " + entry;
+          }
+        char *end;
+        limits[c] = std::strtoull (entry.c_str () + eq + 1, &end, 10);
+        if (*end != '\0')
+          {
+            return "invalid number in " + entry;
+          }
+      }
+    return "";
+  }
+
+  /**
+   * Start the writer thread. output is a file name, or empty for stderr
+   * (where NS_LOG_UNCOND writes).
+   * sampling[c] > 1 keeps one record out of sampling[c], rateLimit[c] > 0
+   * keeps at most rateLimit[c] records per simulated second.
+   */
+  bool
+  Start (Mode mode, const std::string &output, Formatter formatter, uint32_t capacity,
+         const std::vector<uint64_t> &sampling, const std::vector<uint64_t> &rateLimit)
+  {
+    Stop ();
+    m_out = output.empty () ? stderr : std::fopen (output.c_str (), mode == BINARY ? "wb" : "w");
+    if (!m_out)
+      {
+        return false;
+      }
+    m_mode = mode;
+    m_formatter = formatter;
+    uint32_t slots = 1;
+    while (slots < capacity)
+      {
+        slots <<= 1;
+      }
+    m_ring.assign (slots, LogRecord ());
+    m_mask = slots - 1;
+    m_head = 0;
+    m_tail = 0;
+    for (uint32_t c = 0; c < N_CATEGORIES; ++c)
+      {
+        Limit &limit = m_limits[c];
+        limit = Limit ();
+        limit.sampling = c < sampling.size () && sampling[c] > 1 ? sampling[c] : 1;
+        limit.ratePerSecond = c < rateLimit.size () ? rateLimit[c] : 0;
+        limit.tokens = limit.ratePerSecond;
+      }
+    if (mode == BINARY)
+      {
+        uint32_t recordSize = sizeof (LogRecord);
+        std::fwrite ("SADLOG01", 1, 8, m_out);
+        std::fwrite (&recordSize, sizeof (recordSize), 1, m_out);
+      }
+    m_stop = false;
+    m_running = true;
+    m_thread = std::thread (&AsyncLogger::Run, this);
+    return true;
+  }
+
+  bool
+  IsRunning () const
+  {
+    return m_running;
+  }
+
+  /// Simulator thread only
+  void
+  Log (Category category, double time, uint32_t ue, double v0, double v1 = 0)
+  {
+    Limit &limit = m_limits[category];
+    ++limit.offered;
+    if (limit.sampling > 1 && (limit.offered - 1) % limit.sampling != 0)
+      {
+        ++limit.sampledOut;
+        return;
+      }
+    if (limit.ratePerSecond > 0)
+      {
+        // Refill on the record time, up to one second worth of records
+        limit.tokens = std::min<double> (limit.ratePerSecond,
+                                         limit.tokens + (time - limit.lastTime) * limit.ratePerSecond);
+        limit.lastTime = time;
+        if (limit.tokens < 1)
+          {
+            ++limit.rateLimited;
+            return;
+          }
+        limit.tokens -= 1;
+      }
+    uint64_t head = m_head.load (std::memory_order_relaxed);
+    if (head - m_tail.load (std::memory_order_acquire) > m_mask)
+      {
+        ++limit.dropped;
+        return;
+      }
+    LogRecord &r = m_ring[head & m_mask];
+    r.time = time;
+    r.category = category;
+    r.pad[0] = r.pad[1] = r.pad[2] = 0;
+    r.ue = ue;
+    r.v0 = v0;
+    r.v1 = v1;
+    m_head.store (head + 1, std::memory_order_release);
+  }
+
+  /// Drain the ring, join the writer thread and close the output
+  void
+  Stop ()
+  {
+    if (!m_running)
+      {
+        return;
+      }
+    m_stop = true;
+    m_thread.join ();
+    if (m_out != stderr)
+      {
+        std::fclose (m_out);
+      }
+    else
+      {
+        std::fflush (m_out);
+      }
+    m_out = nullptr;
+    m_running = false;
+  }
+
+  /// One line per category: offered, written and discarded records
+  std::string
+  GetSummary () const
+  {
+    std::ostringstream out;
+    for (uint32_t c = 0; c < N_CATEGORIES; ++c)
+      {
+        const Limit &l = m_limits[c];
+        out << CategoryName (c) << ": " << l.offered << " offered, "
+            << l.offered - l.sampledOut - l.rateLimited - l.dropped << " logged, " << l.sampledOut
+            << " sampled out, " << l.rateLimited << " rate limited, " << l.dropped
+            << " dropped (ring full)\n";
+      }
+    return out.str ();
+  }
+
+private:
+  struct Limit
+  {
+    uint64_t sampling = 1;
+    uint64_t ratePerSecond = 0;
+    double tokens = 0;
+    double lastTime = 0;
+    uint64_t offered = 0;
+    uint64_t sampledOut = 0;
+    uint64_t rateLimited = 0;
+    uint64_t dropped = 0;
+  };
+
+  void
+  Run ()
+  {
+    std::ostringstream line;
+    while (true)
+      {
+        bool stopping = m_stop.load (std::memory_order_acquire);
+        uint64_t head = m_head.load (std::memory_order_acquire);
+        uint64_t tail = m_tail.load (std::memory_order_relaxed);
+        if (head == tail)
+          {
+            if (stopping)
+              {
+                return;
+              }
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+            continue;
+          }
+        for (; tail != head; ++tail)
+          {
+            const LogRecord &r = m_ring[tail & m_mask];
+            if (m_mode == BINARY)
+              {
+                std::fwrite (&r, sizeof (r), 1, m_out);
+              }
+            else
+              {
+                line.str ("");
+                m_formatter (line, r);
+                line << '\n';
+                const std::string &text = line.str ();
+                std::fwrite (text.data (), 1, text.size (), m_out);
+              }
+            // Release each slot once it is consumed, so the producer sees free slots early
+            m_tail.store (tail + 1, std::memory_order_release);
+          }
+      }
+  }
+
+  Mode m_mode = TEXT;
+  std::FILE *m_out = nullptr;
+  Formatter m_formatter;
+  std::vector<LogRecord> m_ring;
+  uint64_t m_mask = 0;
+  alignas (64) std::atomic<uint64_t> m_head{0}; // written by the simulator thread
+  alignas (64) std::atomic<uint64_t> m_tail{0}; // written by the writer thread
+  Limit m_limits[N_CATEGORIES];
+  std::thread m_thread;
+  std::atomic<bool> m_stop{false};
+  bool m_running = false;
+};
+
+} // namespace scenariolog
+
+#ifdef SCENARIO_LOG_DISABLE_HOT_PATH
+#define SCENARIO_LOG_HOT(...)
+#else
+/// Run a logging statement of a hot path, compiled out with -DSCENARIO_LOG_DISABLE_HOT_PATH
+#define SCENARIO_LOG_HOT(...) \
+  do                          \
+    {                         \
+      __VA_ARGS__;            \
+    }                         \
+  while (0)
+#endif
+
+#endif /* SCENARIO_LOGGER_H */
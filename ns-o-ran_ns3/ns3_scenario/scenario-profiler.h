@@ -0,0 +1,224 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef SCENARIO_PROFILER_H
+#define SCENARIO_PROFILER_H
+
+#include "ns3/core-module.h"
+#include "ns3/lte-common.h"
+#include "ns3/mmwave-phy-mac-common.h"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Opt-in wall-clock profiler of a scenario run.
+ *
+ * Every interval of simulated time it samples the wall time, the number of
+ * events executed by the scheduler, the resident memory and a few event
+ * counters by category. The samples are kept in memory and written as one
+ * tab-separated file by Write, after Simulator::Run returns, so that the
+ * profiler does no I/O while the simulation is timed.
+ */
+class ScenarioProfiler
+{
+public:
+  enum Category
+  {
+    PHY_DL_TB,       ///< transport blocks received by the UEs (mmWave PHY)
+    PHY_UL_TB,       ///< transport blocks received by the gNBs (mmWave PHY)
+    MAC_DL_SCHED,    ///< downlink scheduling decisions of the LTE eNB MACs
+    APP_TX,          ///< packets sent by the UDP clients
+    SINK_RX,         ///< packets handled by the UE sink Rx trace
+    THROUGHPUT_TICK, ///< periodic data rate report events
+    N_CATEGORIES
+  };
+
+  ScenarioProfiler ()
+    : m_enabled (false)
+  {
+    m_counts.fill (0);
+  }
+
+  bool
+  IsEnabled () const
+  {
+    return m_enabled;
+  }
+
+  /// Cheap enough to be called unconditionally from the scenario hooks
+  void
+  Count (Category category)
+  {
+    ++m_counts[category];
+  }
+
+  /**
+   * Connect the trace based counters and schedule the first sample.
+   * Trace paths that do not match any object are skipped.
+   */
+  void
+  Start (Time interval)
+  {
+    m_enabled = true;
+    m_interval = interval;
+    m_wallStart = std::chrono::steady_clock::now ();
+
+    Config::ConnectWithoutContextFailSafe (
+        "/NodeList/*/DeviceList/*/MmWaveComponentCarrierMapUe/*/MmWaveUePhy/DlSpectrumPhy/RxPacketTraceUe",
+        MakeBoundCallback (&ScenarioProfiler::PhyRx, this, PHY_DL_TB));
+    Config::ConnectWithoutContextFailSafe (
+        "/NodeList/*/DeviceList/*/ComponentCarrierMap/*/MmWaveEnbPhy/DlSpectrumPhy/RxPacketTraceEnb",
+        MakeBoundCallback (&ScenarioProfiler::PhyRx, this, PHY_UL_TB));
+    Config::ConnectWithoutContextFailSafe (
+        "/NodeList/*/DeviceList/*/ComponentCarrierMap/*/LteEnbMac/DlScheduling",
+        MakeBoundCallback (&ScenarioProfiler::MacDlScheduling, this));
+    Config::ConnectWithoutContextFailSafe ("/NodeList/*/ApplicationList/*/$ns3::UdpClient/Tx",
+                                           MakeBoundCallback (&ScenarioProfiler::AppTx, this));
+    Config::ConnectWithoutContextFailSafe ("/NodeList/*/ApplicationList/*/$ns3::SliceUdpClient/Tx",
+                                           MakeBoundCallback (&ScenarioProfiler::AppTx, this));
+    Config::ConnectWithoutContextFailSafe ("/NodeList/*/ApplicationList/*/$ns3::SliceGroupClient/Tx",
+                                           MakeBoundCallback (&ScenarioProfiler::AppTx, this));
+
+    Sample ();
+  }
+
+  /// Take a last sample and write all of them to filename
+  void
+  Write (const std::string &filename)
+  {
+    if (!m_enabled)
+      {
+        return;
+      }
+    TakeSample ();
+
+    std::ofstream out (filename.c_str (), std::ios_base::out | std::ios_base::trunc);
+    if (!out.is_open ())
+      {
+        NS_LOG_UNCOND ("Can't open file " << filename);
+        return;
+      }
+    out << "SimTime (s)\tWallTime (s)\tSimToWall\tEvents\tEventsPerWallSec\tRss (MB)\t"
+           "PhyDlTb\tPhyUlTb\tMacDlSched\tAppTx\tSinkRx\tThroughputTicks\n";
+    for (uint32_t i = 0; i < m_samples.size (); ++i)
+      {
+        const ProfileSample &s = m_samples[i];
+        double dWall = i > 0 ? s.wall - m_samples[i - 1].wall : s.wall;
+        double dSim = i > 0 ? s.sim - m_samples[i - 1].sim : s.sim;
+        uint64_t dEvents = i > 0 ? s.events - m_samples[i - 1].events : s.events;
+        out << s.sim << "\t" << s.wall << "\t" << (dWall > 0 ? dSim / dWall : 0) << "\t" << s.events
+            << "\t" << (dWall > 0 ? dEvents / dWall : 0) << "\t" << s.rssBytes / 1048576.0;
+        for (uint64_t count : s.counts)
+          {
+            out << "\t" << count;
+          }
+        out << "\n";
+      }
+
+    const ProfileSample &last = m_samples.back ();
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    out << "# total: " << last.sim << " s simulated in " << last.wall << " s, " << last.events
+        << " events (" << (last.wall > 0 ? last.events / last.wall : 0) << "/s), peak RSS "
+        << usage.ru_maxrss / 1024.0 << " MB\n";
+    NS_LOG_UNCOND ("Profile: " << last.sim << " s simulated in " << last.wall << " s, "
+                               << last.events << " events, written to " << filename);
+  }
+
+private:
+  struct ProfileSample
+  {
+    double sim;
+    double wall;
+    uint64_t events;
+    uint64_t rssBytes;
+    std::array<uint64_t, N_CATEGORIES> counts;
+  };
+
+  static void
+  PhyRx (ScenarioProfiler *profiler, Category category, mmwave::RxPacketTraceParams)
+  {
+    profiler->Count (category);
+  }
+
+  static void
+  MacDlScheduling (ScenarioProfiler *profiler, DlSchedulingCallbackInfo)
+  {
+    profiler->Count (MAC_DL_SCHED);
+  }
+
+  static void
+  AppTx (ScenarioProfiler *profiler, Ptr<const Packet>)
+  {
+    profiler->Count (APP_TX);
+  }
+
+  static uint64_t
+  ResidentBytes ()
+  {
+    // Second field of /proc/self/statm: resident pages
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    FILE *statm = std::fopen ("/proc/self/statm", "r");
+    if (statm)
+      {
+        if (std::fscanf (statm, "%lu %lu", &size, &resident) != 2)
+          {
+            resident = 0;
+          }
+        std::fclose (statm);
+      }
+    return resident * sysconf (_SC_PAGESIZE);
+  }
+
+  void
+  TakeSample ()
+  {
+    ProfileSample s;
+    s.sim = Simulator::Now ().GetSeconds ();
+    s.wall = std::chrono::duration<double> (std::chrono::steady_clock::now () - m_wallStart).count ();
+    s.events = Simulator::GetEventCount ();
+    s.rssBytes = ResidentBytes ();
+    s.counts = m_counts;
+    m_samples.push_back (s);
+  }
+
+  void
+  Sample ()
+  {
+    TakeSample ();
+    Simulator::Schedule (m_interval, &ScenarioProfiler::Sample, this);
+  }
+
+  bool m_enabled;
+  Time m_interval;
+  std::chrono::steady_clock::time_point m_wallStart;
+  std::array<uint64_t, N_CATEGORIES> m_counts;
+  std::vector<ProfileSample> m_samples;
+};
+
+} // namespace ns3
+
+#endif /* SCENARIO_PROFILER_H */
@@ -0,0 +1,218 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/**
+ * Compares the two traffic generators of slicing_AD_v5 (trafficGenerator
+ * per-ue and aggregated) on a bare point-to-point link, without the radio
+ * stack, so that only the application side is measured: N UdpClients
+ * against one SliceGroupClient with N flows, towards N sinks.
+ *
+ * For each generator it prints the wall time, the number of simulator
+ * events and of client-side objects (applications and sockets), and checks
+ * that every sink received the same packets in both runs: same count, and
+ * the same sequence numbers with the same send times (the SeqTsHeader
+ * stamped by the client). It exits with 1 on any difference.
+ *
+ *   ./ns3 run "slice-group-benchmark --flows=1000 --interval=0.0004 --simTime=1"
+ */
+
+#include "slice-group-client.h"
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+namespace {
+
+/// Packets received by one sink, in arrival order
+struct SinkLog
+{
+  uint64_t bytes = 0;
+  std::vector<uint32_t> seq;
+  std::vector<int64_t> sentNs;
+};
+
+struct RunResult
+{
+  double wallSeconds = 0;
+  uint64_t events = 0;
+  uint32_t clientObjects = 0;
+  std::vector<SinkLog> sinks;
+};
+
+void
+RecordRx (SinkLog *log, Ptr<const Packet> packet, const Address &)
+{
+  SeqTsHeader seqTs;
+  packet->PeekHeader (seqTs);
+  log->bytes += packet->GetSize ();
+  log->seq.push_back (seqTs.GetSeq ());
+  log->sentNs.push_back (seqTs.GetTs ().GetNanoSeconds ());
+}
+
+/**
+ * Compare what sink i received in the two runs
+ * \return an empty string if the packets, their order and send times match,
+ * else the first difference
+ */
+std::string
+CompareSink (const SinkLog &a, const SinkLog &b)
+{
+  if (a.seq.size () != b.seq.size ())
+    {
+      return std::to_string (a.seq.size ()) + " vs " + std::to_string (b.seq.size ()) +
+             " packets";
+    }
+  for (size_t k = 0; k < a.seq.size (); ++k)
+    {
+      if (a.seq[k] != b.seq[k] || a.sentNs[k] != b.sentNs[k])
+        {
+          return "packet " + std::to_string (k) + ": seq " + std::to_string (a.seq[k]) +
+                 " sent at " + std::to_string (a.sentNs[k]) + " ns vs seq " +
+                 std::to_string (b.seq[k]) + " sent at " + std::to_string (b.sentNs[k]) + " ns";
+        }
+    }
+  return "";
+}
+
+RunResult
+Run (bool aggregated, uint32_t flows, double interval, uint32_t size, double simTime)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+  PointToPointHelper link;
+  link.SetDeviceAttribute ("DataRate", StringValue ("1000Gbps"));
+  link.SetChannelAttribute ("Delay", StringValue ("1ms"));
+  link.SetQueue ("ns3::DropTailQueue<Packet>", "MaxSize", StringValue ("1000000p"));
+  NetDeviceContainer devices = link.Install (nodes);
+  InternetStackHelper internet;
+  internet.Install (nodes);
+  Ipv4AddressHelper addresses ("10.1.0.0", "255.255.0.0");
+  Ipv4InterfaceContainer interfaces = addresses.Assign (devices);
+  Ipv4Address sinkAddress = interfaces.GetAddress (1);
+
+  RunResult result;
+  result.sinks.resize (flows);
+  for (uint32_t i = 0; i < flows; ++i)
+    {
+      PacketSinkHelper sinkHelper ("ns3::UdpSocketFactory",
+                                   InetSocketAddress (Ipv4Address::GetAny (), 10000 + i));
+      Ptr<Application> sink = sinkHelper.Install (nodes.Get (1)).Get (0);
+      sink->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&RecordRx, &result.sinks[i]));
+    }
+
+  ApplicationContainer clients;
+  if (aggregated)
+    {
+      Ptr<SliceGroupClient> group = CreateObject<SliceGroupClient> ();
+      group->SetAttribute ("PacketSize", UintegerValue (size));
+      group->SetAttribute ("Interval", TimeValue (Seconds (interval)));
+      for (uint32_t i = 0; i < flows; ++i)
+        {
+          group->AddFlow (sinkAddress, 10000 + i, Seconds (0.1));
+        }
+      nodes.Get (0)->AddApplication (group);
+      clients.Add (group);
+      result.clientObjects = 2; // the application and its socket
+    }
+  else
+    {
+      for (uint32_t i = 0; i < flows; ++i)
+        {
+          UdpClientHelper client (sinkAddress, 10000 + i);
+          client.SetAttribute ("Interval", TimeValue (Seconds (interval)));
+          client.SetAttribute ("MaxPackets", UintegerValue (UINT32_MAX));
+          client.SetAttribute ("PacketSize", UintegerValue (size));
+          clients.Add (client.Install (nodes.Get (0)));
+        }
+      result.clientObjects = 2 * flows;
+    }
+  clients.Start (Seconds (0.1));
+  clients.Stop (Seconds (simTime - 0.1));
+
+  auto start = std::chrono::steady_clock::now ();
+  Simulator::Stop (Seconds (simTime));
+  Simulator::Run ();
+  result.wallSeconds =
+      std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  result.events = Simulator::GetEventCount ();
+  Simulator::Destroy ();
+  return result;
+}
+
+void
+Print (const std::string &name, const RunResult &r)
+{
+  uint64_t bytes = 0;
+  uint64_t packets = 0;
+  for (const SinkLog &sink : r.sinks)
+    {
+      bytes += sink.bytes;
+      packets += sink.seq.size ();
+    }
+  std::cout << name << ": " << r.wallSeconds << " s wall, " << r.events << " events, "
+            << r.clientObjects << " client objects, " << packets << " packets, " << bytes
+            << " bytes received" << std::endl;
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t flows = 1000;
+  double interval = 0.0004;
+  uint32_t size = 45;
+  double simTime = 1;
+  CommandLine cmd;
+  cmd.AddValue ("flows", "Number of flows (UEs)", flows);
+  cmd.AddValue ("interval", "Time between the packets of a flow [s]", interval);
+  cmd.AddValue ("size", "Packet size [bytes]", size);
+  cmd.AddValue ("simTime", "Simulated time [s]", simTime);
+  cmd.Parse (argc, argv);
+
+  RunResult perUe = Run (false, flows, interval, size, simTime);
+  Print ("per-ue", perUe);
+  RunResult aggregated = Run (true, flows, interval, size, simTime);
+  Print ("aggregated", aggregated);
+
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < flows; ++i)
+    {
+      std::string difference = CompareSink (perUe.sinks[i], aggregated.sinks[i]);
+      if (!difference.empty ())
+        {
+          if (mismatches < 10)
+            {
+              std::cerr << "sink " << i << ": " << difference << std::endl;
+            }
+          ++mismatches;
+        }
+    }
+  std::cout << "speedup " << perUe.wallSeconds / aggregated.wallSeconds << "x, events "
+            << double (perUe.events) / aggregated.events << "x fewer, " << mismatches
+            << " sinks with different packets" << std::endl;
+  return mismatches == 0 ? 0 : 1;
+}
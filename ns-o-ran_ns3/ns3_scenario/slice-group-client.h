@@ -0,0 +1,256 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef SLICE_GROUP_CLIENT_H
+#define SLICE_GROUP_CLIENT_H
+
+#include "slice-traffic-profile.h"
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * One UDP client for all the UEs of a slice: every UE is a flow with its
+ * own destination, start time, sequence numbers and burst state, and the
+ * packets are the same as those of a UdpClient / SliceUdpClient per UE (a
+ * SeqTsHeader stamped at the send time, PacketSize bytes in total).
+ *
+ * The next send time of every flow is kept in a binary min-heap and only
+ * the earliest one is in the simulator queue, so N flows that send at the
+ * same instants, as with the default slices, cost one event per instant
+ * instead of N, and one socket and one application instead of N. Flows
+ * due at the same time are served in the order they were added.
+ *
+ * The gaps come from one TrafficPattern shared by the flows: the constant
+ * pattern gives the same packets as per-UE clients, the random patterns
+ * the same distributions from fewer random streams.
+ */
+class SliceGroupClient : public Application
+{
+public:
+  static TypeId
+  GetTypeId ()
+  {
+    static TypeId tid =
+        TypeId ("ns3::SliceGroupClient")
+            .SetParent<Application> ()
+            .SetGroupName ("Applications")
+            .AddConstructor<SliceGroupClient> ()
+            .AddAttribute ("PacketSize", "Size of the packets, including the SeqTsHeader",
+                           UintegerValue (1024), MakeUintegerAccessor (&SliceGroupClient::m_size),
+                           MakeUintegerChecker<uint32_t> (12, 65507))
+            .AddAttribute ("Pattern", "Gap distribution: constant, poisson or onoff",
+                           StringValue ("constant"), MakeStringAccessor (&SliceGroupClient::m_pattern),
+                           MakeStringChecker ())
+            .AddAttribute ("Interval", "(Mean) time between packets of a flow", TimeValue (Seconds (1)),
+                           MakeTimeAccessor (&SliceGroupClient::SetInterval, &SliceGroupClient::GetInterval),
+                           MakeTimeChecker ())
+            .AddAttribute ("OnTime", "Mean burst duration of the onoff pattern", TimeValue (Seconds (1)),
+                           MakeTimeAccessor (&SliceGroupClient::m_onTime), MakeTimeChecker ())
+            .AddAttribute ("OffTime", "Mean silence between bursts of the onoff pattern",
+                           TimeValue (Seconds (1)), MakeTimeAccessor (&SliceGroupClient::m_offTime),
+                           MakeTimeChecker ())
+            .AddTraceSource ("Tx", "A new packet is created and sent",
+                             MakeTraceSourceAccessor (&SliceGroupClient::m_txTrace),
+                             "ns3::Packet::TracedCallback");
+    return tid;
+  }
+
+  /**
+   * Add a flow towards address:port whose first packet is sent at the
+   * absolute time start (or when the application starts, if later).
+   * \return the flow index
+   */
+  uint32_t
+  AddFlow (Ipv4Address address, uint16_t port, Time start)
+  {
+    Flow flow;
+    flow.peer = InetSocketAddress (address, port);
+    flow.start = start;
+    m_flows.push_back (flow);
+    return m_flows.size () - 1;
+  }
+
+  uint32_t
+  GetNFlows () const
+  {
+    return m_flows.size ();
+  }
+
+  /// Packets sent by the flow
+  uint32_t
+  GetSent (uint32_t flow) const
+  {
+    return m_flows[flow].sent;
+  }
+
+  /// Simulator events used so far, one per distinct send time
+  uint64_t
+  GetWakeUps () const
+  {
+    return m_wakeUps;
+  }
+
+  /// Configure the pattern now so that AssignStreams can be used before the start
+  int64_t
+  AssignStreams (int64_t stream)
+  {
+    m_trafficPattern.Configure (m_pattern, m_interval, m_onTime, m_offTime);
+    m_configured = true;
+    return m_trafficPattern.AssignStreams (stream);
+  }
+
+  /// Can be changed while the application runs, e.g. by a slice control command
+  void
+  SetInterval (Time interval)
+  {
+    m_interval = interval;
+    if (m_configured)
+      {
+        m_trafficPattern.SetInterval (interval);
+      }
+  }
+
+  Time
+  GetInterval () const
+  {
+    return m_interval;
+  }
+
+protected:
+  void
+  DoDispose () override
+  {
+    m_socket = nullptr;
+    Application::DoDispose ();
+  }
+
+private:
+  struct Flow
+  {
+    InetSocketAddress peer = InetSocketAddress (Ipv4Address (), 0);
+    Time start;
+    Time burstEnd;
+    uint32_t sent = 0; ///< also the sequence number of the next packet
+  };
+
+  /// (send time step, flow index), ordered as a min-heap with std::greater
+  using Entry = std::pair<int64_t, uint32_t>;
+
+  void
+  StartApplication () override
+  {
+    if (!m_configured)
+      {
+        m_trafficPattern.Configure (m_pattern, m_interval, m_onTime, m_offTime);
+        m_configured = true;
+      }
+    if (!m_socket)
+      {
+        m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+        m_socket->Bind ();
+        m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket>> ());
+        m_socket->SetAllowBroadcast (true);
+      }
+    Time now = Simulator::Now ();
+    m_heap.clear ();
+    m_heap.reserve (m_flows.size ());
+    for (uint32_t i = 0; i < m_flows.size (); ++i)
+      {
+        m_heap.emplace_back (std::max (m_flows[i].start, now).GetTimeStep (), i);
+      }
+    std::make_heap (m_heap.begin (), m_heap.end (), std::greater<Entry> ());
+    ScheduleNext ();
+  }
+
+  void
+  StopApplication () override
+  {
+    Simulator::Cancel (m_sendEvent);
+  }
+
+  void
+  ScheduleNext ()
+  {
+    if (!m_heap.empty ())
+      {
+        m_sendEvent = Simulator::Schedule (TimeStep (m_heap.front ().first) - Simulator::Now (),
+                                           &SliceGroupClient::SendDue, this);
+      }
+  }
+
+  void
+  SendDue ()
+  {
+    ++m_wakeUps;
+    Time now = Simulator::Now ();
+    while (!m_heap.empty () && m_heap.front ().first <= now.GetTimeStep ())
+      {
+        std::pop_heap (m_heap.begin (), m_heap.end (), std::greater<Entry> ());
+        uint32_t index = m_heap.back ().second;
+        Flow &flow = m_flows[index];
+        Send (flow);
+        if (flow.sent == 1)
+          {
+            flow.burstEnd = m_trafficPattern.FirstBurstEnd (now);
+          }
+        m_heap.back ().first = (now + m_trafficPattern.NextGap (now, flow.burstEnd)).GetTimeStep ();
+        std::push_heap (m_heap.begin (), m_heap.end (), std::greater<Entry> ());
+      }
+    ScheduleNext ();
+  }
+
+  void
+  Send (Flow &flow)
+  {
+    SeqTsHeader seqTs;
+    seqTs.SetSeq (flow.sent++);
+    Ptr<Packet> p = Create<Packet> (m_size - seqTs.GetSerializedSize ());
+    p->AddHeader (seqTs);
+    m_txTrace (p);
+    m_socket->SendTo (p, 0, flow.peer);
+  }
+
+  uint32_t m_size = 1024;
+  std::string m_pattern;
+  Time m_interval;
+  Time m_onTime;
+  Time m_offTime;
+
+  bool m_configured = false;
+  TrafficPattern m_trafficPattern;
+  std::vector<Flow> m_flows;
+  std::vector<Entry> m_heap;
+  Ptr<Socket> m_socket;
+  EventId m_sendEvent;
+  uint64_t m_wakeUps = 0;
+  TracedCallback<Ptr<const Packet>> m_txTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SliceGroupClient);
+
+} // namespace ns3
+
+#endif /* SLICE_GROUP_CLIENT_H */
@@ -0,0 +1,373 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef SLICE_TRAFFIC_PROFILE_H
+#define SLICE_TRAFFIC_PROFILE_H
+
+#include "ns3/core-module.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Traffic profile of one slice of the slicing_AD_v5 scenario.
+ *
+ * A profile is written as a name followed by key=value pairs, e.g.
+ *
+ *   urllc share=1 size=45 pattern=constant interval=0.0004 start=0.1
+ *
+ * Times are in seconds. Unset keys keep the defaults below.
+ */
+struct SliceProfile
+{
+  std::string name;
+  double share = 1;             ///< relative weight in the UE population
+  uint32_t packetSize = 1024;   ///< bytes, including the 12-byte SeqTsHeader
+  std::string pattern = "constant"; ///< "constant", "poisson" or "onoff"
+  double interval = 0.01;       ///< (mean) gap between packets [s]
+  double onTime = 1;            ///< mean burst duration for "onoff" [s]
+  double offTime = 1;           ///< mean silence between bursts for "onoff" [s]
+  double start = 0.1;           ///< application start time [s]
+  double startSpread = 0;       ///< per-UE start offset, uniform in [0, startSpread) [s]
+};
+
+/// The three slices of the original scenario
+inline std::vector<SliceProfile>
+DefaultSliceProfiles ()
+{
+  SliceProfile urllc;
+  urllc.name = "urllc";
+  urllc.packetSize = 45;
+  urllc.interval = 0.0004;
+
+  SliceProfile embb;
+  embb.name = "embb";
+  embb.packetSize = 4500;
+  embb.interval = 0.0035;
+
+  SliceProfile mmtc;
+  mmtc.name = "mmtc";
+  mmtc.packetSize = 100;
+  mmtc.interval = 0.08;
+
+  return {urllc, embb, mmtc};
+}
+
+/// Value of a time or share key of a profile; aborts unless the whole value is a finite number
+inline double
+ParseProfileDouble (const SliceProfile &profile, const std::string &key, const std::string &value)
+{
+  char *end = nullptr;
+  errno = 0;
+  double v = std::strtod (value.c_str (), &end);
+  if (value.empty () || *end != '\0' || errno == ERANGE || !std::isfinite (v))
+    {
+      NS_FATAL_ERROR ("Slice profile " << profile.name << ": " << key << "=" << value
+                                       << " is not a number");
+    }
+  return v;
+}
+
+/// Value of the size key of a profile; aborts unless it is a whole number that fits 32 bits
+inline uint32_t
+ParseProfileSize (const SliceProfile &profile, const std::string &key, const std::string &value)
+{
+  char *end = nullptr;
+  errno = 0;
+  unsigned long long v = std::strtoull (value.c_str (), &end, 10);
+  if (value.empty () || !std::isdigit (static_cast<unsigned char> (value[0])) || *end != '\0' ||
+      errno == ERANGE || v > UINT32_MAX)
+    {
+      NS_FATAL_ERROR ("Slice profile " << profile.name << ": " << key << "=" << value
+                                       << " is not a size in bytes");
+    }
+  return v;
+}
+
+inline SliceProfile
+ParseSliceProfile (const std::string &spec)
+{
+  std::istringstream tokens (spec);
+  SliceProfile profile;
+  tokens >> profile.name;
+  std::string token;
+  while (tokens >> token)
+    {
+      size_t eq = token.find ('=');
+      NS_ABORT_MSG_IF (eq == std::string::npos,
+                       "Slice profile " << profile.name << ": expected key=value, got " << token);
+      std::string key = token.substr (0, eq);
+      std::string value = token.substr (eq + 1);
+      if (key == "share")
+        {
+          profile.share = ParseProfileDouble (profile, key, value);
+        }
+      else if (key == "size")
+        {
+          profile.packetSize = ParseProfileSize (profile, key, value);
+        }
+      else if (key == "pattern")
+        {
+          profile.pattern = value;
+        }
+      else if (key == "interval")
+        {
+          profile.interval = ParseProfileDouble (profile, key, value);
+        }
+      else if (key == "on")
+        {
+          profile.onTime = ParseProfileDouble (profile, key, value);
+        }
+      else if (key == "off")
+        {
+          profile.offTime = ParseProfileDouble (profile, key, value);
+        }
+      else if (key == "start")
+        {
+          profile.start = ParseProfileDouble (profile, key, value);
+        }
+      else if (key == "startSpread")
+        {
+          profile.startSpread = ParseProfileDouble (profile, key, value);
+        }
+      else
+        {
+          NS_ABORT_MSG ("Slice profile " << profile.name << ": unknown key " << key);
+        }
+    }
+
+  NS_ABORT_MSG_IF (profile.name.empty (), "Slice profile without a name");
+  NS_ABORT_MSG_IF (profile.pattern != "constant" && profile.pattern != "poisson" &&
+                       profile.pattern != "onoff",
+                   "Slice profile " << profile.name << ": unknown pattern " << profile.pattern);
+  NS_ABORT_MSG_IF (profile.share < 0, "Slice profile " << profile.name << ": negative share");
+  NS_ABORT_MSG_IF (profile.interval <= 0, "Slice profile " << profile.name << ": interval must be > 0");
+  NS_ABORT_MSG_IF (profile.packetSize < 12,
+                   "Slice profile " << profile.name << ": size must hold the 12-byte SeqTsHeader");
+  return profile;
+}
+
+/**
+ * Read the slice profiles from a file (one profile per line, '#' starts a
+ * comment) and/or from an inline list separated by ';'. Without either,
+ * the three default slices are used.
+ */
+inline std::vector<SliceProfile>
+LoadSliceProfiles (const std::string &filename, const std::string &inlineProfiles)
+{
+  std::vector<std::string> specs;
+  if (!filename.empty ())
+    {
+      std::ifstream in (filename.c_str ());
+      NS_ABORT_MSG_IF (!in.is_open (), "Can't open slice profile file " << filename);
+      std::string line;
+      while (std::getline (in, line))
+        {
+          specs.push_back (line.substr (0, line.find ('#')));
+        }
+    }
+  std::istringstream entries (inlineProfiles);
+  std::string entry;
+  while (std::getline (entries, entry, ';'))
+    {
+      specs.push_back (entry);
+    }
+
+  std::vector<SliceProfile> profiles;
+  for (const std::string &spec : specs)
+    {
+      if (spec.find_first_not_of (" \t\r") != std::string::npos)
+        {
+          profiles.push_back (ParseSliceProfile (spec));
+        }
+    }
+  return profiles.empty () ? DefaultSliceProfiles () : profiles;
+}
+
+/**
+ * Split nUes among the profiles proportionally to their share, using the
+ * largest remainder so that the counts always add up to nUes.
+ */
+inline std::vector<uint32_t>
+DistributeUes (const std::vector<SliceProfile> &profiles, uint32_t nUes)
+{
+  double totalShare = 0;
+  for (const SliceProfile &p : profiles)
+    {
+      totalShare += p.share;
+    }
+  NS_ABORT_MSG_IF (totalShare <= 0, "The slice profile shares add up to zero");
+
+  std::vector<uint32_t> counts (profiles.size ());
+  std::vector<double> remainders (profiles.size ());
+  uint32_t assigned = 0;
+  for (uint32_t i = 0; i < profiles.size (); ++i)
+    {
+      double exact = nUes * profiles[i].share / totalShare;
+      counts[i] = static_cast<uint32_t> (std::floor (exact));
+      remainders[i] = exact - counts[i];
+      assigned += counts[i];
+    }
+  while (assigned < nUes)
+    {
+      uint32_t best = 0;
+      for (uint32_t i = 1; i < profiles.size (); ++i)
+        {
+          if (remainders[i] > remainders[best])
+            {
+              best = i;
+            }
+        }
+      ++counts[best];
+      remainders[best] = -1;
+      ++assigned;
+    }
+  return counts;
+}
+
+/**
+ * Inter-packet gap generator for the "constant", "poisson" and "onoff"
+ * patterns. For "onoff" the packets are sent every interval during bursts
+ * of exponential duration (mean onTime), separated by exponential
+ * silences (mean offTime). Random variables are only created for the
+ * random patterns, so that the constant pattern does not consume streams.
+ */
+class TrafficPattern
+{
+public:
+  void
+  Configure (const std::string &pattern, Time interval, Time onTime, Time offTime)
+  {
+    m_interval = interval;
+    if (pattern == "poisson")
+      {
+        m_kind = POISSON;
+        m_gap = CreateObject<ExponentialRandomVariable> ();
+        m_gap->SetAttribute ("Mean", DoubleValue (interval.GetSeconds ()));
+      }
+    else if (pattern == "onoff")
+      {
+        m_kind = ONOFF;
+        m_on = CreateObject<ExponentialRandomVariable> ();
+        m_on->SetAttribute ("Mean", DoubleValue (onTime.GetSeconds ()));
+        m_off = CreateObject<ExponentialRandomVariable> ();
+        m_off->SetAttribute ("Mean", DoubleValue (offTime.GetSeconds ()));
+      }
+    else
+      {
+        NS_ABORT_MSG_IF (pattern != "constant", "Unknown traffic pattern " << pattern);
+        m_kind = CONSTANT;
+      }
+  }
+
+  /// Change the (mean) gap between packets, from the next gap on
+  void
+  SetInterval (Time interval)
+  {
+    m_interval = interval;
+    if (m_gap)
+      {
+        m_gap->SetAttribute ("Mean", DoubleValue (interval.GetSeconds ()));
+      }
+  }
+
+  int64_t
+  AssignStreams (int64_t stream)
+  {
+    int64_t used = 0;
+    for (Ptr<ExponentialRandomVariable> rv : {m_gap, m_on, m_off})
+      {
+        if (rv)
+          {
+            rv->SetStream (stream + used);
+            ++used;
+          }
+      }
+    return used;
+  }
+
+  /// Called when the first packet is sent at time now
+  void
+  Start (Time now)
+  {
+    m_burstEnd = FirstBurstEnd (now);
+  }
+
+  /// \return the time between the packet sent at now and the next one
+  Time
+  NextGap (Time now)
+  {
+    return NextGap (now, m_burstEnd);
+  }
+
+  /**
+   * Same as Start and NextGap, with the burst state kept by the caller, so
+   * that one pattern (and its random variables) can drive several flows
+   */
+  Time
+  FirstBurstEnd (Time now)
+  {
+    return m_kind == ONOFF ? now + Seconds (m_on->GetValue ()) : now;
+  }
+
+  Time
+  NextGap (Time now, Time &burstEnd)
+  {
+    switch (m_kind)
+      {
+      case POISSON:
+        return Seconds (m_gap->GetValue ());
+      case ONOFF:
+        if (now + m_interval >= burstEnd)
+          {
+            // Skip the silence and start a new burst
+            Time next = burstEnd + Seconds (m_off->GetValue ());
+            burstEnd = next + Seconds (m_on->GetValue ());
+            return next > now ? next - now : m_interval;
+          }
+        return m_interval;
+      default:
+        return m_interval;
+      }
+  }
+
+private:
+  enum Kind
+  {
+    CONSTANT,
+    POISSON,
+    ONOFF
+  };
+
+  Kind m_kind = CONSTANT;
+  Time m_interval;
+  Time m_burstEnd;
+  Ptr<ExponentialRandomVariable> m_gap;
+  Ptr<ExponentialRandomVariable> m_on;
+  Ptr<ExponentialRandomVariable> m_off;
+};
+
+} // namespace ns3
+
+#endif /* SLICE_TRAFFIC_PROFILE_H */
@@ -0,0 +1,173 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef SLICE_UDP_CLIENT_H
+#define SLICE_UDP_CLIENT_H
+
+#include "slice-traffic-profile.h"
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+
+namespace ns3 {
+
+/**
+ * UDP client with the same packet format as UdpClient (a SeqTsHeader at
+ * the start of every packet, PacketSize bytes in total) whose gaps follow
+ * a TrafficPattern. Used by the slice profiles whose pattern is not
+ * "constant"; constant profiles keep using UdpClient.
+ */
+class SliceUdpClient : public Application
+{
+public:
+  static TypeId
+  GetTypeId ()
+  {
+    static TypeId tid =
+        TypeId ("ns3::SliceUdpClient")
+            .SetParent<Application> ()
+            .SetGroupName ("Applications")
+            .AddConstructor<SliceUdpClient> ()
+            .AddAttribute ("RemoteAddress", "The destination IPv4 address of the packets",
+                           Ipv4AddressValue (), MakeIpv4AddressAccessor (&SliceUdpClient::m_peerAddress),
+                           MakeIpv4AddressChecker ())
+            .AddAttribute ("RemotePort", "The destination port of the packets", UintegerValue (100),
+                           MakeUintegerAccessor (&SliceUdpClient::m_peerPort),
+                           MakeUintegerChecker<uint16_t> ())
+            .AddAttribute ("PacketSize", "Size of the packets, including the SeqTsHeader",
+                           UintegerValue (1024), MakeUintegerAccessor (&SliceUdpClient::m_size),
+                           MakeUintegerChecker<uint32_t> (12, 65507))
+            .AddAttribute ("Pattern", "Gap distribution: constant, poisson or onoff",
+                           StringValue ("constant"), MakeStringAccessor (&SliceUdpClient::m_pattern),
+                           MakeStringChecker ())
+            .AddAttribute ("Interval", "(Mean) time between packets", TimeValue (Seconds (1)),
+                           MakeTimeAccessor (&SliceUdpClient::SetInterval, &SliceUdpClient::GetInterval),
+                           MakeTimeChecker ())
+            .AddAttribute ("OnTime", "Mean burst duration of the onoff pattern", TimeValue (Seconds (1)),
+                           MakeTimeAccessor (&SliceUdpClient::m_onTime), MakeTimeChecker ())
+            .AddAttribute ("OffTime", "Mean silence between bursts of the onoff pattern",
+                           TimeValue (Seconds (1)), MakeTimeAccessor (&SliceUdpClient::m_offTime),
+                           MakeTimeChecker ())
+            .AddTraceSource ("Tx", "A new packet is created and sent",
+                             MakeTraceSourceAccessor (&SliceUdpClient::m_txTrace),
+                             "ns3::Packet::TracedCallback");
+    return tid;
+  }
+
+  SliceUdpClient ()
+    : m_peerPort (100),
+      m_size (1024),
+      m_sent (0)
+  {
+  }
+
+  /// Configure the pattern now so that AssignStreams can be used before the start
+  int64_t
+  AssignStreams (int64_t stream)
+  {
+    m_trafficPattern.Configure (m_pattern, m_interval, m_onTime, m_offTime);
+    m_configured = true;
+    return m_trafficPattern.AssignStreams (stream);
+  }
+
+  /// Can be changed while the application runs, e.g. by a slice control command
+  void
+  SetInterval (Time interval)
+  {
+    m_interval = interval;
+    if (m_configured)
+      {
+        m_trafficPattern.SetInterval (interval);
+      }
+  }
+
+  Time
+  GetInterval () const
+  {
+    return m_interval;
+  }
+
+protected:
+  void
+  DoDispose () override
+  {
+    m_socket = nullptr;
+    Application::DoDispose ();
+  }
+
+private:
+  void
+  StartApplication () override
+  {
+    if (!m_configured)
+      {
+        m_trafficPattern.Configure (m_pattern, m_interval, m_onTime, m_offTime);
+        m_configured = true;
+      }
+    if (!m_socket)
+      {
+        m_socket = Socket::CreateSocket (GetNode (), UdpSocketFactory::GetTypeId ());
+        m_socket->Bind ();
+        m_socket->Connect (InetSocketAddress (m_peerAddress, m_peerPort));
+        m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket>> ());
+        m_socket->SetAllowBroadcast (true);
+      }
+    m_trafficPattern.Start (Simulator::Now ());
+    m_sendEvent = Simulator::ScheduleNow (&SliceUdpClient::Send, this);
+  }
+
+  void
+  StopApplication () override
+  {
+    Simulator::Cancel (m_sendEvent);
+  }
+
+  void
+  Send ()
+  {
+    SeqTsHeader seqTs;
+    seqTs.SetSeq (m_sent++);
+    Ptr<Packet> p = Create<Packet> (m_size - seqTs.GetSerializedSize ());
+    p->AddHeader (seqTs);
+    m_txTrace (p);
+    m_socket->Send (p);
+    m_sendEvent = Simulator::Schedule (m_trafficPattern.NextGap (Simulator::Now ()),
+                                       &SliceUdpClient::Send, this);
+  }
+
+  Ipv4Address m_peerAddress;
+  uint16_t m_peerPort;
+  uint32_t m_size;
+  std::string m_pattern;
+  Time m_interval;
+  Time m_onTime;
+  Time m_offTime;
+
+  bool m_configured = false;
+  TrafficPattern m_trafficPattern;
+  Ptr<Socket> m_socket;
+  uint32_t m_sent;
+  EventId m_sendEvent;
+  TracedCallback<Ptr<const Packet>> m_txTrace;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (SliceUdpClient);
+
+} // namespace ns3
+
+#endif /* SLICE_UDP_CLIENT_H */
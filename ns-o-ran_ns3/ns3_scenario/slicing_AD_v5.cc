@@ -24,14 +24,33 @@
 #include "ns3/applications-module.h"
 #include "ns3/point-to-point-helper.h"
 #include <ns3/lte-ue-net-device.h>
+#include <ns3/mc-ue-net-device.h>
+#include <ns3/lte-enb-rrc.h>
 #include "ns3/mmwave-helper.h"
 #include "ns3/epc-helper.h"
 #include "ns3/mmwave-point-to-point-epc-helper.h"
 #include "ns3/lte-helper.h"
+#include "datarate-columnar-file.h"
+#include "rx-window-stats.h"
+#include "latency-histogram.h"
+#include "slice-udp-client.h"
+#include "slice-group-client.h"
+#include "cell-topology.h"
+#include "scenario-profiler.h"
+#include "trace-record-sink.h"
+#include "kpm-shm-ring.h"
+#include "control-input.h"
+#include "scenario-logger.h"
+#include "realtime-pacer.h"
+#include "cached-umi-propagation-loss-model.h"
+#include "trace-replay-mobility-model.h"
 #include <fstream> // For file output
-#include <map>     // For mapping UE ID to output file
+#include <vector>  // For per-UE reporting state
 #include <string>  // For string manipulation
 #include <cmath>   // For std::sqrt
+#include <array>   // For the trace decimation counters
+#include <map>     // For the per-cell UE counts of the KPM export
+#include <deque>   // For the loss intervals waiting for the reorder grace
 
 using namespace ns3;
 using namespace mmwave;
@@ -42,66 +61,895 @@ using namespace mmwave;
 
 NS_LOG_COMPONENT_DEFINE ("ScenarioZero");
 
-// Global variables for data rate reporting
-// We'll map internal Node ID to the PacketSink, as GetId() is unique
-std::map<uint32_t, Ptr<PacketSink>> g_uePacketSinks;
-// Files will be mapped by Node ID, but named by slice type and index
-std::map<uint32_t, std::ofstream*> g_ueDataRateFiles;
-std::map<uint32_t, double> g_ueLastTotalRxBytes;
-std::map<uint32_t, double> g_ueLastThroughputTime;
-// Map Node ID to a more user-friendly string (e.g., "urllc_ue_0")
-std::map<uint32_t, std::string> g_ueIdToSliceName;
+// Per-UE state for data rate reporting, indexed by the UE position in ueNodes.
+// Built once in main so that each reporting tick is a linear sweep over a
+// contiguous array instead of several map lookups per UE.
+struct UeThroughputState
+{
+  Ptr<PacketSink> sink;
+  std::ofstream *dataRateFile; // e.g. "urllc_ue_0_datarate.txt"
+  uint64_t lastTotalRxBytes;
+  double lastThroughputTime;
+};
+
+std::vector<UeThroughputState> g_ueThroughput;
+// Cold per-UE data, only used for logging and file naming
+std::vector<uint32_t> g_ueNodeIds;
+std::vector<std::string> g_ueSliceNames; // e.g. "urllc_ue_0"
+std::vector<uint8_t> g_ueSliceIds; // index into g_sliceNames, stored as uint8_t in datarate.col
+const uint32_t kMaxSlices = 256;
+
+// Fixed random streams, so that what a cell or UE draws does not depend on the order in which
+// the other objects of the scenario are created, nor on which of them a cluster simulates.
+// The aggregated traffic clients have 3 streams per slice (gaps, on and off times); every node
+// has a block of kStreamsPerNode, numbered by its index in the full topology: LTE anchors,
+// then mmWave cells, then UEs. The drop of the UEs in the disc has a block of its own
+const int64_t kUePositionStreams = 990;
+const int64_t kSliceTrafficStreams = 1000;
+const int64_t kNodeStreams = kSliceTrafficStreams + 3 * kMaxSlices;
+const int64_t kStreamsPerNode = 64;
+// Offsets in the block of a node
+const int64_t kDeviceStreams = 0;      // net device (MAC, PHY, ...), up to 48 streams
+const int64_t kMobilityStreams = 48;   // mobility model, up to 8
+const int64_t kUeTrafficStreams = 56;  // per-UE traffic client, 3
+const int64_t kStartSpreadStream = 59; // start time of the UE's client
+std::vector<std::string> g_sliceNames = {"urllc", "embb", "mmtc"};
 
 std::string g_outputDir = "."; // Default output directory
 double g_reportingInterval = 0.5; // Report every 0.5 seconds
+// "text": one <ue>_datarate.txt per UE, "columnar": a single datarate.col for all UEs
+std::string g_dataRateFormat = "text";
+datarate::ColumnarWriter g_columnarDataRate;
+// Slice traffic profiles, see slice-traffic-profile.h
+std::string g_sliceProfileFile = "";
+std::string g_sliceProfiles = "";
+// "per-ue": one client application per UE, "aggregated": one SliceGroupClient per slice
+std::string g_trafficGenerator = "per-ue";
+
+// "poll": sample every sink each reportingInterval, "rx-trace": windowed stats from the sink Rx trace
+std::string g_throughputSampling = "poll";
+std::vector<rxwindow::UeRxWindow> g_ueRxWindows;
+std::ofstream g_rxWindowFile;
+
+// Opt-in runtime profile, written to profile.txt when profileInterval > 0
+double g_profileInterval = 0;
+ScenarioProfiler g_profiler;
+
+// Real-time pacing for runs with the RIC in the loop (see realtime-pacer.h), off when
+// realtimeSpeed is 0. When the run falls behind, the optional outputs are decimated
+double g_realtimeSpeed = 0;
+double g_realtimeTick = 0.001;
+double g_realtimeLagThreshold = 0.01;
+RealtimePacer g_pacer;
+uint64_t g_throughputTicks = 0;
+
+// Precomputed UMi pathloss map (see cached-umi-propagation-loss-model.h): "" for the exact
+// model, "memory" for a map built in every run, else the file it is kept in across runs
+std::string g_pathlossMap = "";
+double g_pathlossMapResolution = 10;
+double g_pathlossMapTolerance = 1;
+
+// Trajectory files (see trajectory-file.h): mobilityTrace replays one instead of the random
+// walk, mobilityRecord samples the UE positions of the run into one
+std::string g_mobilityTrace = "";
+std::string g_mobilityRecord = "";
+double g_mobilityRecordPeriod = 0.1;
+trajectory::TrajectoryRecorder g_trajectoryRecorder;
+
+void
+RecordTrajectories (NodeContainer ues, Time period)
+{
+  std::vector<trajectory::Point> positions;
+  positions.reserve (ues.GetN ());
+  for (uint32_t u = 0; u < ues.GetN (); ++u)
+    {
+      Vector p = ues.Get (u)->GetObject<MobilityModel> ()->GetPosition ();
+      positions.push_back ({float (p.x), float (p.y), float (p.z)});
+    }
+  g_trajectoryRecorder.AddSample (positions);
+  Simulator::Schedule (period, &RecordTrajectories, ues, period);
+}
+
+// Isolated clusters, an approximate mode: with numIsolatedClusters > 1 this process simulates
+// only cluster isolatedClusterIndex of the topology, i.e. a sector of LTE anchors with their
+// mmWave cells and UEs, as if the rest of the topology did not exist. It is not a parallel run
+// of the full topology: see the README. cluster_map.txt maps the cell ids and IMSIs of the
+// cluster to those of the full topology
+uint32_t g_numIsolatedClusters = 1;
+uint32_t g_isolatedClusterIndex = 0;
+
+// Shared-memory KPM export (see kpm-shm-ring.h), off when kpmShm is empty
+std::string g_kpmShm = "";
+uint32_t g_kpmShmCapacity = 65536;
+kpmshm::RingWriter g_kpmRing;
+
+// Per-UE KPM counters of the current indication period, reset at every publication
+struct UeKpmState
+{
+  uint64_t imsi = 0;
+  uint16_t cellId = 0; // cell of the last RRC reconfiguration
+  bool bearersConnected = false;
+  double lastSinrDb = 0;
+  double sinrSumDb = 0;
+  uint32_t sinrSamples = 0;
+  uint32_t tbs = 0;
+  uint32_t corruptedTbs = 0;
+  uint64_t tbBytes = 0;
+  uint64_t mcsSum = 0;
+  uint32_t pdcpPdus = 0;
+  uint64_t pdcpBytes = 0;
+  uint64_t pdcpDelayNsSum = 0;
+};
+
+std::vector<UeKpmState> g_ueKpm;
+
+kpmshm::KpmRecord
+MakeKpmRecord (kpmshm::RecordType type, uint32_t ueIndex, double time)
+{
+  kpmshm::KpmRecord r;
+  r.time = time;
+  r.imsi = g_ueKpm[ueIndex].imsi;
+  r.ue = ueIndex;
+  r.cellId = g_ueKpm[ueIndex].cellId;
+  r.type = type;
+  r.flags = 0;
+  r.count = 0;
+  r.reserved = 0;
+  r.v[0] = r.v[1] = r.v[2] = r.v[3] = 0;
+  return r;
+}
+
+// Per-UE log messages: "ns-log" writes them with NS_LOG_UNCOND as before, "async" and
+// "binary" through the background writer of scenario-logger.h, "off" drops them
+std::string g_logMode = "ns-log";
+std::string g_logFile = "";
+std::string g_logSampling = "";
+std::string g_logRateLimit = "";
+bool g_logUncond = true;
+scenariolog::AsyncLogger g_logger;
+
+void
+LogThroughput (uint32_t ueIndex, double time, double throughputMbps)
+{
+  if (g_logger.IsRunning ())
+    {
+      g_logger.Log (scenariolog::THROUGHPUT, time, ueIndex, throughputMbps);
+    }
+  else if (g_logUncond)
+    {
+      // Log with the friendly slice name
+      NS_LOG_UNCOND ("UE " << g_ueSliceNames[ueIndex] << " (Node ID: " << g_ueNodeIds[ueIndex] << ") Throughput: " << throughputMbps << " Mbps at time " << time << "s");
+    }
+}
+
+// Same text as the NS_LOG_UNCOND lines, built by the writer thread
+void
+FormatLogRecord (std::ostream &out, const scenariolog::LogRecord &r)
+{
+  if (r.category == scenariolog::THROUGHPUT)
+    {
+      out << "UE " << g_ueSliceNames[r.ue] << " (Node ID: " << g_ueNodeIds[r.ue]
+          << ") Throughput: " << r.v0 << " Mbps at time " << r.time << "s";
+    }
+  else
+    {
+      out << "UE " << g_ueSliceNames[r.ue] << " (Node ID: " << uint32_t (r.v1) << ") assigned to "
+          << g_sliceNames[uint32_t (r.v0)] << " slice.";
+    }
+}
+
+// Write one throughput sample for the UE with index ueIndex
+void
+ReportThroughput (uint32_t ueIndex, double time, double throughputMbps)
+{
+  bool reported = false;
+  if (g_columnarDataRate.IsOpen ())
+    {
+      g_columnarDataRate.Append (time, ueIndex, throughputMbps);
+      NS_ABORT_MSG_IF (!g_columnarDataRate.IsGood (),
+                       "Write error on " << g_outputDir << "/datarate.col");
+      reported = true;
+    }
+  else
+    {
+      std::ofstream *outFile = g_ueThroughput[ueIndex].dataRateFile;
+      if (outFile && outFile->is_open ())
+        {
+          *outFile << time << "\t" << throughputMbps << std::endl;
+          reported = true;
+        }
+    }
+  if (g_kpmRing.IsOpen ())
+    {
+      kpmshm::KpmRecord r = MakeKpmRecord (kpmshm::UE_THROUGHPUT, ueIndex, time);
+      r.v[0] = throughputMbps;
+      g_kpmRing.Publish (r);
+    }
+  if (reported)
+    {
+      SCENARIO_LOG_HOT (LogThroughput (ueIndex, time, throughputMbps));
+    }
+}
 
 // Function to calculate and report throughput for each UE
 void
-CalculateThroughput (const NodeContainer& ueNodes, Time reportInterval)
+CalculateThroughput (Time reportInterval)
 {
-  for (uint32_t i = 0; i < ueNodes.GetN (); ++i)
+  double currentTime = Simulator::Now ().GetSeconds ();
+  g_profiler.Count (ScenarioProfiler::THROUGHPUT_TICK);
+
+  // Behind real time: skip ticks, the next report covers the whole longer interval
+  if (++g_throughputTicks % g_pacer.GetDegradeFactor () != 0)
     {
-      Ptr<Node> ueNode = ueNodes.Get (i);
-      Ptr<PacketSink> sink = g_uePacketSinks[ueNode->GetId ()];
+      Simulator::Schedule (reportInterval, &CalculateThroughput, reportInterval);
+      return;
+    }
 
-      if (sink)
+  for (uint32_t i = 0; i < g_ueThroughput.size (); ++i)
+    {
+      UeThroughputState &ue = g_ueThroughput[i];
+      if (!ue.sink)
         {
-          double currentTotalRxBytes = sink->GetTotalRx ();
-          double currentTime = Simulator::Now ().GetSeconds ();
+          continue;
+        }
 
-          // Retrieve last values for this specific UE
-          double lastTotalRxBytes = g_ueLastTotalRxBytes[ueNode->GetId ()];
-          double lastThroughputTime = g_ueLastThroughputTime[ueNode->GetId ()];
+      uint64_t currentTotalRxBytes = ue.sink->GetTotalRx ();
 
-          // Calculate instantaneous throughput since last report for this UE
-          double intervalBytes = currentTotalRxBytes - lastTotalRxBytes;
-          double intervalTime = currentTime - lastThroughputTime;
+      // Calculate instantaneous throughput since last report for this UE
+      double intervalBytes = currentTotalRxBytes - ue.lastTotalRxBytes;
+      double intervalTime = currentTime - ue.lastThroughputTime;
 
-          if (intervalTime > 0)
-            {
-              double throughputMbps = (intervalBytes * 8.0) / (intervalTime * 1000000.0);
-
-              // Get the correct output file for this UE
-              std::ofstream* outFile = g_ueDataRateFiles[ueNode->GetId ()];
-              if (outFile && outFile->is_open ())
-                {
-                  *outFile << currentTime << "\t" << throughputMbps << std::endl;
-                  // Log with the friendly slice name
-                  NS_LOG_UNCOND ("UE " << g_ueIdToSliceName[ueNode->GetId ()] << " (Node ID: " << ueNode->GetId() << ") Throughput: " << throughputMbps << " Mbps at time " << currentTime << "s");
-                }
-            }
-          // Update last values for this specific UE for the next interval
-          g_ueLastTotalRxBytes[ueNode->GetId ()] = currentTotalRxBytes;
-          g_ueLastThroughputTime[ueNode->GetId ()] = currentTime;
+      if (intervalTime > 0)
+        {
+          double throughputMbps = (intervalBytes * 8.0) / (intervalTime * 1000000.0);
+          ReportThroughput (i, currentTime, throughputMbps);
+        }
+      // Update last values for this specific UE for the next interval
+      ue.lastTotalRxBytes = currentTotalRxBytes;
+      ue.lastThroughputTime = currentTime;
+    }
+
+  Simulator::Schedule (reportInterval, &CalculateThroughput, reportInterval);
+}
+
+// Write a closed receive window of a UE, both as throughput sample and as window statistics
+void
+ReportRxWindow (uint32_t ueIndex, const rxwindow::WindowSummary &w)
+{
+  ReportThroughput (ueIndex, w.end, w.mbps);
+  if (g_rxWindowFile.is_open ())
+    {
+      g_rxWindowFile << w.start << "\t" << w.end << "\t" << g_ueSliceNames[ueIndex] << "\t"
+                     << w.packets << "\t" << w.mbps << "\t" << w.iatMean * 1e3 << "\t"
+                     << w.iatP50 * 1e3 << "\t" << w.iatP99 * 1e3 << "\t" << w.jitter * 1e3
+                     << "\n";
+    }
+}
+
+// Sequence numbers [first, end) sent in one reporting interval and how many of them arrived
+struct SeqRange
+{
+  uint64_t first;
+  uint64_t end;
+  uint64_t received;
+  double closedAt;
+};
+
+// Per-UE one-way delay and loss, from the SeqTsHeader stamped by the UDP clients. The loss of
+// an interval is settled only latencyReorderGrace seconds after it closed, so that a packet
+// reordered across a report boundary is still counted in the interval that sent it
+struct UeLatencyState
+{
+  latency::LogLinearHistogram delayNs; // delays of the current reporting interval
+  uint64_t expected = 0; // highest sequence number seen + 1
+  uint64_t openFirst = 0; // first sequence number of the current interval
+  uint64_t openReceived = 0; // packets of the current interval received so far
+  std::deque<SeqRange> pending; // closed intervals waiting for the grace period, oldest first
+};
+
+bool g_enableLatencyKpi = false;
+double g_latencyReorderGrace = 0.1;
+std::vector<UeLatencyState> g_ueLatency;
+std::ofstream g_sliceLatencyFile;
+
+// O(1) per packet: one histogram increment and two counters
+void
+RecordUeLatency (uint32_t ueIndex, Ptr<const Packet> packet)
+{
+  SeqTsHeader seqTs;
+  if (packet->GetSize () < seqTs.GetSerializedSize ())
+    {
+      return;
+    }
+  packet->PeekHeader (seqTs);
+  UeLatencyState &ue = g_ueLatency[ueIndex];
+  int64_t delay = (Simulator::Now () - seqTs.GetTs ()).GetNanoSeconds ();
+  ue.delayNs.Record (delay > 0 ? delay : 0);
+  uint64_t seq = seqTs.GetSeq ();
+  ue.expected = std::max<uint64_t> (ue.expected, seq + 1);
+  if (seq >= ue.openFirst)
+    {
+      ++ue.openReceived;
+      return;
+    }
+  // Late packet of a closed interval: the ranges are contiguous, newest at the back
+  for (auto range = ue.pending.rbegin (); range != ue.pending.rend (); ++range)
+    {
+      if (seq >= range->first)
+        {
+          ++range->received;
+          break;
+        }
+    }
+}
+
+// Merge the per-UE histograms of each slice and write the slice delay/loss KPIs
+void
+ReportSliceLatency (Time reportInterval)
+{
+  double currentTime = Simulator::Now ().GetSeconds ();
+  std::vector<latency::LogLinearHistogram> sliceDelay (g_sliceNames.size ());
+  std::vector<uint64_t> sliceLost (g_sliceNames.size (), 0);
+  std::vector<uint64_t> sliceSettled (g_sliceNames.size (), 0);
+
+  for (uint32_t i = 0; i < g_ueLatency.size (); ++i)
+    {
+      UeLatencyState &ue = g_ueLatency[i];
+      ue.pending.push_back ({ue.openFirst, ue.expected, ue.openReceived, currentTime});
+      ue.openFirst = ue.expected;
+      ue.openReceived = 0;
+      while (!ue.pending.empty ()
+             && ue.pending.front ().closedAt + g_latencyReorderGrace <= currentTime)
+        {
+          const SeqRange &range = ue.pending.front ();
+          uint64_t sent = range.end - range.first;
+          sliceSettled[g_ueSliceIds[i]] += sent;
+          sliceLost[g_ueSliceIds[i]] += sent > range.received ? sent - range.received : 0;
+          ue.pending.pop_front ();
+        }
+      if (ue.delayNs.GetCount () > 0)
+        {
+          sliceDelay[g_ueSliceIds[i]].Add (ue.delayNs);
+          ue.delayNs.Reset ();
+        }
+    }
+
+  for (uint32_t s = 0; s < g_sliceNames.size (); ++s)
+    {
+      const latency::LogLinearHistogram &h = sliceDelay[s];
+      uint64_t packets = h.GetCount ();
+      double lossRatio = sliceSettled[s] > 0 ? double (sliceLost[s]) / sliceSettled[s] : 0;
+      g_sliceLatencyFile << currentTime << "\t" << g_sliceNames[s] << "\t" << packets << "\t"
+                         << sliceLost[s] << "\t" << lossRatio << "\t" << h.GetQuantile (0.5) / 1e6
+                         << "\t" << h.GetQuantile (0.99) / 1e6 << "\t" << h.GetQuantile (0.999) / 1e6
+                         << "\t" << h.GetMax () / 1e6 << "\n";
+    }
+
+  Simulator::Schedule (reportInterval, &ReportSliceLatency, reportInterval);
+}
+
+// PacketSink Rx trace of the UE with index ueIndex, shared by the rx-trace throughput
+// sampling and the latency KPIs. Receive windows are closed by packet arrivals,
+// so idle UEs cost nothing between packets
+void
+UeSinkRx (uint32_t ueIndex, Ptr<const Packet> packet, const Address &)
+{
+  g_profiler.Count (ScenarioProfiler::SINK_RX);
+  if (!g_ueRxWindows.empty ())
+    {
+      g_ueRxWindows[ueIndex].OnRx (Simulator::Now ().GetSeconds (), packet->GetSize (),
+                                   [ueIndex] (const rxwindow::WindowSummary &w) {
+                                     ReportRxWindow (ueIndex, w);
+                                   });
+    }
+  if (!g_ueLatency.empty ())
+    {
+      RecordUeLatency (ueIndex, packet);
+    }
+}
+
+// Close the windows still open at the end of the simulation
+void
+FlushRxWindows (double time)
+{
+  for (uint32_t i = 0; i < g_ueRxWindows.size (); ++i)
+    {
+      g_ueRxWindows[i].Flush (time, [i] (const rxwindow::WindowSummary &w) {
+        ReportRxWindow (i, w);
+      });
+    }
+  g_ueRxWindows.clear ();
+  g_rxWindowFile.close ();
+}
+
+// Selected ns-3 traces, written to traces.bin. An empty traceSelection keeps the legacy
+// text traces (EnableTraces when enableTraces is true, plus the LTE PHY/MAC traces)
+std::string g_traceSelection = "";
+std::string g_traceCells = "";
+std::string g_traceUes = "";
+uint32_t g_traceDecimation = 1;
+
+struct TraceSelectionState
+{
+  std::vector<bool> cells; // by cell id, empty for all
+  std::vector<bool> ues;   // by UE index, empty for all
+  std::array<uint64_t, tracesink::N_RECORD_TYPES> seen{};
+  std::vector<uint16_t> ueCellIds; // cell of the last RRC reconfiguration of each UE
+  std::vector<bool> ueBearersConnected;
+  bool rlcDl = false;
+  bool pdcpDl = false;
+};
+
+TraceSelectionState g_traceState;
+tracesink::BinaryTraceSink g_traceSink;
+
+// Decimation: keep one record out of traceDecimation, per record type, and fewer when a
+// real-time run falls behind
+bool
+KeepTraceRecord (tracesink::RecordType type)
+{
+  return g_traceState.seen[type]++ % (g_traceDecimation * g_pacer.GetDegradeFactor ()) == 0;
+}
+
+void
+TracePhyRx (tracesink::RecordType type, uint32_t ue, RxPacketTraceParams params)
+{
+  if (!tracesink::IsSelected (g_traceState.cells, params.m_cellId) || !KeepTraceRecord (type))
+    {
+      return;
+    }
+  tracesink::TraceRecord r;
+  r.time = Simulator::Now ().GetSeconds ();
+  r.cellId = params.m_cellId;
+  r.ue = type == tracesink::PHY_DL ? ue : params.m_rnti;
+  r.type = type;
+  r.flags = params.m_corrupt ? 1 : 0;
+  r.lcid = params.m_mcs;
+  r.size = params.m_tbSize;
+  r.v0 = 10 * std::log10 (params.m_sinr);
+  r.v1 = params.m_tbler;
+  g_traceSink.Write (r);
+}
+
+void
+TraceUePhyDl (uint32_t ueIndex, RxPacketTraceParams params)
+{
+  TracePhyRx (tracesink::PHY_DL, ueIndex, params);
+}
+
+void
+TraceEnbPhyUl (RxPacketTraceParams params)
+{
+  TracePhyRx (tracesink::PHY_UL, 0, params);
+}
+
+void
+TraceLteMacDl (uint16_t cellId, DlSchedulingCallbackInfo info)
+{
+  if (!KeepTraceRecord (tracesink::MAC_LTE))
+    {
+      return;
+    }
+  tracesink::TraceRecord r;
+  r.time = Simulator::Now ().GetSeconds ();
+  r.cellId = cellId;
+  r.ue = info.rnti;
+  r.type = tracesink::MAC_LTE;
+  r.flags = 0;
+  r.lcid = info.mcsTb1;
+  r.size = info.sizeTb1 + info.sizeTb2;
+  r.v0 = info.frameNo;
+  r.v1 = info.subframeNo;
+  g_traceSink.Write (r);
+}
+
+void
+TraceUeBearerRx (tracesink::RecordType type, uint32_t ueIndex, uint16_t, uint8_t lcid,
+                 uint32_t bytes, uint64_t delayNs)
+{
+  uint16_t cellId = g_traceState.ueCellIds[ueIndex];
+  if (!tracesink::IsSelected (g_traceState.cells, cellId) || !KeepTraceRecord (type))
+    {
+      return;
+    }
+  tracesink::TraceRecord r;
+  r.time = Simulator::Now ().GetSeconds ();
+  r.cellId = cellId;
+  r.ue = ueIndex;
+  r.type = type;
+  r.flags = 0;
+  r.lcid = lcid;
+  r.size = bytes;
+  r.v0 = delayNs / 1e9;
+  r.v1 = 0;
+  g_traceSink.Write (r);
+}
+
+void
+TraceUeRlcRx (uint32_t ueIndex, uint16_t rnti, uint8_t lcid, uint32_t bytes, uint64_t delay)
+{
+  TraceUeBearerRx (tracesink::RLC_DL, ueIndex, rnti, lcid, bytes, delay);
+}
+
+void
+TraceUePdcpRx (uint32_t ueIndex, uint16_t rnti, uint8_t lcid, uint32_t bytes, uint64_t delay)
+{
+  TraceUeBearerRx (tracesink::PDCP_DL, ueIndex, rnti, lcid, bytes, delay);
+}
+
+// The data radio bearers only exist once the UE RRC is reconfigured, so their RLC/PDCP
+// traces are connected here, once per UE, like the LTE bearer stats connector does
+void
+TraceUeReconfiguration (uint32_t ueIndex, uint64_t, uint16_t cellId, uint16_t)
+{
+  g_traceState.ueCellIds[ueIndex] = cellId;
+  if (g_traceState.ueBearersConnected[ueIndex])
+    {
+      return;
+    }
+  g_traceState.ueBearersConnected[ueIndex] = true;
+  std::string drbPath = "/NodeList/" + std::to_string (g_ueNodeIds[ueIndex]) +
+                        "/DeviceList/*/LteUeRrc/DataRadioBearerMap/*/";
+  if (g_traceState.rlcDl)
+    {
+      Config::ConnectWithoutContextFailSafe (drbPath + "LteRlc/RxPDU",
+                                             MakeBoundCallback (&TraceUeRlcRx, ueIndex));
+    }
+  if (g_traceState.pdcpDl)
+    {
+      Config::ConnectWithoutContextFailSafe (drbPath + "LtePdcp/RxPDU",
+                                             MakeBoundCallback (&TraceUePdcpRx, ueIndex));
+    }
+}
+
+/**
+ * Connect the layers listed in traceSelection (phy-dl, phy-ul, mac-lte, rlc-dl, pdcp-dl)
+ * for the selected cells and UEs.
+ * \return true if the legacy text traces were requested too ("legacy")
+ */
+bool
+SetupSelectedTraces (const NetDeviceContainer &mmWaveEnbDevs, const NetDeviceContainer &lteEnbDevs)
+{
+  bool legacy = false;
+  bool phyDl = false;
+  bool phyUl = false;
+  bool macLte = false;
+  std::istringstream layers (g_traceSelection);
+  std::string layer;
+  while (std::getline (layers, layer, ','))
+    {
+      if (layer == "phy-dl")
+        {
+          phyDl = true;
+        }
+      else if (layer == "phy-ul")
+        {
+          phyUl = true;
+        }
+      else if (layer == "mac-lte")
+        {
+          macLte = true;
+        }
+      else if (layer == "rlc-dl")
+        {
+          g_traceState.rlcDl = true;
+        }
+      else if (layer == "pdcp-dl")
+        {
+          g_traceState.pdcpDl = true;
+        }
+      else if (layer == "legacy")
+        {
+          legacy = true;
+        }
+      else
+        {
+          NS_ABORT_MSG_IF (layer != "none" && !layer.empty (), "Unknown trace layer " << layer);
+        }
+    }
+  // Cell ids start at 1, LTE cells first; UE indices start at 0
+  uint32_t nCells = lteEnbDevs.GetN () + mmWaveEnbDevs.GetN ();
+  std::string error = tracesink::ParseIdList (g_traceCells, nCells, g_traceState.cells);
+  NS_ABORT_MSG_IF (!error.empty (), "Invalid traceCells " << g_traceCells << ": " << error);
+  error = tracesink::ParseIdList (g_traceUes, g_ueNodeIds.size () - 1, g_traceState.ues);
+  NS_ABORT_MSG_IF (!error.empty (), "Invalid traceUes " << g_traceUes << ": " << error);
+  NS_ABORT_MSG_IF (g_traceDecimation == 0, "traceDecimation must be at least 1");
+
+  if (!phyDl && !phyUl && !macLte && !g_traceState.rlcDl && !g_traceState.pdcpDl)
+    {
+      return legacy;
+    }
+  std::string filename = g_outputDir + "/traces.bin";
+  NS_ABORT_MSG_IF (!g_traceSink.Open (filename), "Can't open file " << filename);
+
+  // UE side traces, only on the selected UEs
+  g_traceState.ueCellIds.assign (g_ueNodeIds.size (), 0);
+  g_traceState.ueBearersConnected.assign (g_ueNodeIds.size (), false);
+  for (uint32_t u = 0; u < g_ueNodeIds.size (); ++u)
+    {
+      if (!tracesink::IsSelected (g_traceState.ues, u))
+        {
+          continue;
+        }
+      std::string devPath = "/NodeList/" + std::to_string (g_ueNodeIds[u]) + "/DeviceList/*/";
+      if (phyDl)
+        {
+          Config::ConnectWithoutContextFailSafe (
+              devPath + "MmWaveComponentCarrierMapUe/*/MmWaveUePhy/DlSpectrumPhy/RxPacketTraceUe",
+              MakeBoundCallback (&TraceUePhyDl, u));
+        }
+      if (g_traceState.rlcDl || g_traceState.pdcpDl)
+        {
+          Config::ConnectWithoutContextFailSafe (devPath + "LteUeRrc/ConnectionReconfiguration",
+                                                 MakeBoundCallback (&TraceUeReconfiguration, u));
+        }
+    }
+
+  // Cell side traces, only on the selected cells
+  for (uint32_t i = 0; phyUl && i < mmWaveEnbDevs.GetN (); ++i)
+    {
+      Ptr<MmWaveEnbNetDevice> enb = mmWaveEnbDevs.Get (i)->GetObject<MmWaveEnbNetDevice> ();
+      if (tracesink::IsSelected (g_traceState.cells, enb->GetCellId ()))
+        {
+          Config::ConnectWithoutContextFailSafe (
+              "/NodeList/" + std::to_string (enb->GetNode ()->GetId ()) +
+                  "/DeviceList/*/ComponentCarrierMap/*/MmWaveEnbPhy/DlSpectrumPhy/RxPacketTraceEnb",
+              MakeCallback (&TraceEnbPhyUl));
+        }
+    }
+  for (uint32_t i = 0; macLte && i < lteEnbDevs.GetN (); ++i)
+    {
+      Ptr<LteEnbNetDevice> enb = lteEnbDevs.Get (i)->GetObject<LteEnbNetDevice> ();
+      if (tracesink::IsSelected (g_traceState.cells, enb->GetCellId ()))
+        {
+          Config::ConnectWithoutContextFailSafe (
+              "/NodeList/" + std::to_string (enb->GetNode ()->GetId ()) +
+                  "/DeviceList/*/ComponentCarrierMap/*/LteEnbMac/DlScheduling",
+              MakeBoundCallback (&TraceLteMacDl, enb->GetCellId ()));
+        }
+    }
+  NS_LOG_UNCOND ("Writing the selected traces (" << g_traceSelection << ") to " << filename);
+  return legacy;
+}
+
+void
+KpmUePhyDl (uint32_t ueIndex, RxPacketTraceParams params)
+{
+  UeKpmState &ue = g_ueKpm[ueIndex];
+  ue.lastSinrDb = 10 * std::log10 (params.m_sinr);
+  ue.sinrSumDb += ue.lastSinrDb;
+  ++ue.sinrSamples;
+  ++ue.tbs;
+  ue.corruptedTbs += params.m_corrupt ? 1 : 0;
+  ue.tbBytes += params.m_tbSize;
+  ue.mcsSum += params.m_mcs;
+}
+
+void
+KpmUePdcpRx (uint32_t ueIndex, uint16_t, uint8_t, uint32_t bytes, uint64_t delayNs)
+{
+  UeKpmState &ue = g_ueKpm[ueIndex];
+  ++ue.pdcpPdus;
+  ue.pdcpBytes += bytes;
+  ue.pdcpDelayNsSum += delayNs;
+}
+
+// Same as TraceUeReconfiguration: the PDCP trace exists once the bearers are set up
+void
+KpmUeReconfiguration (uint32_t ueIndex, uint64_t, uint16_t cellId, uint16_t)
+{
+  UeKpmState &ue = g_ueKpm[ueIndex];
+  ue.cellId = cellId;
+  if (!ue.bearersConnected)
+    {
+      ue.bearersConnected = true;
+      Config::ConnectWithoutContextFailSafe ("/NodeList/" + std::to_string (g_ueNodeIds[ueIndex]) +
+                                                 "/DeviceList/*/LteUeRrc/DataRadioBearerMap/*/LtePdcp/RxPDU",
+                                             MakeBoundCallback (&KpmUePdcpRx, ueIndex));
+    }
+}
+
+// One CU-CP, CU-UP and DU record per UE every indication period, aggregated from the
+// PHY, PDCP and RRC traces the same way the E2 KPM containers are
+void
+PublishKpm (Time period)
+{
+  double time = Simulator::Now ().GetSeconds ();
+  double seconds = period.GetSeconds ();
+  std::map<uint16_t, uint32_t> uesPerCell;
+  for (const UeKpmState &ue : g_ueKpm)
+    {
+      ++uesPerCell[ue.cellId];
+    }
+  for (uint32_t u = 0; u < g_ueKpm.size (); ++u)
+    {
+      UeKpmState &ue = g_ueKpm[u];
+
+      kpmshm::KpmRecord cuCp = MakeKpmRecord (kpmshm::CU_CP, u, time);
+      cuCp.count = ue.sinrSamples;
+      cuCp.v[0] = ue.sinrSamples > 0 ? ue.sinrSumDb / ue.sinrSamples : ue.lastSinrDb;
+      cuCp.v[1] = ue.lastSinrDb;
+      cuCp.v[2] = uesPerCell[ue.cellId];
+      g_kpmRing.Publish (cuCp);
+
+      kpmshm::KpmRecord cuUp = MakeKpmRecord (kpmshm::CU_UP, u, time);
+      cuUp.count = ue.pdcpPdus;
+      cuUp.v[0] = ue.pdcpBytes;
+      cuUp.v[1] = ue.pdcpBytes * 8.0 / seconds / 1e6;
+      cuUp.v[2] = ue.pdcpPdus > 0 ? ue.pdcpDelayNsSum / 1e6 / ue.pdcpPdus : 0;
+      g_kpmRing.Publish (cuUp);
+
+      kpmshm::KpmRecord du = MakeKpmRecord (kpmshm::DU, u, time);
+      du.count = ue.tbs;
+      du.v[0] = ue.tbBytes;
+      du.v[1] = ue.corruptedTbs;
+      du.v[2] = ue.tbs > 0 ? double (ue.mcsSum) / ue.tbs : 0;
+      du.v[3] = ue.tbBytes * 8.0 / seconds / 1e6;
+      g_kpmRing.Publish (du);
+
+      ue.sinrSumDb = 0;
+      ue.sinrSamples = ue.tbs = ue.corruptedTbs = ue.pdcpPdus = 0;
+      ue.tbBytes = ue.mcsSum = ue.pdcpBytes = ue.pdcpDelayNsSum = 0;
+    }
+  Simulator::Schedule (period, &PublishKpm, period);
+}
+
+// Create the kpmShm ring and connect the traces its records are aggregated from
+void
+SetupKpmExport (const NetDeviceContainer &mcUeDevs, double indicationPeriodicity)
+{
+  NS_ABORT_MSG_IF (g_kpmShmCapacity == 0, "kpmShmCapacity must be at least 1");
+  NS_ABORT_MSG_IF (!g_kpmRing.Open (g_kpmShm, g_kpmShmCapacity),
+                   "Can't create " << kpmshm::ShmPath (g_kpmShm));
+  g_ueKpm.assign (g_ueNodeIds.size (), UeKpmState ());
+  for (uint32_t u = 0; u < g_ueNodeIds.size (); ++u)
+    {
+      g_ueKpm[u].imsi = DynamicCast<McUeNetDevice> (mcUeDevs.Get (u))->GetImsi ();
+      std::string devPath = "/NodeList/" + std::to_string (g_ueNodeIds[u]) + "/DeviceList/*/";
+      Config::ConnectWithoutContextFailSafe (
+          devPath + "MmWaveComponentCarrierMapUe/*/MmWaveUePhy/DlSpectrumPhy/RxPacketTraceUe",
+          MakeBoundCallback (&KpmUePhyDl, u));
+      Config::ConnectWithoutContextFailSafe (devPath + "LteUeRrc/ConnectionReconfiguration",
+                                             MakeBoundCallback (&KpmUeReconfiguration, u));
+    }
+  Simulator::Schedule (Seconds (indicationPeriodicity), &PublishKpm, Seconds (indicationPeriodicity));
+  NS_LOG_UNCOND ("Publishing KPM records to " << kpmshm::ShmPath (g_kpmShm) << " every "
+                                              << indicationPeriodicity << " s");
+}
+
+// Control commands received on controlSocket (see control-input.h), applied by the
+// simulator thread; handovers go through the LTE anchor RRC as the RIC control messages do
+std::string g_controlSocket = "";
+controlinput::Receiver g_controlReceiver;
+std::ofstream g_controlLatencyFile;
+latency::LogLinearHistogram g_controlApplyNs; // arrival to apply
+std::vector<Ptr<Application>> g_ueClients; // downlink client of each UE
+std::vector<Ptr<McUeNetDevice>> g_ueDevices;
+std::vector<Ptr<LteEnbNetDevice>> g_lteEnbs;
+std::map<uint64_t, uint32_t> g_imsiToUe;
+
+std::string
+ApplyHandover (const controlinput::Command &command)
+{
+  auto ue = g_imsiToUe.find (command.imsi);
+  if (ue == g_imsiToUe.end ())
+    {
+      return "unknown imsi";
+    }
+  Ptr<McUeNetDevice> dev = g_ueDevices[ue->second];
+  if (dev->GetMmWaveRrc ()->GetCellId () == command.targetCellId)
+    {
+      return "already served by the target cell";
+    }
+  Ptr<LteUeRrc> anchorRrc = dev->GetLteRrc ();
+  for (Ptr<LteEnbNetDevice> enb : g_lteEnbs)
+    {
+      if (enb->GetCellId () == anchorRrc->GetCellId ())
+        {
+          enb->GetRrc ()->TakeUeHoControl (command.imsi);
+          enb->GetRrc ()->PerformHandoverToTargetCell (anchorRrc->GetRnti (), command.targetCellId);
+          return "ok";
+        }
+    }
+  return "no LTE anchor";
+}
+
+std::string
+ApplySliceUpdate (const controlinput::Command &command)
+{
+  uint32_t updated = 0;
+  for (uint32_t u = 0; u < g_ueClients.size (); ++u)
+    {
+      if (g_sliceNames[g_ueSliceIds[u]] != command.slice)
+        {
+          continue;
+        }
+      // UdpClient and SliceUdpClient read both attributes at every packet
+      if (command.interval > 0)
+        {
+          g_ueClients[u]->SetAttribute ("Interval", TimeValue (Seconds (command.interval)));
+        }
+      if (command.packetSize > 0)
+        {
+          g_ueClients[u]->SetAttribute ("PacketSize", UintegerValue (command.packetSize));
         }
+      ++updated;
     }
-  
-  Simulator::Schedule (reportInterval, &CalculateThroughput, std::cref(ueNodes), reportInterval);
+  return updated > 0 ? "ok " + std::to_string (updated) + " UEs" : "unknown slice";
+}
+
+// Runs in the simulator thread, scheduled by the receiver thread
+void
+ApplyControlCommand (controlinput::Command command)
+{
+  std::string result =
+      command.type == controlinput::Command::HANDOVER ? ApplyHandover (command) : ApplySliceUpdate (command);
+  uint64_t appliedNs = controlinput::WallNs ();
+  uint64_t applyNs = appliedNs > command.arrivalNs ? appliedNs - command.arrivalNs : 0;
+  g_controlApplyNs.Record (applyNs);
+  g_controlLatencyFile << command.seq << "\t"
+                       << (command.type == controlinput::Command::HANDOVER
+                               ? "ho " + std::to_string (command.imsi) + " " +
+                                     std::to_string (command.targetCellId)
+                               : "slice " + command.slice)
+                       << "\t" << Simulator::Now ().GetSeconds () << "\t"
+                       << (command.sentNs > 0 && command.arrivalNs > command.sentNs
+                               ? (command.arrivalNs - command.sentNs) / 1e3
+                               : 0)
+                       << "\t" << applyNs / 1e3 << "\t" << result << "\n";
 }
 
+// Bind controlSocket and forward every command to the simulator thread
+void
+SetupControlInput (const NetDeviceContainer &mcUeDevs, const NetDeviceContainer &lteEnbDevs)
+{
+  for (uint32_t u = 0; u < mcUeDevs.GetN (); ++u)
+    {
+      g_ueDevices.push_back (DynamicCast<McUeNetDevice> (mcUeDevs.Get (u)));
+      g_imsiToUe[g_ueDevices.back ()->GetImsi ()] = u;
+    }
+  for (uint32_t i = 0; i < lteEnbDevs.GetN (); ++i)
+    {
+      g_lteEnbs.push_back (DynamicCast<LteEnbNetDevice> (lteEnbDevs.Get (i)));
+    }
+  std::string filename = g_outputDir + "/control_latency.txt";
+  g_controlLatencyFile.open (filename.c_str (), std::ios_base::out | std::ios_base::trunc);
+  NS_ABORT_MSG_IF (!g_controlLatencyFile.is_open (), "Can't open file " << filename);
+  g_controlLatencyFile << "Seq\tCommand\tTime (s)\tSentToArrival (us)\tArrivalToApply (us)\tResult\n";
+
+  bool started = g_controlReceiver.Start (
+      g_controlSocket,
+      [] (const controlinput::Command &command) {
+        // Thread-safe: the event is inserted before the next one is processed
+        Simulator::ScheduleWithContext (Simulator::NO_CONTEXT, Seconds (0), &ApplyControlCommand,
+                                        command);
+      },
+      [] (const std::string &line, const std::string &error) {
+        // Not NS_LOG: its prefixes read the simulator state
+        std::cerr << "Rejected control command \"" << line << "\": " << error << std::endl;
+      });
+  NS_ABORT_MSG_IF (!started, "Can't bind the control socket " << g_controlSocket);
+  NS_LOG_UNCOND ("Waiting for control commands on " << g_controlSocket);
+}
 
 void
-PrintGnuplottableUeListToFile (std::string filename)
+StopControlInput ()
+{
+  if (!g_controlReceiver.IsRunning ())
+    {
+      return;
+    }
+  g_controlReceiver.Stop ();
+  g_controlLatencyFile.close ();
+  NS_LOG_UNCOND ("Control commands: " << g_controlReceiver.GetReceived () << " received, "
+                                      << g_controlReceiver.GetRejected () << " rejected, "
+                                      << g_controlApplyNs.GetCount () << " applied, arrival to apply p50 "
+                                      << g_controlApplyNs.GetQuantile (0.5) / 1e3 << " us, p99 "
+                                      << g_controlApplyNs.GetQuantile (0.99) / 1e3 << " us");
+}
+
+void
+PrintGnuplottableUeListToFile (std::string filename, const NodeContainer &ueNodes)
 {
   std::ofstream outFile;
   outFile.open (filename.c_str (), std::ios_base::out | std::ios_base::trunc);
@@ -110,31 +958,15 @@ PrintGnuplottableUeListToFile (std::string filename)
       NS_LOG_ERROR ("Can't open file " << filename);
       return;
     }
-  for (NodeList::Iterator it = NodeList::Begin (); it != NodeList::End (); ++it)
+  // Only print UEs that are part of our defined slice groups
+  for (uint32_t i = 0; i < ueNodes.GetN () && i < g_ueSliceNames.size (); ++i)
     {
-      Ptr<Node> node = *it;
-      int nDevs = node->GetNDevices ();
-      for (int j = 0; j < nDevs; j++)
-        {
-          Ptr<LteUeNetDevice> uedev = node->GetDevice (j)->GetObject<LteUeNetDevice> ();
-          Ptr<MmWaveUeNetDevice> mmuedev = node->GetDevice (j)->GetObject<MmWaveUeNetDevice> ();
-          Ptr<McUeNetDevice> mcuedev = node->GetDevice (j)->GetObject<McUeNetDevice> ();
-          // Only print UEs that are part of our defined slice groups
-          if (uedev || mmuedev || mcuedev)
-            {
-              // Check if this UE is one of our simulated UEs by looking it up in the map
-              auto it_map = g_ueIdToSliceName.find(node->GetId());
-              if (it_map != g_ueIdToSliceName.end())
-              {
-                  Vector pos = node->GetObject<MobilityModel> ()->GetPosition ();
-                  // Use the user-friendly slice name for the label
-                  outFile << "set label \"" << it_map->second << "\" at " << pos.x << "," << pos.y
-                          << " left font \"Helvetica,8\" textcolor rgb \"black\" front point pt 1 ps "
-                             "0.3 lc rgb \"black\" offset 0,0"
-                          << std::endl;
-              }
-            }
-        }
+      Vector pos = ueNodes.Get (i)->GetObject<MobilityModel> ()->GetPosition ();
+      // Use the user-friendly slice name for the label
+      outFile << "set label \"" << g_ueSliceNames[i] << "\" at " << pos.x << "," << pos.y
+              << " left font \"Helvetica,8\" textcolor rgb \"black\" front point pt 1 ps "
+                 "0.3 lc rgb \"black\" offset 0,0"
+              << std::endl;
     }
 }
 
@@ -219,6 +1051,27 @@ static ns3::GlobalValue
                              "E2 Indication Periodicity reports (value in seconds)",
                              ns3::DoubleValue (0.01), ns3::MakeDoubleChecker<double> (0.01, 2.0));
 
+static ns3::GlobalValue g_nMmWaveEnbNodes ("nMmWaveEnbNodes", "Number of mmWave gNBs",
+                                            ns3::UintegerValue (3), ns3::MakeUintegerChecker<uint32_t> (1));
+
+static ns3::GlobalValue g_nLteEnbNodes ("nLteEnbNodes", "Number of LTE eNBs (anchors)",
+                                         ns3::UintegerValue (1), ns3::MakeUintegerChecker<uint32_t> (1));
+
+static ns3::GlobalValue
+    g_layout ("layout",
+              "Placement of the mmWave gNBs, can be only \"ring\" (one ring of radius isd around "
+              "the center) or \"hex\" (hexagonal grid with inter-site distance isd, ring by ring)",
+              ns3::StringValue ("ring"), ns3::MakeStringChecker ());
+
+static ns3::GlobalValue
+    g_attachNeighbourCells ("attachNeighbourCells",
+                            "Number of closest mmWave gNBs each UE is attached to and measures "
+                            "(0 for all of them)",
+                            ns3::UintegerValue (19), ns3::MakeUintegerChecker<uint32_t> ());
+
+static ns3::GlobalValue g_ues ("ues", "Number of UEs per mmWave cell", ns3::UintegerValue (12),
+                               ns3::MakeUintegerChecker<uint32_t> (1));
+
 static ns3::GlobalValue g_simTime ("simTime", "Simulation time in seconds", ns3::DoubleValue (2),
                                     ns3::MakeDoubleChecker<double> (0.1, 100.0));
 
@@ -275,8 +1128,117 @@ main (int argc, char *argv[])
   CommandLine cmd;
   cmd.AddValue ("outputDir", "Output directory for traces and reports", g_outputDir);
   cmd.AddValue ("reportingInterval", "Interval for data rate reporting (seconds)", g_reportingInterval);
+  cmd.AddValue ("dataRateFormat",
+                "Data rate report format: \"text\" (one file per UE) or \"columnar\" "
+                "(a single block-buffered datarate.col, see datarate-columnar-reader)",
+                g_dataRateFormat);
+  cmd.AddValue ("throughputSampling",
+                "\"poll\": poll every UE sink each reportingInterval, \"rx-trace\": derive "
+                "windowed rate and inter-arrival statistics from the sink Rx trace",
+                g_throughputSampling);
+  cmd.AddValue ("enableLatencyKpi",
+                "If true, report per-slice one-way delay percentiles and loss every "
+                "reportingInterval in slice_latency.txt",
+                g_enableLatencyKpi);
+  cmd.AddValue ("latencyReorderGrace",
+                "Seconds a reporting interval waits for reordered packets before its losses are "
+                "counted (the loss of an interval appears in the first report after the grace)",
+                g_latencyReorderGrace);
+  cmd.AddValue ("sliceProfileFile",
+                "File with one slice traffic profile per line, e.g. \"urllc share=1 size=45 "
+                "pattern=constant interval=0.0004\" (default: URLLC, eMBB and mMTC)",
+                g_sliceProfileFile);
+  cmd.AddValue ("sliceProfiles", "Slice traffic profiles separated by ';', same syntax as sliceProfileFile",
+                g_sliceProfiles);
+  cmd.AddValue ("trafficGenerator",
+                "\"per-ue\": one UDP client application per UE, \"aggregated\": one client per slice "
+                "driving all its UEs from a single timer (see slice-group-client.h)",
+                g_trafficGenerator);
+  cmd.AddValue ("profileInterval",
+                "If > 0, sample the wall time, scheduler events, memory and event counters every "
+                "profileInterval simulated seconds and write them to profile.txt",
+                g_profileInterval);
+  cmd.AddValue ("traceSelection",
+                "Comma-separated ns-3 trace layers written to traces.bin: phy-dl, phy-ul, mac-lte, "
+                "rlc-dl, pdcp-dl; \"legacy\" adds the text traces, \"none\" disables all. Empty "
+                "(default) keeps the text traces only",
+                g_traceSelection);
+  cmd.AddValue ("traceCells", "Cell ids traced by traceSelection, e.g. \"2,4-6\" (default: all)",
+                g_traceCells);
+  cmd.AddValue ("traceUes", "UE indices traced by traceSelection, e.g. \"0-9\" (default: all)",
+                g_traceUes);
+  cmd.AddValue ("traceDecimation", "Keep one trace record out of traceDecimation, per layer",
+                g_traceDecimation);
+  cmd.AddValue ("kpmShm",
+                "If not empty, publish per-UE CU-CP/CU-UP/DU KPM records and the throughput "
+                "reports to this shared-memory ring every indicationPeriodicity (see kpm-shm-reader)",
+                g_kpmShm);
+  cmd.AddValue ("kpmShmCapacity", "Records kept in the kpmShm ring before the oldest are overwritten",
+                g_kpmShmCapacity);
+  cmd.AddValue ("controlSocket",
+                "If not empty, receive handover and slice commands on this Unix datagram socket "
+                "and apply them as soon as they arrive (see control-input.h); latencies are "
+                "written to control_latency.txt",
+                g_controlSocket);
+  cmd.AddValue ("logMode",
+                "Per-UE log messages: \"ns-log\" (NS_LOG_UNCOND), \"async\" (text lines from a "
+                "background thread), \"binary\" (records in scenario_log.bin) or \"off\"",
+                g_logMode);
+  cmd.AddValue ("logFile", "Output of logMode=async (default: stderr, like NS_LOG_UNCOND)", g_logFile);
+  cmd.AddValue ("logSampling",
+                "Keep one log record out of N per category, e.g. \"throughput=10\" (async and binary)",
+                g_logSampling);
+  cmd.AddValue ("logRateLimit",
+                "At most N log records per simulated second per category, e.g. \"throughput=1000\" "
+                "(async and binary)",
+                g_logRateLimit);
+  cmd.AddValue ("realtimeSpeed",
+                "If > 0, pace the run against the wall clock at this many simulated seconds per "
+                "wall second (1 = real time) and write the lag to realtime.txt",
+                g_realtimeSpeed);
+  cmd.AddValue ("realtimeTick", "Simulated time between two real-time pacing points [s]",
+                g_realtimeTick);
+  cmd.AddValue ("realtimeLagThreshold",
+                "Lag behind the wall clock [s] beyond which the throughput reports and the binary "
+                "traces are decimated, until the run catches up",
+                g_realtimeLagThreshold);
+  cmd.AddValue ("pathlossMap",
+                "Read the UMi pathloss and shadowing from a map precomputed per site: "
+                "\"memory\" builds it in each run, a file name keeps it across runs. Empty "
+                "(default) uses the exact model",
+                g_pathlossMap);
+  cmd.AddValue ("pathlossMapResolution", "Grid step of the pathloss map [m]",
+                g_pathlossMapResolution);
+  cmd.AddValue ("pathlossMapTolerance",
+                "Largest difference [dB] allowed between the pathloss map and the exact model "
+                "at the initial UE positions",
+                g_pathlossMapTolerance);
+  cmd.AddValue ("mobilityTrace",
+                "Trajectory file replayed by the UEs (UE i follows trajectory i) instead of the "
+                "random walk",
+                g_mobilityTrace);
+  cmd.AddValue ("mobilityRecord", "Write the UE trajectories of the run to this trajectory file",
+                g_mobilityRecord);
+  cmd.AddValue ("mobilityRecordPeriod", "Sample period of mobilityRecord [s]",
+                g_mobilityRecordPeriod);
+  cmd.AddValue ("numIsolatedClusters",
+                "Approximation: split the LTE anchors into this many angular sectors and simulate "
+                "one of them, with its mmWave cells and UEs, without the rest of the topology (no "
+                "interference, X2 or handover across sectors). 1: the whole topology",
+                g_numIsolatedClusters);
+  cmd.AddValue ("isolatedClusterIndex",
+                "Isolated cluster simulated by this process, in [0, numIsolatedClusters)",
+                g_isolatedClusterIndex);
   cmd.Parse (argc, argv);
 
+  NS_ABORT_MSG_IF (g_dataRateFormat != "text" && g_dataRateFormat != "columnar",
+                   "Unknown dataRateFormat " << g_dataRateFormat);
+  NS_ABORT_MSG_IF (g_latencyReorderGrace < 0, "latencyReorderGrace must be >= 0");
+  NS_ABORT_MSG_IF (!g_mobilityRecord.empty () && g_mobilityRecordPeriod <= 0,
+                   "mobilityRecordPeriod must be > 0");
+  NS_ABORT_MSG_IF (g_numIsolatedClusters == 0 || g_isolatedClusterIndex >= g_numIsolatedClusters,
+                   "isolatedClusterIndex must be in [0, numIsolatedClusters)");
+
   bool harqEnabled = true;
 
   UintegerValue uintegerValue;
@@ -417,6 +1379,8 @@ main (int argc, char *argv[])
   Config::SetDefault ("ns3::MmWavePhyMacCommon::CenterFreq", DoubleValue (centerFrequency));
 
   Ptr<MmWaveHelper> mmwaveHelper = CreateObject<MmWaveHelper> ();
+  // The helper derives the channel scenario from this type name: with --pathlossMap the model
+  // is replaced on the channels once the devices are installed (UseCachedUmiPathloss)
   mmwaveHelper->SetPathlossModelType ("ns3::ThreeGppUmiStreetCanyonPropagationLossModel");
   mmwaveHelper->SetChannelConditionModelType ("ns3::ThreeGppUmiStreetCanyonChannelConditionModel");
 
@@ -429,9 +1393,16 @@ main (int argc, char *argv[])
   Ptr<MmWavePointToPointEpcHelper> epcHelper = CreateObject<MmWavePointToPointEpcHelper> ();
   mmwaveHelper->SetEpcHelper (epcHelper);
 
-  uint8_t nMmWaveEnbNodes = 3;
-  uint8_t nLteEnbNodes = 1;
-  uint32_t ues = 12; // UEs per mmWave ENB node (original logic implies 3 UEs per mmWave ENB)
+  GlobalValue::GetValueByName ("nMmWaveEnbNodes", uintegerValue);
+  uint32_t nMmWaveEnbNodes = uintegerValue.Get ();
+  GlobalValue::GetValueByName ("nLteEnbNodes", uintegerValue);
+  uint32_t nLteEnbNodes = uintegerValue.Get ();
+  GlobalValue::GetValueByName ("attachNeighbourCells", uintegerValue);
+  uint32_t attachNeighbourCells = uintegerValue.Get ();
+  GlobalValue::GetValueByName ("layout", stringValue);
+  std::string layout = stringValue.Get ();
+  GlobalValue::GetValueByName ("ues", uintegerValue);
+  uint32_t ues = uintegerValue.Get (); // UEs per mmWave ENB node
   uint32_t nUeNodes = ues * nMmWaveEnbNodes; // Total UEs
 
   NS_LOG_INFO (" Bandwidth " << bandwidth << " centerFrequency " << double (centerFrequency)
@@ -463,6 +1434,151 @@ main (int argc, char *argv[])
       ipv4RoutingHelper.GetStaticRouting (remoteHost->GetObject<Ipv4> ());
   remoteHostStaticRouting->AddNetworkRouteTo (Ipv4Address ("7.0.0.0"), Ipv4Mask ("255.0.0.0"), 1);
 
+  // Position
+  // The first mmWave BS is in the center. With the "ring" layout the others are placed at the
+  // same distance isd from it; with "hex" they fill the rings of a hexagonal grid.
+  std::vector<topology::Point2d> mmWavePositions;
+  if (layout == "ring")
+    {
+      mmWavePositions = topology::RingPositions (nMmWaveEnbNodes, isd);
+    }
+  else
+    {
+      NS_ABORT_MSG_IF (layout != "hex", "Unknown layout " << layout);
+      mmWavePositions = topology::HexPositions (nMmWaveEnbNodes, isd);
+    }
+  // One LTE anchor is co-located with the central mmWave BS; more anchors are spread on a
+  // coarser hexagonal grid, so that each covers about the same number of mmWave BSs
+  std::vector<topology::Point2d> ltePositions =
+      topology::HexPositions (nLteEnbNodes, isd * std::sqrt (double (nMmWaveEnbNodes) / nLteEnbNodes));
+
+  // The UEs are dropped in a disc covering the mmWave BSs, the area leaves one isd of margin
+  double ueDiscRadius = layout == "hex" ? topology::Extent (mmWavePositions) + isd / 2 : isd;
+  maxXAxis = std::max (maxXAxis, 2 * (ueDiscRadius + isd));
+  maxYAxis = std::max (maxYAxis, 2 * (ueDiscRadius + isd));
+  Vector centerPosition = Vector (maxXAxis / 2, maxYAxis / 2, 3);
+
+  MobilityHelper enbmobility;
+  MobilityHelper uemobility;
+
+  Ptr<UniformDiscPositionAllocator> uePositionAlloc = CreateObject<UniformDiscPositionAllocator> ();
+
+  uePositionAlloc->SetX (centerPosition.x);
+  uePositionAlloc->SetY (centerPosition.y);
+  uePositionAlloc->SetRho (ueDiscRadius);
+  NS_ABORT_MSG_IF (uePositionAlloc->AssignStreams (kUePositionStreams) >
+                       kSliceTrafficStreams - kUePositionStreams,
+                   "The UE position allocator uses more random streams than its block");
+  if (!g_pathlossMap.empty ())
+    {
+      // Read when the pathloss map replaces the helper's model, after the devices are installed
+      Config::SetDefault ("ns3::CachedUmiPropagationLossModel::Bounds",
+                          RectangleValue (Rectangle (0, maxXAxis, 0, maxYAxis)));
+      Config::SetDefault ("ns3::CachedUmiPropagationLossModel::Resolution",
+                          DoubleValue (g_pathlossMapResolution));
+      Config::SetDefault ("ns3::CachedUmiPropagationLossModel::MapFile",
+                          StringValue (g_pathlossMap == "memory" ? "" : g_pathlossMap));
+      DoubleValue ueHeight;
+      uePositionAlloc->GetAttribute ("Z", ueHeight);
+      Config::SetDefault ("ns3::CachedUmiPropagationLossModel::UeHeight", ueHeight);
+    }
+
+  // A replayed trajectory file must hold every UE of the full topology, whatever the cluster
+  trajectory::TrajectoryFile trajectories;
+  if (!g_mobilityTrace.empty ())
+    {
+      std::string error = trajectories.Open (g_mobilityTrace);
+      NS_ABORT_MSG_IF (!error.empty (),
+                       "Invalid trajectory file " << g_mobilityTrace << ": " << error);
+      NS_ABORT_MSG_IF (trajectories.GetNUes () < nUeNodes,
+                       "Trajectory file " << g_mobilityTrace << " has " << trajectories.GetNUes ()
+                                          << " UEs, not " << nUeNodes);
+    }
+
+  // Indices in the full topology of the anchors, mmWave cells and UEs of this process
+  uint32_t nLteEnbNodesTotal = nLteEnbNodes;
+  uint32_t nMmWaveEnbNodesTotal = nMmWaveEnbNodes;
+  uint32_t nUeNodesTotal = nUeNodes;
+  std::vector<uint32_t> lteGlobalIndex;
+  std::vector<uint32_t> mmWaveGlobalIndex;
+  std::vector<uint32_t> ueGlobalIndex;
+  Ptr<ListPositionAllocator> clusterPositionAlloc;
+  if (g_numIsolatedClusters > 1)
+    {
+      // A cluster is a sector of LTE anchors, with the mmWave cells and the UEs whose closest
+      // anchor is in it. Every UE position of the full run is drawn, in the same order, so the
+      // UEs of the cluster start where they start in the full run
+      NS_ABORT_MSG_IF (g_numIsolatedClusters > nLteEnbNodes,
+                       "numIsolatedClusters must not exceed nLteEnbNodes");
+      std::vector<uint32_t> lteClusters =
+          topology::SectorClusters (ltePositions, g_numIsolatedClusters);
+      topology::GridIndex anchorIndex (ltePositions, isd);
+      auto inCluster = [&] (double x, double y) {
+        return lteClusters[anchorIndex.Nearest (x, y)] == g_isolatedClusterIndex;
+      };
+      std::vector<topology::Point2d> clusterLtePositions;
+      std::vector<topology::Point2d> clusterMmWavePositions;
+      for (uint32_t i = 0; i < ltePositions.size (); ++i)
+        {
+          if (lteClusters[i] == g_isolatedClusterIndex)
+            {
+              lteGlobalIndex.push_back (i);
+              clusterLtePositions.push_back (ltePositions[i]);
+            }
+        }
+      for (uint32_t i = 0; i < mmWavePositions.size (); ++i)
+        {
+          if (inCluster (mmWavePositions[i].x, mmWavePositions[i].y))
+            {
+              mmWaveGlobalIndex.push_back (i);
+              clusterMmWavePositions.push_back (mmWavePositions[i]);
+            }
+        }
+      clusterPositionAlloc = CreateObject<ListPositionAllocator> ();
+      for (uint32_t u = 0; u < nUeNodes; ++u)
+        {
+          Vector pos = uePositionAlloc->GetNext ();
+          if (!g_mobilityTrace.empty ())
+            {
+              double position[3], velocity[3];
+              trajectories.Get (u, 0, position, velocity);
+              pos = Vector (position[0], position[1], position[2]);
+            }
+          if (inCluster (pos.x - centerPosition.x, pos.y - centerPosition.y))
+            {
+              ueGlobalIndex.push_back (u);
+              clusterPositionAlloc->Add (pos);
+            }
+        }
+      NS_ABORT_MSG_IF (mmWaveGlobalIndex.empty () || ueGlobalIndex.empty (),
+                       "Isolated cluster " << g_isolatedClusterIndex
+                                           << " has no mmWave cell or no UE, use fewer clusters");
+      ltePositions = clusterLtePositions;
+      mmWavePositions = clusterMmWavePositions;
+      nLteEnbNodes = ltePositions.size ();
+      nMmWaveEnbNodes = mmWavePositions.size ();
+      nUeNodes = ueGlobalIndex.size ();
+      NS_LOG_UNCOND ("Isolated cluster " << g_isolatedClusterIndex << " of "
+                                         << g_numIsolatedClusters << ": " << nLteEnbNodes
+                                         << " LTE anchors, " << nMmWaveEnbNodes << " mmWave cells, "
+                                         << nUeNodes << " of " << nUeNodesTotal << " UEs");
+    }
+  else
+    {
+      for (uint32_t i = 0; i < nLteEnbNodes; ++i)
+        {
+          lteGlobalIndex.push_back (i);
+        }
+      for (uint32_t i = 0; i < nMmWaveEnbNodes; ++i)
+        {
+          mmWaveGlobalIndex.push_back (i);
+        }
+      for (uint32_t u = 0; u < nUeNodes; ++u)
+        {
+          ueGlobalIndex.push_back (u);
+        }
+    }
+
   // create LTE, mmWave eNB nodes and UE node
   NodeContainer ueNodes;
   NodeContainer mmWaveEnbNodes;
@@ -474,39 +1590,21 @@ main (int argc, char *argv[])
   allEnbNodes.Add (lteEnbNodes);
   allEnbNodes.Add (mmWaveEnbNodes);
 
-  // Position
-  Vector centerPosition = Vector (maxXAxis / 2, maxYAxis / 2, 3);
-
   // Install Mobility Model
   Ptr<ListPositionAllocator> enbPositionAlloc = CreateObject<ListPositionAllocator> ();
-
-  // We want a center with one LTE enb and one mmWave co-located in the same place
-  enbPositionAlloc->Add (centerPosition);
-  enbPositionAlloc->Add (centerPosition);
-
-  double x, y;
-  double nConstellation = nMmWaveEnbNodes - 1;
-
-  // This guarantee that each of the rest BSs is placed at the same distance from the two co-located in the center
-  for (int8_t i = 0; i < nConstellation; ++i)
+  for (const topology::Point2d &p : ltePositions)
     {
-      x = isd * cos ((2 * M_PI * i) / (nConstellation));
-      y = isd * sin ((2 * M_PI * i) / (nConstellation));
-      enbPositionAlloc->Add (Vector (centerPosition.x + x, centerPosition.y + y, 3));
+      enbPositionAlloc->Add (Vector (centerPosition.x + p.x, centerPosition.y + p.y, 3));
+    }
+  for (const topology::Point2d &p : mmWavePositions)
+    {
+      enbPositionAlloc->Add (Vector (centerPosition.x + p.x, centerPosition.y + p.y, 3));
     }
 
-  MobilityHelper enbmobility;
   enbmobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
   enbmobility.SetPositionAllocator (enbPositionAlloc);
   enbmobility.Install (allEnbNodes);
 
-  MobilityHelper uemobility;
-
-  Ptr<UniformDiscPositionAllocator> uePositionAlloc = CreateObject<UniformDiscPositionAllocator> ();
-
-  uePositionAlloc->SetX (centerPosition.x);
-  uePositionAlloc->SetY (centerPosition.y);
-  uePositionAlloc->SetRho (isd);
   Ptr<UniformRandomVariable> speed = CreateObject<UniformRandomVariable> ();
   speed->SetAttribute ("Min", DoubleValue (35));
   speed->SetAttribute ("Max", DoubleValue (35));
@@ -514,13 +1612,84 @@ main (int argc, char *argv[])
   uemobility.SetMobilityModel ("ns3::RandomWalk2dOutdoorMobilityModel", "Speed",
                                PointerValue (speed), "Bounds",
                                RectangleValue (Rectangle (0, maxXAxis, 0, maxYAxis)));
-  uemobility.SetPositionAllocator (uePositionAlloc);
-  uemobility.Install (ueNodes);
+  if (clusterPositionAlloc)
+    {
+      uemobility.SetPositionAllocator (clusterPositionAlloc);
+    }
+  else
+    {
+      uemobility.SetPositionAllocator (uePositionAlloc);
+    }
+  if (!g_mobilityTrace.empty ())
+    {
+      // Positions interpolated from the mapped file when asked for, no mobility events
+      for (uint32_t u = 0; u < ueNodes.GetN (); ++u)
+        {
+          Ptr<TraceReplayMobilityModel> replay = CreateObject<TraceReplayMobilityModel> ();
+          replay->SetAttribute ("File", StringValue (g_mobilityTrace));
+          replay->SetAttribute ("Index", UintegerValue (ueGlobalIndex[u]));
+          ueNodes.Get (u)->AggregateObject (replay);
+        }
+    }
+  else
+    {
+      uemobility.Install (ueNodes);
+    }
 
   // Install mmWave, lte, mc Devices to the nodes
   NetDeviceContainer lteEnbDevs = mmwaveHelper->InstallLteEnbDevice (lteEnbNodes);
   NetDeviceContainer mmWaveEnbDevs = mmwaveHelper->InstallEnbDevice (mmWaveEnbNodes);
   NetDeviceContainer mcUeDevs = mmwaveHelper->InstallMcUeDevice (ueNodes);
+  std::vector<CachedUmiSwap> cachedUmiSwaps;
+  if (!g_pathlossMap.empty ())
+    {
+      cachedUmiSwaps = UseCachedUmiPathloss ();
+      NS_ABORT_MSG_IF (cachedUmiSwaps.empty (),
+                       "No UMi pathloss model on the channels to replace with the pathloss map");
+    }
+
+  // Random streams of the devices and mobility models, by node index in the full topology
+  auto nodeStreams = [&] (uint32_t globalNode) {
+    return kNodeStreams + kStreamsPerNode * int64_t (globalNode);
+  };
+  auto ueStreams = [&] (uint32_t u) {
+    return nodeStreams (nLteEnbNodesTotal + nMmWaveEnbNodesTotal + ueGlobalIndex[u]);
+  };
+  auto assignNodeStreams = [&] (Ptr<NetDevice> device, MobilityHelper &mobility, int64_t first) {
+    int64_t used =
+        mmwaveHelper->AssignStreams (NetDeviceContainer (device), first + kDeviceStreams);
+    NS_ABORT_MSG_IF (used > kMobilityStreams - kDeviceStreams,
+                     "A device uses " << used << " random streams, more than its block");
+    used = mobility.AssignStreams (NodeContainer (device->GetNode ()), first + kMobilityStreams);
+    NS_ABORT_MSG_IF (used > kUeTrafficStreams - kMobilityStreams,
+                     "A mobility model uses " << used << " random streams, more than its block");
+  };
+  for (uint32_t i = 0; i < lteEnbDevs.GetN (); ++i)
+    {
+      assignNodeStreams (lteEnbDevs.Get (i), enbmobility, nodeStreams (lteGlobalIndex[i]));
+    }
+  for (uint32_t i = 0; i < mmWaveEnbDevs.GetN (); ++i)
+    {
+      assignNodeStreams (mmWaveEnbDevs.Get (i), enbmobility,
+                         nodeStreams (nLteEnbNodesTotal + mmWaveGlobalIndex[i]));
+    }
+  for (uint32_t u = 0; u < mcUeDevs.GetN (); ++u)
+    {
+      assignNodeStreams (mcUeDevs.Get (u), uemobility, ueStreams (u));
+    }
+
+  // The map against the exact model at the initial UE positions. The LOS states it draws are
+  // the ones the channels would draw at their first use of the links
+  if (!cachedUmiSwaps.empty ())
+    {
+      double maxErrorDb;
+      uint32_t pairs;
+      std::string error = CheckCachedUmiPathloss (cachedUmiSwaps, allEnbNodes, ueNodes,
+                                                  g_pathlossMapTolerance, maxErrorDb, pairs);
+      NS_ABORT_MSG_IF (!error.empty (), "Pathloss map check: " << error);
+      NS_LOG_UNCOND ("Pathloss map: " << pairs << " site-UE pairs within " << maxErrorDb
+                                      << " dB of the exact model");
+    }
 
   // Install the IP stack on the UEs
   internet.Install (ueNodes);
@@ -540,7 +1709,61 @@ main (int argc, char *argv[])
   mmwaveHelper->AddX2Interface (lteEnbNodes, mmWaveEnbNodes);
 
   // Manual attachment
-  mmwaveHelper->AttachToClosestEnb (mcUeDevs, mmWaveEnbDevs, lteEnbDevs);
+  // Each UE is attached to its closest LTE eNB and given its attachNeighbourCells closest mmWave
+  // BSs, found with a grid index instead of comparing every UE with every cell
+  topology::GridIndex mmWaveIndex (mmWavePositions, isd);
+  topology::GridIndex lteIndex (ltePositions, isd);
+  bool allMmWaveCells = attachNeighbourCells == 0 || attachNeighbourCells >= nMmWaveEnbNodes;
+  for (uint32_t u = 0; u < ueNodes.GetN (); ++u)
+    {
+      Vector pos = ueNodes.Get (u)->GetObject<MobilityModel> ()->GetPosition ();
+      double x = pos.x - centerPosition.x;
+      double y = pos.y - centerPosition.y;
+
+      NetDeviceContainer candidateMmWaveDevs;
+      if (allMmWaveCells)
+        {
+          candidateMmWaveDevs = mmWaveEnbDevs;
+        }
+      else
+        {
+          for (uint32_t i : mmWaveIndex.KNearest (x, y, attachNeighbourCells))
+            {
+              candidateMmWaveDevs.Add (mmWaveEnbDevs.Get (i));
+            }
+        }
+      NetDeviceContainer closestLteDev (lteEnbDevs.Get (lteIndex.Nearest (x, y)));
+      mmwaveHelper->AttachToClosestEnb (NetDeviceContainer (mcUeDevs.Get (u)), candidateMmWaveDevs,
+                                        closestLteDev);
+    }
+  if (g_numIsolatedClusters > 1)
+    {
+      // Cell ids are given in install order, LTE anchors first, and IMSIs in UE order: in the
+      // full run anchor i is cell i + 1, mmWave cell i is cell nLteEnbNodes + i + 1 and UE u
+      // has IMSI u + 1
+      std::string filename = g_outputDir + "/cluster_map.txt";
+      std::ofstream mapFile (filename.c_str (), std::ios_base::out | std::ios_base::trunc);
+      NS_ABORT_MSG_IF (!mapFile.is_open (), "Can't open file " << filename);
+      mapFile << "# isolated cluster " << g_isolatedClusterIndex << " of " << g_numIsolatedClusters
+              << "\n";
+      mapFile << "kind\tlocal\tglobal\n";
+      for (uint32_t i = 0; i < lteEnbDevs.GetN (); ++i)
+        {
+          Ptr<LteEnbNetDevice> enb = lteEnbDevs.Get (i)->GetObject<LteEnbNetDevice> ();
+          mapFile << "cell\t" << enb->GetCellId () << "\t" << lteGlobalIndex[i] + 1 << "\n";
+        }
+      for (uint32_t i = 0; i < mmWaveEnbDevs.GetN (); ++i)
+        {
+          Ptr<MmWaveEnbNetDevice> enb = mmWaveEnbDevs.Get (i)->GetObject<MmWaveEnbNetDevice> ();
+          mapFile << "cell\t" << enb->GetCellId () << "\t"
+                  << nLteEnbNodesTotal + mmWaveGlobalIndex[i] + 1 << "\n";
+        }
+      for (uint32_t u = 0; u < mcUeDevs.GetN (); ++u)
+        {
+          Ptr<McUeNetDevice> ue = DynamicCast<McUeNetDevice> (mcUeDevs.Get (u));
+          mapFile << "imsi\t" << ue->GetImsi () << "\t" << ueGlobalIndex[u] + 1 << "\n";
+        }
+    }
 
   // Install and start applications
   // On the remoteHost there is UDP OnOff Application
@@ -557,112 +1780,184 @@ main (int argc, char *argv[])
   ApplicationContainer ueSinkApp; // Container for UE PacketSinks
 
   // --- Slicing Implementation ---
-  // Divide UEs into 3 groups: URLLC, eMBB, mMTC
-  // Assuming total UEs are N, each group will have N/3 UEs.
-  // Make sure nUeNodes is divisible by 3 for an even distribution.
-  NS_ASSERT_MSG (nUeNodes % 3 == 0, "Total number of UEs must be divisible by 3 for slicing.");
-
-  uint32_t numUePerSlice = nUeNodes / 3;
+  // Divide the UEs among the slice profiles (by default URLLC, eMBB and mMTC in equal
+  // shares). UEs are assigned in order: the first ones in ueNodes belong to the first
+  // profile, and so on.
+  std::vector<SliceProfile> sliceProfiles = LoadSliceProfiles (g_sliceProfileFile, g_sliceProfiles);
+  NS_ABORT_MSG_IF (sliceProfiles.size () > kMaxSlices,
+                   "At most " << kMaxSlices << " slice profiles are supported, got "
+                              << sliceProfiles.size ());
+  std::vector<uint32_t> uesPerSlice = DistributeUes (sliceProfiles, nUeNodesTotal);
+
+  g_sliceNames.clear ();
+  for (uint32_t p = 0; p < sliceProfiles.size (); ++p)
+    {
+      g_sliceNames.push_back (sliceProfiles[p].name);
+      NS_LOG_UNCOND ("Slice " << sliceProfiles[p].name << ": " << uesPerSlice[p] << " UEs, "
+                              << sliceProfiles[p].packetSize << " B packets, "
+                              << sliceProfiles[p].pattern << " interval "
+                              << sliceProfiles[p].interval << " s");
+    }
 
-  NS_LOG_UNCOND ("Distributing " << nUeNodes << " UEs into 3 slices: " << numUePerSlice
-                                 << " UEs per slice.");
+  // Aggregated generator: one client per slice on the remote host, a flow per UE is added below
+  std::vector<Ptr<SliceGroupClient>> sliceClients;
+  if (g_trafficGenerator == "aggregated")
+    {
+      for (uint32_t sliceId = 0; sliceId < sliceProfiles.size (); ++sliceId)
+        {
+          const SliceProfile &profile = sliceProfiles[sliceId];
+          Ptr<SliceGroupClient> group = CreateObject<SliceGroupClient> ();
+          group->SetAttribute ("PacketSize", UintegerValue (profile.packetSize));
+          group->SetAttribute ("Pattern", StringValue (profile.pattern));
+          group->SetAttribute ("Interval", TimeValue (Seconds (profile.interval)));
+          group->SetAttribute ("OnTime", TimeValue (Seconds (profile.onTime)));
+          group->SetAttribute ("OffTime", TimeValue (Seconds (profile.offTime)));
+          group->AssignStreams (kSliceTrafficStreams + 3 * sliceId);
+          remoteHost->AddApplication (group);
+          group->SetStartTime (Seconds (0));
+          clientApp.Add (group);
+          sliceClients.push_back (group);
+        }
+    }
+  else
+    {
+      NS_ABORT_MSG_IF (g_trafficGenerator != "per-ue", "Unknown trafficGenerator " << g_trafficGenerator);
+    }
+  NS_LOG_UNCOND ("Distributing " << nUeNodes << " UEs into " << sliceProfiles.size ()
+                                 << " slices.");
 
-  // Open output files for each UE's data rate report and initialize last values
-  // We will now categorize files by slice type
-  std::string sliceType;
-  uint32_t sliceUeCounter = 0; // Counter for UEs within each slice type (0 to numUePerSlice-1)
+  g_ueThroughput.assign (nUeNodes, UeThroughputState{nullptr, nullptr, 0, 0});
+  g_ueNodeIds.resize (nUeNodes);
+  g_ueSliceNames.resize (nUeNodes);
+  g_ueSliceIds.resize (nUeNodes);
 
-  for (uint32_t u_idx = 0; u_idx < nUeNodes; ++u_idx) // u_idx is the index in ueNodes (0 to 11)
-  {
-      Ptr<Node> ueNode = ueNodes.Get (u_idx); // Get the actual Node* from the NodeContainer
+  if (g_logMode == "async" || g_logMode == "binary")
+    {
+      std::vector<uint64_t> sampling;
+      std::vector<uint64_t> rateLimit;
+      std::string error = scenariolog::AsyncLogger::ParseLimits (g_logSampling, sampling);
+      NS_ABORT_MSG_IF (!error.empty (), "Invalid logSampling: " << error);
+      error = scenariolog::AsyncLogger::ParseLimits (g_logRateLimit, rateLimit);
+      NS_ABORT_MSG_IF (!error.empty (), "Invalid logRateLimit: " << error);
+      bool binary = g_logMode == "binary";
+      std::string output = binary ? g_outputDir + "/scenario_log.bin" : g_logFile;
+      // The formatter reads the UE and slice names: they must not change once it runs
+      NS_ABORT_MSG_IF (!g_logger.Start (binary ? scenariolog::AsyncLogger::BINARY
+                                               : scenariolog::AsyncLogger::TEXT,
+                                        output, &FormatLogRecord, 1 << 16, sampling, rateLimit),
+                       "Can't open file " << output);
+    }
+  else
+    {
+      NS_ABORT_MSG_IF (g_logMode != "ns-log" && g_logMode != "off", "Unknown logMode " << g_logMode);
+      g_logUncond = g_logMode == "ns-log";
+    }
 
-      if (u_idx < numUePerSlice)
-      {
-          sliceType = "urllc";
-          sliceUeCounter = u_idx;
-      }
-      else if (u_idx < 2 * numUePerSlice)
-      {
-          sliceType = "embb";
-          sliceUeCounter = u_idx - numUePerSlice;
-      }
-      else
-      {
-          sliceType = "mmtc";
-          sliceUeCounter = u_idx - (2 * numUePerSlice);
-      }
+  // Open output files for each UE's data rate report, then install its sink and its
+  // client on the remote host, in one pass over the UEs
+  for (uint32_t u_idx = 0; u_idx < nUeNodes; ++u_idx)
+    {
+      // Slices follow the index of the UE in the full topology, so that a cluster gives its UEs
+      // the slices and names they have in the full run
+      uint32_t sliceId = 0;
+      uint32_t sliceUeCounter = ueGlobalIndex[u_idx]; // Index of the UE within its slice
+      while (sliceUeCounter >= uesPerSlice[sliceId])
+        {
+          sliceUeCounter -= uesPerSlice[sliceId];
+          ++sliceId;
+        }
+      const SliceProfile &profile = sliceProfiles[sliceId];
+      Ptr<Node> ueNode = ueNodes.Get (u_idx);
 
       // Construct a user-friendly name for this UE, e.g., "urllc_ue_0"
-      std::string ueSliceName = sliceType + "_ue_" + std::to_string (sliceUeCounter);
-      g_ueIdToSliceName[ueNode->GetId ()] = ueSliceName; // Map actual Node ID to this name
+      std::string ueSliceName = profile.name + "_ue_" + std::to_string (sliceUeCounter);
+      g_ueSliceNames[u_idx] = ueSliceName;
+      g_ueNodeIds[u_idx] = ueNode->GetId ();
+      g_ueSliceIds[u_idx] = sliceId;
 
-      // Use this user-friendly name for the filename
-      std::string filename = g_outputDir + "/" + ueSliceName + "_datarate.txt";
-      g_ueDataRateFiles[ueNode->GetId ()] = new std::ofstream (filename.c_str (), std::ios_base::out | std::ios_base::trunc);
-      if (!g_ueDataRateFiles[ueNode->GetId ()]->is_open ())
-      {
-          NS_LOG_ERROR ("Can't open file " << filename);
-      }
-      else
-      {
-          *g_ueDataRateFiles[ueNode->GetId ()] << "Time (s)\tThroughput (Mbps)" << std::endl;
-      }
-      g_ueLastTotalRxBytes[ueNode->GetId ()] = 0; // Initialize
-      g_ueLastThroughputTime[ueNode->GetId ()] = 0; // Initialize
-  }
+      if (g_dataRateFormat != "columnar")
+        {
+          // Use this user-friendly name for the filename
+          std::string filename = g_outputDir + "/" + ueSliceName + "_datarate.txt";
+          std::ofstream *outFile = new std::ofstream (filename.c_str (), std::ios_base::out | std::ios_base::trunc);
+          if (!outFile->is_open ())
+            {
+              NS_LOG_ERROR ("Can't open file " << filename);
+            }
+          else
+            {
+              *outFile << "Time (s)\tThroughput (Mbps)" << std::endl;
+            }
+          g_ueThroughput[u_idx].dataRateFile = outFile;
+        }
 
-  // URLLC Slice (UEs 0 to numUePerSlice-1 in ueNodes container)
-  for (uint32_t u_idx = 0; u_idx < numUePerSlice; ++u_idx)
-    {
-      Ptr<Node> ueNode = ueNodes.Get (u_idx);
       PacketSinkHelper dlPacketSinkHelper ("ns3::UdpSocketFactory",
                                            InetSocketAddress (Ipv4Address::GetAny (), portUdp));
       ApplicationContainer sinkApps = dlPacketSinkHelper.Install (ueNode);
-      g_uePacketSinks[ueNode->GetId ()] = StaticCast<PacketSink> (sinkApps.Get (0));
+      g_ueThroughput[u_idx].sink = StaticCast<PacketSink> (sinkApps.Get (0));
       ueSinkApp.Add (sinkApps);
 
-      UdpClientHelper dlClient (ueIpIface.GetAddress (u_idx), portUdp);
-      dlClient.SetAttribute ("Interval", TimeValue (MicroSeconds (400)));
-      dlClient.SetAttribute ("MaxPackets", UintegerValue (UINT32_MAX));
-      dlClient.SetAttribute ("PacketSize", UintegerValue (45));
-      clientApp.Add (dlClient.Install (remoteHost));
-      NS_LOG_UNCOND ("UE " << g_ueIdToSliceName[ueNode->GetId ()] << " (Node ID: " << ueNode->GetId() << ") assigned to URLLC slice.");
-    }
+      double start = profile.start;
+      if (profile.startSpread > 0)
+        {
+          // Only drawn when a profile asks for staggered starts
+          Ptr<UniformRandomVariable> startSpread = CreateObject<UniformRandomVariable> ();
+          startSpread->SetStream (ueStreams (u_idx) + kStartSpreadStream);
+          start += startSpread->GetValue (0, profile.startSpread);
+        }
 
-  // eMBB Slice (UEs numUePerSlice to 2*numUePerSlice-1 in ueNodes container)
-  for (uint32_t u_idx = numUePerSlice; u_idx < 2 * numUePerSlice; ++u_idx)
-    {
-      Ptr<Node> ueNode = ueNodes.Get (u_idx);
-      PacketSinkHelper dlPacketSinkHelper ("ns3::UdpSocketFactory",
-                                           InetSocketAddress (Ipv4Address::GetAny (), portUdp));
-      ApplicationContainer sinkApps = dlPacketSinkHelper.Install (ueNode);
-      g_uePacketSinks[ueNode->GetId ()] = StaticCast<PacketSink> (sinkApps.Get (0));
-      ueSinkApp.Add (sinkApps);
+      ApplicationContainer ueClientApp;
+      if (!sliceClients.empty ())
+        {
+          sliceClients[sliceId]->AddFlow (ueIpIface.GetAddress (u_idx), portUdp, Seconds (start));
+          g_ueClients.push_back (sliceClients[sliceId]);
+        }
+      else if (profile.pattern == "constant")
+        {
+          UdpClientHelper dlClient (ueIpIface.GetAddress (u_idx), portUdp);
+          dlClient.SetAttribute ("Interval", TimeValue (Seconds (profile.interval)));
+          dlClient.SetAttribute ("MaxPackets", UintegerValue (UINT32_MAX));
+          dlClient.SetAttribute ("PacketSize", UintegerValue (profile.packetSize));
+          ueClientApp = dlClient.Install (remoteHost);
+        }
+      else
+        {
+          Ptr<SliceUdpClient> dlClient = CreateObject<SliceUdpClient> ();
+          dlClient->SetAttribute ("RemoteAddress", Ipv4AddressValue (ueIpIface.GetAddress (u_idx)));
+          dlClient->SetAttribute ("RemotePort", UintegerValue (portUdp));
+          dlClient->SetAttribute ("PacketSize", UintegerValue (profile.packetSize));
+          dlClient->SetAttribute ("Pattern", StringValue (profile.pattern));
+          dlClient->SetAttribute ("Interval", TimeValue (Seconds (profile.interval)));
+          dlClient->SetAttribute ("OnTime", TimeValue (Seconds (profile.onTime)));
+          dlClient->SetAttribute ("OffTime", TimeValue (Seconds (profile.offTime)));
+          dlClient->AssignStreams (ueStreams (u_idx) + kUeTrafficStreams);
+          remoteHost->AddApplication (dlClient);
+          ueClientApp.Add (dlClient);
+        }
 
-      UdpClientHelper dlClient (ueIpIface.GetAddress (u_idx), portUdp);
-      dlClient.SetAttribute ("Interval", TimeValue (MicroSeconds (3500)));
-      dlClient.SetAttribute ("MaxPackets", UintegerValue (UINT32_MAX));
-      dlClient.SetAttribute ("PacketSize", UintegerValue (4500));
-      clientApp.Add (dlClient.Install (remoteHost));
-      NS_LOG_UNCOND ("UE " << g_ueIdToSliceName[ueNode->GetId ()] << " (Node ID: " << ueNode->GetId() << ") assigned to eMBB slice.");
+      if (ueClientApp.GetN () > 0)
+        {
+          g_ueClients.push_back (ueClientApp.Get (0));
+          ueClientApp.Start (Seconds (start));
+          clientApp.Add (ueClientApp);
+        }
+      if (g_logger.IsRunning ())
+        {
+          g_logger.Log (scenariolog::SLICE_ASSIGNMENT, 0, u_idx, sliceId, ueNode->GetId ());
+        }
+      else if (g_logUncond)
+        {
+          NS_LOG_UNCOND ("UE " << ueSliceName << " (Node ID: " << ueNode->GetId() << ") assigned to " << profile.name << " slice.");
+        }
     }
 
-  // mMTC Slice (UEs 2*numUePerSlice to nUeNodes-1 in ueNodes container)
-  for (uint32_t u_idx = 2 * numUePerSlice; u_idx < nUeNodes; ++u_idx)
+  if (g_dataRateFormat == "columnar")
     {
-      Ptr<Node> ueNode = ueNodes.Get (u_idx);
-      PacketSinkHelper dlPacketSinkHelper ("ns3::UdpSocketFactory",
-                                           InetSocketAddress (Ipv4Address::GetAny (), portUdp));
-      ApplicationContainer sinkApps = dlPacketSinkHelper.Install (ueNode);
-      g_uePacketSinks[ueNode->GetId ()] = StaticCast<PacketSink> (sinkApps.Get (0));
-      ueSinkApp.Add (sinkApps);
-
-      UdpClientHelper dlClient (ueIpIface.GetAddress (u_idx), portUdp);
-      dlClient.SetAttribute ("Interval", TimeValue (MilliSeconds (80)));
-      dlClient.SetAttribute ("MaxPackets", UintegerValue (UINT32_MAX));
-      dlClient.SetAttribute ("PacketSize", UintegerValue (100));
-      clientApp.Add (dlClient.Install (remoteHost));
-      NS_LOG_UNCOND ("UE " << g_ueIdToSliceName[ueNode->GetId ()] << " (Node ID: " << ueNode->GetId() << ") assigned to mMTC slice.");
+      std::string filename = g_outputDir + "/datarate.col";
+      if (!g_columnarDataRate.Open (filename, g_sliceNames, g_ueSliceNames, g_ueSliceIds))
+        {
+          NS_LOG_ERROR ("Can't open file " << filename);
+        }
     }
   // --- End of Slicing Implementation ---
 
@@ -674,50 +1969,146 @@ main (int argc, char *argv[])
   remoteHostSinkApp.Start (Seconds (0));
   ueSinkApp.Start (Seconds (0));
 
-  clientApp.Start (MilliSeconds (100));
   clientApp.Stop (Seconds (simTime - 0.1));
 
-  // Schedule periodic data rate reports
-  Simulator::Schedule (Seconds (g_reportingInterval), &CalculateThroughput, std::cref(ueNodes), Seconds (g_reportingInterval));
+  if (g_throughputSampling == "rx-trace")
+    {
+      // Windowed reports driven by packet arrivals, with no periodic event
+      std::string filename = g_outputDir + "/ue_rx_windows.txt";
+      g_rxWindowFile.open (filename.c_str (), std::ios_base::out | std::ios_base::trunc);
+      if (!g_rxWindowFile.is_open ())
+        {
+          NS_LOG_ERROR ("Can't open file " << filename);
+        }
+      else
+        {
+          g_rxWindowFile << "WindowStart (s)\tWindowEnd (s)\tUE\tPackets\tThroughput (Mbps)\t"
+                            "IatMean (ms)\tIatP50 (ms)\tIatP99 (ms)\tJitter (ms)\n";
+        }
+      g_ueRxWindows.resize (g_ueThroughput.size ());
+      for (uint32_t u = 0; u < g_ueThroughput.size (); ++u)
+        {
+          g_ueRxWindows[u].Init (g_reportingInterval, 256);
+        }
+    }
+  else
+    {
+      NS_ABORT_MSG_IF (g_throughputSampling != "poll",
+                       "Unknown throughputSampling " << g_throughputSampling);
+      // Schedule periodic data rate reports
+      Simulator::Schedule (Seconds (g_reportingInterval), &CalculateThroughput, Seconds (g_reportingInterval));
+    }
 
+  if (g_enableLatencyKpi)
+    {
+      std::string filename = g_outputDir + "/slice_latency.txt";
+      g_sliceLatencyFile.open (filename.c_str (), std::ios_base::out | std::ios_base::trunc);
+      NS_ABORT_MSG_IF (!g_sliceLatencyFile.is_open (), "Can't open file " << filename);
+      // Packets and delays are those received in the interval; Lost and LossRatio are those of
+      // the packets sent in the intervals whose reorder grace expired at this report
+      g_sliceLatencyFile << "Time (s)\tSlice\tPackets\tLost\tLossRatio\tDelayP50 (ms)\t"
+                            "DelayP99 (ms)\tDelayP999 (ms)\tDelayMax (ms)\n";
+      g_ueLatency.resize (g_ueThroughput.size ());
+      Simulator::Schedule (Seconds (g_reportingInterval), &ReportSliceLatency, Seconds (g_reportingInterval));
+    }
 
-  if (enableTraces)
+  if (!g_ueRxWindows.empty () || !g_ueLatency.empty ())
+    {
+      for (uint32_t u = 0; u < g_ueThroughput.size (); ++u)
+        {
+          g_ueThroughput[u].sink->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&UeSinkRx, u));
+        }
+    }
+
+
+  bool legacyTraces = g_traceSelection.empty () || SetupSelectedTraces (mmWaveEnbDevs, lteEnbDevs);
+  if (legacyTraces && enableTraces)
     {
       mmwaveHelper->EnableTraces ();
     }
 
   // trick to enable PHY traces for the LTE stack
-  Ptr<LteHelper> lteHelper = CreateObject<LteHelper> ();
-  lteHelper->Initialize ();
-  lteHelper->EnablePhyTraces ();
-  lteHelper->EnableMacTraces ();
+  Ptr<LteHelper> lteHelper;
+  if (legacyTraces)
+    {
+      lteHelper = CreateObject<LteHelper> ();
+      lteHelper->Initialize ();
+      lteHelper->EnablePhyTraces ();
+      lteHelper->EnableMacTraces ();
+    }
+
+  if (!g_kpmShm.empty ())
+    {
+      SetupKpmExport (mcUeDevs, indicationPeriodicity);
+    }
+  if (!g_controlSocket.empty ())
+    {
+      SetupControlInput (mcUeDevs, lteEnbDevs);
+    }
 
   // Since nodes are randomly allocated during each run we always need to print their positions
-  PrintGnuplottableUeListToFile (g_outputDir + "/ues.txt");
+  PrintGnuplottableUeListToFile (g_outputDir + "/ues.txt", ueNodes);
+  if (!g_mobilityRecord.empty ())
+    {
+      g_trajectoryRecorder.Start (ueNodes.GetN (), Simulator::Now ().GetSeconds (),
+                                  g_mobilityRecordPeriod);
+      Simulator::ScheduleNow (&RecordTrajectories, ueNodes, Seconds (g_mobilityRecordPeriod));
+    }
   PrintGnuplottableEnbListToFile (g_outputDir + "/enbs.txt");
 
+  if (g_profileInterval > 0)
+    {
+      g_profiler.Start (Seconds (g_profileInterval));
+    }
+
   bool run = true;
   if (run)
     {
       NS_LOG_UNCOND ("Simulation time is " << simTime << " seconds ");
       Simulator::Stop (Seconds (simTime));
       NS_LOG_INFO ("Run Simulation.");
+      if (g_realtimeSpeed > 0)
+        {
+          g_pacer.Start (g_realtimeSpeed, Seconds (g_realtimeTick), Seconds (g_realtimeLagThreshold),
+                         Seconds (1), g_outputDir + "/realtime.txt");
+        }
       Simulator::Run ();
     }
+  StopControlInput ();
+  g_pacer.Finish ();
+
+  g_profiler.Write (g_outputDir + "/profile.txt");
+  if (!g_mobilityRecord.empty ())
+    {
+      NS_ABORT_MSG_IF (!g_trajectoryRecorder.Write (g_mobilityRecord),
+                       "Can't write " << g_mobilityRecord);
+      NS_LOG_UNCOND ("UE trajectories written to " << g_mobilityRecord);
+    }
+  g_traceSink.Close ();
+  FlushRxWindows (Simulator::Now ().GetSeconds ());
+  if (g_logger.IsRunning ())
+    {
+      g_logger.Stop ();
+      NS_LOG_UNCOND ("Log records:\n" << g_logger.GetSummary ());
+    }
+  g_sliceLatencyFile.close ();
 
   NS_LOG_INFO (lteHelper);
   Simulator::Destroy ();
 
   // Close all data rate files
-  for (auto const& [ueId, outFilePtr] : g_ueDataRateFiles)
+  for (UeThroughputState &ue : g_ueThroughput)
   {
-      if (outFilePtr && outFilePtr->is_open ())
+      if (ue.dataRateFile && ue.dataRateFile->is_open ())
       {
-          outFilePtr->close ();
-          delete outFilePtr;
+          ue.dataRateFile->close ();
       }
+      delete ue.dataRateFile;
+      ue.dataRateFile = nullptr;
   }
-  g_ueDataRateFiles.clear ();
+  g_ueThroughput.clear ();
+  NS_ABORT_MSG_IF (!g_columnarDataRate.Close (), "Write error on " << g_outputDir << "/datarate.col");
+  g_kpmRing.Close ();
 
   NS_LOG_INFO ("Done.");
   return 0;
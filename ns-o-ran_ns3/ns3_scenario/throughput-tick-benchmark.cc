@@ -0,0 +1,179 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/**
+ * Microbenchmark for the per-tick cost of CalculateThroughput in
+ * slicing_AD_v5.cc as a function of the number of UEs.
+ *
+ * It compares the previous layout (one std::map per attribute, keyed by
+ * node ID) with the flat per-UE array used by the scenario. The sink is
+ * emulated by a counter so that only the bookkeeping is measured; the
+ * report lines go to an in-memory stream.
+ *
+ * It does not depend on any ns-3 module:
+ *   ./ns3 run throughput-tick-benchmark -- 36 360 3600 36000
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct FakeSink
+{
+  uint64_t totalRx;
+  uint64_t GetTotalRx () const { return totalRx; }
+};
+
+// Layout used before: five maps keyed by node ID
+struct MapLayout
+{
+  std::map<uint32_t, FakeSink *> sinks;
+  std::map<uint32_t, std::ostream *> files;
+  std::map<uint32_t, double> lastTotalRxBytes;
+  std::map<uint32_t, double> lastThroughputTime;
+  std::map<uint32_t, std::string> sliceNames;
+  std::vector<uint32_t> nodeIds;
+
+  void
+  Tick (double currentTime)
+  {
+    for (uint32_t id : nodeIds)
+      {
+        FakeSink *sink = sinks[id];
+        if (sink)
+          {
+            double currentTotalRxBytes = sink->GetTotalRx ();
+            double intervalBytes = currentTotalRxBytes - lastTotalRxBytes[id];
+            double intervalTime = currentTime - lastThroughputTime[id];
+            if (intervalTime > 0)
+              {
+                double throughputMbps = (intervalBytes * 8.0) / (intervalTime * 1000000.0);
+                std::ostream *out = files[id];
+                *out << currentTime << "\t" << throughputMbps << "\n";
+                (void) sliceNames[id];
+              }
+            lastTotalRxBytes[id] = currentTotalRxBytes;
+            lastThroughputTime[id] = currentTime;
+          }
+      }
+  }
+};
+
+// Layout used now: one contiguous record per UE
+struct FlatLayout
+{
+  struct State
+  {
+    FakeSink *sink;
+    std::ostream *file;
+    uint64_t lastTotalRxBytes;
+    double lastThroughputTime;
+  };
+  std::vector<State> ues;
+  std::vector<std::string> sliceNames;
+
+  void
+  Tick (double currentTime)
+  {
+    for (State &ue : ues)
+      {
+        uint64_t currentTotalRxBytes = ue.sink->GetTotalRx ();
+        double intervalBytes = currentTotalRxBytes - ue.lastTotalRxBytes;
+        double intervalTime = currentTime - ue.lastThroughputTime;
+        if (intervalTime > 0)
+          {
+            double throughputMbps = (intervalBytes * 8.0) / (intervalTime * 1000000.0);
+            *ue.file << currentTime << "\t" << throughputMbps << "\n";
+          }
+        ue.lastTotalRxBytes = currentTotalRxBytes;
+        ue.lastThroughputTime = currentTime;
+      }
+  }
+};
+
+template <typename Layout>
+double
+NsPerTick (Layout &layout, std::vector<FakeSink> &sinks, std::ostringstream &out, uint32_t ticks)
+{
+  auto start = std::chrono::steady_clock::now ();
+  for (uint32_t t = 1; t <= ticks; ++t)
+    {
+      for (FakeSink &s : sinks)
+        {
+          s.totalRx += 4500;
+        }
+      layout.Tick (t * 0.5);
+      // Keep the stream small so that its growth does not dominate
+      out.str ("");
+    }
+  auto stop = std::chrono::steady_clock::now ();
+  return std::chrono::duration<double, std::nano> (stop - start).count () / ticks;
+}
+
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  std::vector<uint32_t> ueCounts;
+  for (int i = 1; i < argc; ++i)
+    {
+      ueCounts.push_back (std::strtoul (argv[i], nullptr, 10));
+    }
+  if (ueCounts.empty ())
+    {
+      ueCounts = {36, 360, 3600, 36000};
+    }
+
+  std::cout << "UEs\tmap ns/tick\tflat ns/tick\tmap ns/UE\tflat ns/UE\tspeedup" << std::endl;
+  for (uint32_t nUes : ueCounts)
+    {
+      // Roughly the same total amount of work per UE count
+      uint32_t ticks = std::max<uint32_t> (10, 2000000 / nUes);
+      std::vector<FakeSink> sinks (nUes, FakeSink{0});
+      std::ostringstream out;
+
+      MapLayout maps;
+      FlatLayout flat;
+      for (uint32_t i = 0; i < nUes; ++i)
+        {
+          // Node IDs are not dense in the scenario: eNBs, PGW and remote host come first
+          uint32_t id = 7 + i;
+          maps.nodeIds.push_back (id);
+          maps.sinks[id] = &sinks[i];
+          maps.files[id] = &out;
+          maps.lastTotalRxBytes[id] = 0;
+          maps.lastThroughputTime[id] = 0;
+          maps.sliceNames[id] = "urllc_ue_" + std::to_string (i);
+          flat.ues.push_back (FlatLayout::State{&sinks[i], &out, 0, 0});
+          flat.sliceNames.push_back ("urllc_ue_" + std::to_string (i));
+        }
+
+      double mapNs = NsPerTick (maps, sinks, out, ticks);
+      double flatNs = NsPerTick (flat, sinks, out, ticks);
+      std::cout << nUes << "\t" << mapNs << "\t" << flatNs << "\t" << mapNs / nUes << "\t"
+                << flatNs / nUes << "\t" << mapNs / flatNs << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,215 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef TRACE_RECORD_SINK_H
+#define TRACE_RECORD_SINK_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Shared binary sink for the selected ns-3 traces of the slicing scenario.
+ *
+ * Every trace record has the same 40-byte layout, so one file holds all
+ * the layers and can be loaded as a single array (see
+ * metric_src/trace_reader.py). The file starts with the 8-byte magic
+ * "SADTRC01" and the record size as a little-endian uint32. Records are
+ * buffered and written in large blocks.
+ */
+namespace tracesink {
+
+enum RecordType : uint8_t
+{
+  PHY_DL = 0,  ///< mmWave TB received by a UE: size = TB bytes, lcid = MCS, flags = corrupt, v0 = SINR [dB], v1 = TBLER
+  PHY_UL = 1,  ///< mmWave TB received by a gNB: same fields, ue = RNTI
+  MAC_LTE = 2, ///< LTE eNB DL scheduling: ue = RNTI, size = TB bytes, lcid = MCS of TB 1, v0 = frame, v1 = subframe
+  RLC_DL = 3,  ///< RLC PDU received by a UE: lcid, size = bytes, v0 = delay [s]
+  PDCP_DL = 4, ///< PDCP PDU received by a UE: lcid, size = bytes, v0 = delay [s]
+  N_RECORD_TYPES
+};
+
+struct TraceRecord
+{
+  double time;     ///< simulation time [s]
+  uint32_t cellId; ///< cell of the record, 0 if unknown
+  uint32_t ue;     ///< UE index in the scenario, or RNTI for the cell side records
+  uint8_t type;    ///< RecordType
+  uint8_t flags;
+  uint16_t lcid;
+  uint32_t size;
+  double v0;
+  double v1;
+};
+
+static_assert (sizeof (TraceRecord) == 40, "TraceRecord must stay 40 bytes");
+
+class BinaryTraceSink
+{
+public:
+  BinaryTraceSink ()
+    : m_file (nullptr),
+      m_records (0)
+  {
+  }
+
+  ~BinaryTraceSink ()
+  {
+    Close ();
+  }
+
+  bool
+  Open (const std::string &filename, uint32_t bufferRecords = 65536)
+  {
+    Close ();
+    m_file = std::fopen (filename.c_str (), "wb");
+    if (!m_file)
+      {
+        return false;
+      }
+    uint32_t recordSize = sizeof (TraceRecord);
+    std::fwrite ("SADTRC01", 1, 8, m_file);
+    std::fwrite (&recordSize, sizeof (recordSize), 1, m_file);
+    m_buffer.reserve (bufferRecords);
+    m_capacity = bufferRecords;
+    return true;
+  }
+
+  bool
+  IsOpen () const
+  {
+    return m_file != nullptr;
+  }
+
+  void
+  Write (const TraceRecord &record)
+  {
+    m_buffer.push_back (record);
+    if (m_buffer.size () >= m_capacity)
+      {
+        Flush ();
+      }
+  }
+
+  void
+  Close ()
+  {
+    if (m_file)
+      {
+        Flush ();
+        std::fclose (m_file);
+        m_file = nullptr;
+      }
+  }
+
+  uint64_t
+  GetRecordCount () const
+  {
+    return m_records + m_buffer.size ();
+  }
+
+private:
+  void
+  Flush ()
+  {
+    if (!m_buffer.empty ())
+      {
+        std::fwrite (m_buffer.data (), sizeof (TraceRecord), m_buffer.size (), m_file);
+        m_records += m_buffer.size ();
+        m_buffer.clear ();
+      }
+  }
+
+  std::FILE *m_file;
+  std::vector<TraceRecord> m_buffer;
+  size_t m_capacity = 65536;
+  uint64_t m_records;
+};
+
+/**
+ * Parse a list of ids such as "2,3,7-9" into a membership mask. An empty
+ * list selects everything and returns an empty mask.
+ * \param maxId largest valid id, e.g. the number of cells
+ * \return an error message, empty if the list is valid
+ */
+inline std::string
+ParseIdList (const std::string &list, uint32_t maxId, std::vector<bool> &mask)
+{
+  mask.clear ();
+  std::istringstream entries (list);
+  std::string entry;
+  while (std::getline (entries, entry, ','))
+    {
+      if (entry.empty ())
+        {
+          continue;
+        }
+      // strtoul would accept a sign (and wrap "-5") or leading blanks
+      if (!std::isdigit (static_cast<unsigned char> (entry[0])))
+        {
+          return "malformed id \"" + entry + "\"";
+        }
+      char *end = nullptr;
+      unsigned long first = std::strtoul (entry.c_str (), &end, 10);
+      unsigned long last = first;
+      if (*end == '-')
+        {
+          const char *rest = end + 1;
+          if (!std::isdigit (static_cast<unsigned char> (*rest)))
+            {
+              return "malformed range \"" + entry + "\"";
+            }
+          last = std::strtoul (rest, &end, 10);
+          if (last < first)
+            {
+              return "empty range \"" + entry + "\"";
+            }
+        }
+      if (*end != '\0')
+        {
+          return "malformed id \"" + entry + "\"";
+        }
+      if (last > maxId)
+        {
+          return "id " + std::to_string (last) + " out of range, the largest is " +
+                 std::to_string (maxId);
+        }
+      if (mask.size () <= last)
+        {
+          mask.resize (last + 1, false);
+        }
+      for (unsigned long id = first; id <= last; ++id)
+        {
+          mask[id] = true;
+        }
+    }
+  return "";
+}
+
+/// \return true if id is selected by a mask built with ParseIdList
+inline bool
+IsSelected (const std::vector<bool> &mask, uint32_t id)
+{
+  return mask.empty () || (id < mask.size () && mask[id]);
+}
+
+} // namespace tracesink
+
+#endif /* TRACE_RECORD_SINK_H */
@@ -0,0 +1,136 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef TRACE_REPLAY_MOBILITY_MODEL_H
+#define TRACE_REPLAY_MOBILITY_MODEL_H
+
+#include "trajectory-file.h"
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * Replays trajectory Index of a trajectory file (see trajectory-file.h).
+ *
+ * The position is interpolated from the mapped samples when it is asked
+ * for, so a UE costs no simulator event, whatever the number of direction
+ * changes of its path; as a consequence CourseChange is never fired. All
+ * the models of a file share one mapping.
+ */
+class TraceReplayMobilityModel : public MobilityModel
+{
+public:
+  static TypeId
+  GetTypeId ()
+  {
+    static TypeId tid =
+        TypeId ("ns3::TraceReplayMobilityModel")
+            .SetParent<MobilityModel> ()
+            .SetGroupName ("Mobility")
+            .AddConstructor<TraceReplayMobilityModel> ()
+            .AddAttribute ("File", "Trajectory file", StringValue (""),
+                           MakeStringAccessor (&TraceReplayMobilityModel::SetFile,
+                                               &TraceReplayMobilityModel::GetFileName),
+                           MakeStringChecker ())
+            .AddAttribute ("Index", "Trajectory of the file replayed by this model",
+                           UintegerValue (0),
+                           MakeUintegerAccessor (&TraceReplayMobilityModel::m_index),
+                           MakeUintegerChecker<uint32_t> ());
+    return tid;
+  }
+
+  /// Map filename, or share the mapping of another model
+  void
+  SetFile (std::string filename)
+  {
+    static std::map<std::string, std::weak_ptr<trajectory::TrajectoryFile>> files;
+    m_filename = filename;
+    if (filename.empty ())
+      {
+        m_file = nullptr;
+        return;
+      }
+    m_file = files[filename].lock ();
+    if (!m_file)
+      {
+        m_file = std::make_shared<trajectory::TrajectoryFile> ();
+        std::string error = m_file->Open (filename);
+        NS_ABORT_MSG_IF (!error.empty (), "Invalid trajectory file " << filename << ": " << error);
+        files[filename] = m_file;
+      }
+  }
+
+  std::string
+  GetFileName () const
+  {
+    return m_filename;
+  }
+
+  /// The mapping, for the number of trajectories and their end
+  std::shared_ptr<const trajectory::TrajectoryFile>
+  GetFile () const
+  {
+    return m_file;
+  }
+
+private:
+  Vector
+  DoGetPosition () const override
+  {
+    double position[3], velocity[3];
+    Sample (position, velocity);
+    return Vector (position[0], position[1], position[2]);
+  }
+
+  void
+  DoSetPosition (const Vector &position) override
+  {
+    NS_FATAL_ERROR ("The position of a TraceReplayMobilityModel comes from its trajectory file");
+  }
+
+  Vector
+  DoGetVelocity () const override
+  {
+    double position[3], velocity[3];
+    Sample (position, velocity);
+    return Vector (velocity[0], velocity[1], velocity[2]);
+  }
+
+  void
+  Sample (double position[3], double velocity[3]) const
+  {
+    NS_ABORT_MSG_IF (!m_file, "TraceReplayMobilityModel without a trajectory file");
+    NS_ABORT_MSG_IF (m_index >= m_file->GetNUes (),
+                     "Trajectory " << m_index << " not in a file of " << m_file->GetNUes ());
+    m_file->Get (m_index, Simulator::Now ().GetSeconds (), position, velocity);
+  }
+
+  std::string m_filename;
+  std::shared_ptr<trajectory::TrajectoryFile> m_file;
+  uint32_t m_index = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (TraceReplayMobilityModel);
+
+} // namespace ns3
+
+#endif /* TRACE_REPLAY_MOBILITY_MODEL_H */
@@ -0,0 +1,270 @@
+/* -*- Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/* *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef TRAJECTORY_FILE_H
+#define TRAJECTORY_FILE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * UE trajectories sampled at a fixed period, for the trace replay mobility
+ * of the slicing scenario (see trace-replay-mobility-model.h). Files are
+ * recorded by the scenario (mobilityRecord) or generated offline
+ * (sim_tools/trajectory_gen.py), and read through mmap, so any number of
+ * UEs and runs share the same pages.
+ *
+ * Layout, little-endian:
+ *
+ *   0    char[8]  magic "SADTRJ01"
+ *   8    uint32   number of UEs
+ *   12   uint32   samples per UE
+ *   16   uint32   point size (12)
+ *   20   uint32   reserved
+ *   24   double   time of the first sample [s]
+ *   32   double   sample period [s]
+ *   40   24 bytes reserved
+ *   64   float[3] x, y, z [m] of UE u at sample k, at index u * samples + k
+ *
+ * Positions between two samples are interpolated linearly; before the first
+ * and after the last sample, the UE stays at the end of its trajectory.
+ */
+namespace trajectory {
+
+struct FileHeader
+{
+  char magic[8];
+  uint32_t nUes;
+  uint32_t nSamples;
+  uint32_t pointSize;
+  uint32_t reserved;
+  double start;
+  double period;
+  uint8_t pad[24];
+};
+
+static_assert (sizeof (FileHeader) == 64, "FileHeader must stay 64 bytes");
+
+struct Point
+{
+  float x;
+  float y;
+  float z;
+};
+
+static_assert (sizeof (Point) == 12, "Point must stay 12 bytes");
+
+class TrajectoryFile
+{
+public:
+  ~TrajectoryFile ()
+  {
+    Close ();
+  }
+
+  /// \return an empty string, or the reason why the file can't be used
+  std::string
+  Open (const std::string &filename)
+  {
+    Close ();
+    int fd = ::open (filename.c_str (), O_RDONLY);
+    if (fd < 0)
+      {
+        return "can't open " + filename;
+      }
+    struct stat st;
+    if (::fstat (fd, &st) != 0 || size_t (st.st_size) < sizeof (FileHeader))
+      {
+        ::close (fd);
+        return "truncated file";
+      }
+    void *base = ::mmap (nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close (fd);
+    if (base == MAP_FAILED)
+      {
+        return "mmap failed";
+      }
+    const FileHeader *h = static_cast<const FileHeader *> (base);
+    std::string error;
+    if (std::memcmp (h->magic, "SADTRJ01", 8) != 0 || h->pointSize != sizeof (Point))
+      {
+        error = "not a trajectory file";
+      }
+    else if (h->nUes == 0 || h->nSamples == 0 || !(h->period > 0))
+      {
+        error = "empty trajectories";
+      }
+    else if (size_t (st.st_size) <
+             sizeof (FileHeader) + size_t (h->nUes) * h->nSamples * sizeof (Point))
+      {
+        error = "truncated file";
+      }
+    if (!error.empty ())
+      {
+        ::munmap (base, st.st_size);
+        return error;
+      }
+    m_base = base;
+    m_size = st.st_size;
+    m_header = h;
+    m_points = reinterpret_cast<const Point *> (h + 1);
+    return "";
+  }
+
+  void
+  Close ()
+  {
+    if (m_base)
+      {
+        ::munmap (m_base, m_size);
+        m_base = nullptr;
+        m_header = nullptr;
+        m_points = nullptr;
+      }
+  }
+
+  uint32_t
+  GetNUes () const
+  {
+    return m_header->nUes;
+  }
+
+  /// Time of the last sample [s]
+  double
+  GetEnd () const
+  {
+    return m_header->start + (m_header->nSamples - 1) * m_header->period;
+  }
+
+  /**
+   * Position of a UE at time t, and its velocity on the segment that holds t
+   * (zero before the first and after the last sample).
+   */
+  void
+  Get (uint32_t ue, double t, double position[3], double velocity[3]) const
+  {
+    const Point *p = m_points + size_t (ue) * m_header->nSamples;
+    double f = (t - m_header->start) / m_header->period;
+    uint32_t last = m_header->nSamples - 1;
+    if (!(f > 0) || last == 0)
+      {
+        Set (p[0], position);
+        velocity[0] = velocity[1] = velocity[2] = 0;
+        return;
+      }
+    if (f >= last)
+      {
+        Set (p[last], position);
+        velocity[0] = velocity[1] = velocity[2] = 0;
+        return;
+      }
+    uint32_t k = uint32_t (f);
+    double w = f - k;
+    const float *a = &p[k].x;
+    const float *b = &p[k + 1].x;
+    for (int i = 0; i < 3; ++i)
+      {
+        position[i] = a[i] + w * (double (b[i]) - a[i]);
+        velocity[i] = (double (b[i]) - a[i]) / m_header->period;
+      }
+  }
+
+private:
+  static void
+  Set (const Point &p, double position[3])
+  {
+    position[0] = p.x;
+    position[1] = p.y;
+    position[2] = p.z;
+  }
+
+  void *m_base = nullptr;
+  size_t m_size = 0;
+  const FileHeader *m_header = nullptr;
+  const Point *m_points = nullptr;
+};
+
+/// Samples the UE positions of a run at a fixed period and writes them as a trajectory file
+class TrajectoryRecorder
+{
+public:
+  void
+  Start (uint32_t nUes, double start, double period)
+  {
+    m_nUes = nUes;
+    m_start = start;
+    m_period = period;
+    m_samples.clear ();
+  }
+
+  /// One position per UE, in UE order
+  void
+  AddSample (const std::vector<Point> &positions)
+  {
+    m_samples.insert (m_samples.end (), positions.begin (), positions.end ());
+  }
+
+  bool
+  Write (const std::string &filename) const
+  {
+    uint32_t nSamples = m_nUes > 0 ? m_samples.size () / m_nUes : 0;
+    FileHeader h;
+    std::memset (&h, 0, sizeof (h));
+    std::memcpy (h.magic, "SADTRJ01", 8);
+    h.nUes = m_nUes;
+    h.nSamples = nSamples;
+    h.pointSize = sizeof (Point);
+    h.start = m_start;
+    h.period = m_period;
+    // Samples are recorded time-major, the file is UE-major
+    std::vector<Point> points (size_t (m_nUes) * nSamples);
+    for (uint32_t k = 0; k < nSamples; ++k)
+      {
+        for (uint32_t u = 0; u < m_nUes; ++u)
+          {
+            points[size_t (u) * nSamples + k] = m_samples[size_t (k) * m_nUes + u];
+          }
+      }
+    std::FILE *out = std::fopen (filename.c_str (), "wb");
+    if (!out)
+      {
+        return false;
+      }
+    bool ok = std::fwrite (&h, sizeof (h), 1, out) == 1 &&
+              std::fwrite (points.data (), sizeof (Point), points.size (), out) == points.size ();
+    return std::fclose (out) == 0 && ok;
+  }
+
+private:
+  uint32_t m_nUes = 0;
+  double m_start = 0;
+  double m_period = 1;
+  std::vector<Point> m_samples;
+};
+
+} // namespace trajectory
+
+#endif /* TRAJECTORY_FILE_H */
@@ -0,0 +1,103 @@
+import sys
+import time
+import socket
+import argparse
+from typing import List
+
+
+class ControlSender:
+
+	"""
+	Sends handover and slice commands to a scenario started with --controlSocket=<path>, one Unix datagram per command (see control-input.h).
+
+	It is the local stand-in for the RIC: every command carries a sequence number and the send time, so the scenario can write the send-to-arrival and arrival-to-apply latencies of each one to control_latency.txt.
+
+	Attributes
+	----------
+	path : str
+		Socket bound by the scenario.
+
+	seq : int
+		Sequence number of the next command.
+
+	Methods
+	-------
+	handover(imsi, target_cell)
+		Moves the UE to the mmWave cell target_cell.
+
+	slice_update(slice_name, interval, size)
+		Changes the packet interval and/or size of every UE of a slice.
+	"""
+
+	def __init__(self, path: str):
+
+		"""
+		Initializes the class
+		"""
+
+		self.path = path
+		self.seq = 0
+		self.socket = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)
+
+	def send(self, command: str, *args) -> int:
+
+		"""
+		Sends "<command> <seq> <sentNs> <args>" and returns the sequence number.
+		"""
+
+		seq = self.seq
+		self.seq += 1
+		line = " ".join([command, str(seq), str(time.time_ns())] + [str(arg) for arg in args])
+		self.socket.sendto(line.encode("ascii"), self.path)
+		return seq
+
+	def handover(self, imsi: int, target_cell: int) -> int:
+
+		return self.send("ho", int(imsi), int(target_cell))
+
+	def slice_update(self, slice_name: str, interval: float = None, size: int = None) -> int:
+
+		options: List[str] = []
+		if interval is not None:
+			options.append(f"interval={interval}")
+		if size is not None:
+			options.append(f"size={int(size)}")
+		if not options:
+			raise ValueError("a slice update needs an interval or a size")
+		return self.send("slice", slice_name, *options)
+
+	def close(self):
+
+		self.socket.close()
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Send control commands to a scenario started with --controlSocket.")
+	parser.add_argument("socket", help="path of the scenario control socket")
+	subparsers = parser.add_subparsers(dest="command", required=True)
+	ho_parser = subparsers.add_parser("ho", help="handover a UE to a mmWave cell")
+	ho_parser.add_argument("imsi", type=int)
+	ho_parser.add_argument("target_cell", type=int)
+	slice_parser = subparsers.add_parser("slice", help="change the traffic of a slice")
+	slice_parser.add_argument("slice")
+	slice_parser.add_argument("--interval", type=float, help="packet interval [s]")
+	slice_parser.add_argument("--size", type=int, help="packet size [bytes]")
+	parser.add_argument("--count", type=int, default=1, help="send the command count times")
+	parser.add_argument("--rate", type=float, default=100.0, help="commands per second when count > 1")
+	args = parser.parse_args()
+
+	sender = ControlSender(args.socket)
+	next_send = time.monotonic()
+	try:
+		for _ in range(args.count):
+			if args.command == "ho":
+				sender.handover(args.imsi, args.target_cell)
+			else:
+				sender.slice_update(args.slice, args.interval, args.size)
+			next_send += 1.0 / args.rate
+			time.sleep(max(0.0, next_send - time.monotonic()))
+	except (FileNotFoundError, ConnectionRefusedError):
+		print(f"No scenario listening on {args.socket}", file=sys.stderr)
+		sys.exit(1)
+	print(f"{sender.seq} commands sent to {args.socket}")
+	sender.close()
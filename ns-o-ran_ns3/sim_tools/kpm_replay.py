@@ -0,0 +1,400 @@
+import re
+import time
+import json
+import argparse
+import urllib.parse
+import urllib.request
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+
+class KpmRecording:
+
+	"""
+	The E2 file logs of a scenario run (cu-cp-cell-*.txt, cu-up-cell-*.txt and du-cell-*.txt, written with --enableE2FileLogging=true), as one timeline.
+
+	Attributes
+	----------
+	headers : Dict[str, str]
+		Header line of every log file, by file name.
+
+	timeline : List[Tuple[int, Dict[str, List[str]]]]
+		The reports of the run in time order: (timestamp [ms], lines of every file with that timestamp).
+
+	rows : int
+		Number of rows of the recording.
+	"""
+
+	patterns = ["cu-cp-cell-*.txt", "cu-up-cell-*.txt", "du-cell-*.txt"]
+
+	def __init__(self, directory: str):
+
+		"""
+		Initializes the class and loads the logs of directory
+		"""
+
+		self.headers: Dict[str, str] = {}
+		reports: Dict[int, Dict[str, List[str]]] = {}
+		self.rows = 0
+		for pattern in self.patterns:
+			for path in sorted(Path(directory).glob(pattern)):
+				with open(path, "r") as log_file:
+					lines = log_file.read().splitlines()
+				if not lines:
+					continue
+				self.headers[path.name] = lines[0]
+				for line in lines[1:]:
+					timestamp = line.split(",", 1)[0].strip()
+					if not timestamp.isdigit():
+						continue
+					reports.setdefault(int(timestamp), {}).setdefault(path.name, []).append(line)
+					self.rows += 1
+		if not reports:
+			raise ValueError(f"no E2 file log rows in {directory}")
+		self.timeline = sorted(reports.items())
+
+	@property
+	def span_ms(self) -> int:
+
+		"""
+		Time between the first and the last report, plus one reporting period, so that a loop of the recording keeps the period.
+		"""
+
+		times = [timestamp for timestamp, _ in self.timeline]
+		period = min((b - a for a, b in zip(times, times[1:])), default=100)
+		return times[-1] - times[0] + period
+
+
+class KpmReplayer:
+
+	"""
+	Re-emits a KpmRecording into a directory watched by sim_watcher.py, with the inter-report timing of the run scaled by speed.
+
+	The lines of each report time are appended to their files in one write per file, as the scenario does at every indication. By default the timestamp column is rewritten with the wall-clock time the report is due, so downstream stages that key or query on time (the watcher keys, the AD join) see a live run, and the recording can be looped.
+
+	Attributes
+	----------
+	recording : KpmRecording
+		The reports to replay.
+
+	output_dir : Path
+		Directory the logs are written to.
+
+	speed : float
+		Recording seconds per wall second: 1 is the original timing, 10 ten times faster, 0 as fast as possible.
+
+	retime : bool
+		Rewrite the timestamps to the wall clock, else keep the recorded ones (the recording can then be replayed only once).
+
+	emitted : int
+		Rows written so far.
+
+	lags : List[float]
+		Delay [s] of every report behind its due time, i.e. where the replayer itself falls behind.
+
+	Methods
+	-------
+	open()
+		Creates the output files with their headers, replacing the files of a previous run.
+
+	replay(duration)
+		Emits reports for duration wall seconds, or until the end of the recording.
+	"""
+
+	def __init__(self, recording: KpmRecording, output_dir: str = ".", speed: float = 1.0, retime: bool = True,
+				 loop: bool = False):
+
+		"""
+		Initializes the class
+		"""
+
+		self.recording = recording
+		self.output_dir = Path(output_dir)
+		self.speed = speed
+		self.retime = retime
+		self.loop = loop and retime
+		self.emitted = 0
+		self.lags: List[float] = []
+		self._files = {}
+		self._position = 0   # next report of the timeline
+		self._loops = 0
+		self._clock = None   # (wall time, recording time [ms]) of the last change of speed
+		self._last_timestamp = 0
+
+	def open(self):
+
+		self.output_dir.mkdir(parents=True, exist_ok=True)
+		for name, header in self.recording.headers.items():
+			# A new file rather than a truncation: the watcher's tailer restarts on smaller files
+			path = self.output_dir / name
+			path.unlink(missing_ok=True)
+			self._files[name] = open(path, "w")
+			self._files[name].write(header + "\n")
+			self._files[name].flush()
+
+	def close(self):
+
+		for log_file in self._files.values():
+			log_file.close()
+		self._files = {}
+
+	def set_speed(self, speed: float):
+
+		"""
+		Changes the speed from the next report on, without a jump in the emitted timestamps.
+		"""
+
+		if self._clock is not None:
+			self._clock = (time.time(), self._recording_time())
+		self.speed = speed
+
+	def _recording_time(self) -> float:
+
+		"""
+		Recording time [ms] of the next report, loops included.
+		"""
+
+		timeline = self.recording.timeline
+		if self._position >= len(timeline):
+			return timeline[0][0] + (self._loops + 1) * self.recording.span_ms
+		return timeline[self._position][0] + self._loops * self.recording.span_ms
+
+	def replay(self, duration: float = None) -> bool:
+
+		"""
+		Emits the due reports for duration wall seconds (None: until the end of the recording). Returns False once the recording is exhausted.
+		"""
+
+		if not self._files:
+			self.open()
+		timeline = self.recording.timeline
+		end = None if duration is None else time.time() + duration
+		if self._clock is None:
+			self._clock = (time.time(), self._recording_time())
+
+		while True:
+			if self._position >= len(timeline):
+				if not self.loop:
+					return False
+				self._position = 0
+				self._loops += 1
+
+			recording_time = self._recording_time()
+			wall_start, recording_start = self._clock
+			if self.speed > 0:
+				due = wall_start + (recording_time - recording_start) / 1000 / self.speed
+			else:
+				due = time.time()
+			if end is not None and due >= end:
+				time.sleep(max(0.0, end - time.time()))
+				return True
+			delay = due - time.time()
+			if delay > 0:
+				time.sleep(delay)
+
+			now = time.time()
+			self.lags.append(max(0.0, now - due))
+			# Distinct report times, or the watcher and InfluxDB would merge the rows of a UE
+			self._last_timestamp = max(self._last_timestamp + 1, int(1000 * (due if self.speed > 0 else now)))
+			timestamp = str(self._last_timestamp)
+			for name, lines in timeline[self._position][1].items():
+				if self.retime:
+					lines = [timestamp + line[line.index(","):] for line in lines]
+				self._files[name].write("\n".join(lines) + "\n")
+				self._files[name].flush()
+				self.emitted += len(lines)
+			self._position += 1
+
+			if end is not None and time.time() >= end:
+				return True
+
+
+class InfluxProbe:
+
+	"""
+	Number of points of the watcher's measurements in InfluxDB, queried over HTTP.
+
+	Attributes
+	----------
+	measurements : List[str]
+		Measurements counted, by default the three buckets written from the E2 logs.
+	"""
+
+	measurements = ["cu_cp_bucket", "cu_up_bucket", "du_bucket"]
+
+	def __init__(self, host: str = "influxdb", port: int = 8086, database: str = "ns3_metrics"):
+
+		"""
+		Initializes the class
+		"""
+
+		self.url = f"http://{host}:{port}/query"
+		self.database = database
+		self.since_ns = time.time_ns()
+
+	def count(self) -> Dict[str, int]:
+
+		counts = {}
+		for measurement in self.measurements:
+			query = f"SELECT count(ue_imsi_complete) FROM {measurement} WHERE time >= {self.since_ns}"
+			url = self.url + "?" + urllib.parse.urlencode({"db": self.database, "q": query})
+			with urllib.request.urlopen(url, timeout=10) as response:
+				result = json.loads(response.read())["results"][0]
+			series = result.get("series")
+			counts[measurement] = int(series[0]["values"][0][1]) if series else 0
+		return counts
+
+
+class LogProbe:
+
+	"""
+	Number of lines of a growing log file that match a pattern, e.g. the per-row lines of ad-slicing.py.
+	"""
+
+	def __init__(self, path: str, pattern: str):
+
+		"""
+		Initializes the class, lines already in the file are not counted
+		"""
+
+		self.path = Path(path)
+		self.pattern = re.compile(pattern)
+		self.lines = 0
+		self._offset = self.path.stat().st_size if self.path.exists() else 0
+		self._partial = b""
+
+	def count(self) -> int:
+
+		if not self.path.exists():
+			return self.lines
+		size = self.path.stat().st_size
+		if size < self._offset:
+			self._offset = 0
+			self._partial = b""
+		with open(self.path, "rb") as log_file:
+			log_file.seek(self._offset)
+			data = self._partial + log_file.read(size - self._offset)
+		self._offset = size
+		end = data.rfind(b"\n")
+		self._partial = data[end + 1:]
+		for line in data[:end + 1].decode("utf-8", errors="replace").splitlines():
+			if self.pattern.search(line):
+				self.lines += 1
+		return self.lines
+
+
+def percentile(values: List[float], q: float) -> float:
+
+	if not values:
+		return 0.0
+	values = sorted(values)
+	return values[min(len(values) - 1, int(q * len(values)))]
+
+
+def ramp(replayer: KpmReplayer, probes: Dict[str, object], speeds: List[float], step: float, drain: float,
+		 tolerance: float) -> Optional[float]:
+
+	"""
+	Replays step wall seconds at every speed, waits drain seconds, and compares the rows that reached every stage with the rows emitted in the step.
+
+	The ratio of stage rows to emitted rows at the first speed is the reference (not every emitted row becomes a point or a log line); a stage falls behind when its ratio drops below (1 - tolerance) times the reference. Returns the first speed at which the replayer or a stage falls behind, None if none does.
+	"""
+
+	def sample() -> Dict[str, int]:
+		counts = {}
+		for name, probe in probes.items():
+			count = probe.count()
+			if isinstance(count, dict):
+				counts.update({f"{name}:{key}": value for key, value in count.items()})
+			else:
+				counts[name] = count
+		return counts
+
+	reference = {}
+	previous = sample()
+	stage_names = list(previous)
+	print("speed\temitted rows/s\temit lag p99 [ms]\t" + "\t".join(f"{name} rows/s\tratio" for name in stage_names))
+	for speed in speeds:
+		replayer.set_speed(speed)
+		emitted_before = replayer.emitted
+		lags_before = len(replayer.lags)
+		start = time.time()
+		replayer.replay(step)
+		emitted = replayer.emitted - emitted_before
+		emit_time = time.time() - start
+		lags = replayer.lags[lags_before:]
+		time.sleep(drain)
+		counts = sample()
+
+		behind = []
+		cells = []
+		for name in stage_names:
+			delta = counts[name] - previous[name]
+			ratio = delta / emitted if emitted else 0.0
+			reference.setdefault(name, ratio)
+			if reference[name] > 0 and ratio < (1 - tolerance) * reference[name]:
+				behind.append(name)
+			cells.append(f"{delta / emit_time:.0f}\t{ratio:.3f}")
+		lag_p99 = percentile(lags, 0.99)
+		if speed > 0 and lag_p99 > tolerance * step:
+			behind.insert(0, "replayer")
+		label = f"{speed:g}x" if speed > 0 else "max"
+		print(f"{label}\t{emitted / emit_time:.0f}\t{1000 * lag_p99:.1f}\t" + "\t".join(cells))
+		previous = counts
+		if behind:
+			print(f"falls behind at {label}: {', '.join(behind)}")
+			return speed
+	return None
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Replay recorded E2 file logs into the directory watched by sim_watcher.py, at the original or a scaled timing, and measure how fast the downstream stages keep up.")
+	parser.add_argument("recording", help="directory with the cu-cp-cell-*, cu-up-cell-* and du-cell-* logs of a run")
+	parser.add_argument("--output", default=".", help="directory watched by sim_watcher.py")
+	parser.add_argument("--speed", type=float, default=1.0, help="recording seconds per wall second, 0: as fast as possible")
+	parser.add_argument("--keep-timestamps", action="store_true", help="keep the recorded timestamps instead of the wall clock")
+	parser.add_argument("--loop", action="store_true", help="loop the recording (with rewritten timestamps)")
+	parser.add_argument("--duration", type=float, help="stop after this many wall seconds")
+	parser.add_argument("--ramp", type=float, nargs="+", help="load test: replay at each of these speeds (0: max) until a stage falls behind")
+	parser.add_argument("--step", type=float, default=10.0, help="wall seconds per ramp speed")
+	parser.add_argument("--drain", type=float, default=2.0, help="seconds left to the stages after each ramp step")
+	parser.add_argument("--tolerance", type=float, default=0.05, help="relative shortfall of a stage counted as falling behind")
+	parser.add_argument("--influx", metavar="HOST:PORT", help="count the points reaching InfluxDB (database ns3_metrics)")
+	parser.add_argument("--log", action="append", default=[], metavar="NAME=PATH:REGEX",
+						help="count the lines of a stage log matching REGEX, e.g. ad='ad.log:\\| +[0-9]+ \\|'")
+	args = parser.parse_args()
+
+	recording = KpmRecording(args.recording)
+	print(f"{recording.rows} rows in {len(recording.headers)} files, {len(recording.timeline)} report times over "
+		  f"{recording.span_ms / 1000:.1f} s")
+	replayer = KpmReplayer(recording, args.output, args.speed, retime=not args.keep_timestamps,
+						   loop=args.loop or args.ramp is not None)
+
+	probes = {}
+	if args.influx:
+		host, _, port = args.influx.partition(":")
+		probes["influx"] = InfluxProbe(host, int(port or 8086))
+	for probe in args.log:
+		name, _, rest = probe.partition("=")
+		path, _, pattern = rest.partition(":")
+		probes[name] = LogProbe(path, pattern or ".")
+
+	replayer.open()
+	try:
+		if args.ramp:
+			limit = ramp(replayer, probes, args.ramp, args.step, args.drain, args.tolerance)
+			if limit is None:
+				print("no stage fell behind")
+		else:
+			start = time.time()
+			replayer.replay(args.duration)
+			elapsed = time.time() - start
+			print(f"{replayer.emitted} rows in {elapsed:.2f} s, {replayer.emitted / max(elapsed, 1e-9):.0f} rows/s, "
+				  f"emit lag p50 {1000 * percentile(replayer.lags, 0.5):.1f} ms, "
+				  f"p99 {1000 * percentile(replayer.lags, 0.99):.1f} ms")
+			for name, probe in probes.items():
+				print(f"{name}: {probe.count()}")
+	except KeyboardInterrupt:
+		pass
+	finally:
+		replayer.close()
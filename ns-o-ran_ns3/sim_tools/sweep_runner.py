@@ -0,0 +1,301 @@
+import os
+import re
+import csv
+import sys
+import time
+import yaml
+import shutil
+import argparse
+import itertools
+import subprocess
+from pathlib import Path
+from typing import Dict, List, Tuple
+from concurrent.futures import ThreadPoolExecutor, as_completed
+
+
+class SweepRunner:
+
+	"""
+	Runs a grid of slicing_AD_v5 configurations x seeds as parallel processes and merges their E2 file logs into one labelled dataset.
+
+	Every run gets its own directory under the sweep output directory. The scenario is started with that directory as working directory (the E2 file logs cu-cp-cell-*.txt, cu-up-cell-*.txt and du-cell-*.txt are written to the current directory) and as outputDir. The runs are offline: enableE2FileLogging=true is always passed.
+
+	Attributes
+	----------
+	spec : dict
+		The sweep specification, see load_spec.
+
+	output_dir : Path
+		Directory that holds one sub-directory per run, the run manifest and the merged dataset.
+
+	jobs : int
+		Number of scenario processes run concurrently.
+
+	Methods
+	-------
+	load_spec(path)
+		Reads and validates a YAML sweep specification.
+
+	expand()
+		Returns the list of runs (run id, parameters, seed) of the sweep.
+
+	run()
+		Executes the runs that have not completed yet and writes runs.csv.
+
+	merge()
+		Merges the E2 file logs of every completed run into dataset_<type>.csv files.
+	"""
+
+	log_types = {"cu_cp": "cu-cp-cell-*.txt", "cu_up": "cu-up-cell-*.txt", "du": "du-cell-*.txt"}
+	max_sim_time = 100.0   # upper bound of the simTime GlobalValue checker
+
+	def __init__(self, spec: dict, output_dir: str = None, jobs: int = None):
+
+		"""
+		Initializes the class
+		"""
+
+		self.spec = spec
+		self.output_dir = Path(output_dir or spec.get("output", "sweep_output")).resolve()
+		self.jobs = jobs or spec.get("jobs") or os.cpu_count() or 1
+		self.binary = Path(spec.get("binary", "./build/scratch/ns3.38.rc1-slicing_AD_v5-default")).resolve()
+		self.timeout = spec.get("timeout")
+		self.clusters = int(spec.get("isolated_clusters", 1))
+
+	@staticmethod
+	def load_spec(path: str) -> dict:
+
+		"""
+		Reads a YAML sweep specification, e.g.
+
+			binary: ./build/scratch/ns3.38.rc1-slicing_AD_v5-default
+			output: sweeps/handover
+			jobs: 8
+			seeds: {start: 1, count: 100}     # or an explicit list [1, 2, 3]
+			fixed: {simTime: 10, indicationPeriodicity: 0.1}
+			isolated_clusters: 4              # optional and approximate, see below
+			grid:
+			  hoSinrDifference: [1, 3, 5]
+			  handoverMode: [DynamicTtt, Threshold]
+
+		fixed and grid keys are scenario command line options (GlobalValues or cmd values). With isolated_clusters, every run is replaced by that many scenario processes (numIsolatedClusters/isolatedClusterIndex), run in the sub-directories cluster_<i> of the run. Each simulates one sector of the topology without the others: there is no interference, X2 link or handover between them, so together they are an approximation of the run, not the run.
+		"""
+
+		with open(path, "r") as input_file:
+			spec = yaml.safe_load(input_file) or {}
+
+		if "clusters" in spec:
+			raise ValueError("'clusters' is now 'isolated_clusters': the clusters do not add up to the run")
+
+		for section in ("fixed", "grid"):
+			if not isinstance(spec.get(section, {}), dict):
+				raise ValueError(f"'{section}' must be a mapping of option names")
+
+		for name, values in spec.get("grid", {}).items():
+			if not isinstance(values, list) or not values:
+				raise ValueError(f"grid option '{name}' must be a non-empty list")
+
+		sim_times = [spec.get("fixed", {}).get("simTime", 2)] + spec.get("grid", {}).get("simTime", [])
+		for sim_time in sim_times:
+			if not 0.1 <= float(sim_time) <= SweepRunner.max_sim_time:
+				raise ValueError(f"simTime {sim_time} is outside the scenario range [0.1, {SweepRunner.max_sim_time}]")
+
+		return spec
+
+	def seeds(self) -> List[int]:
+
+		seeds = self.spec.get("seeds", [1])
+		if isinstance(seeds, dict):
+			return list(range(int(seeds.get("start", 1)), int(seeds.get("start", 1)) + int(seeds["count"])))
+		if isinstance(seeds, int):
+			return [seeds]
+		return [int(seed) for seed in seeds]
+
+	def expand(self) -> List[Tuple[str, Dict, int]]:
+
+		"""
+		Returns the (run id, parameters, seed) of every run: the cartesian product of the grid, times the seeds.
+		"""
+
+		grid = self.spec.get("grid", {})
+		names = sorted(grid)
+		runs = []
+		for config_index, values in enumerate(itertools.product(*(grid[name] for name in names))):
+			params = dict(self.spec.get("fixed", {}))
+			params.update(zip(names, values))
+			for seed in self.seeds():
+				runs.append((f"c{config_index:04d}_s{seed}", params, seed))
+		return runs
+
+	def _command(self, params: Dict, seed: int, run_dir: Path, cluster: int = None) -> List[str]:
+
+		command = [str(self.binary)]
+		for name, value in params.items():
+			if isinstance(value, bool):
+				value = "true" if value else "false"
+			command.append(f"--{name}={value}")
+		command += [f"--RngRun={seed}", "--enableE2FileLogging=true", f"--outputDir={run_dir}"]
+		if cluster is not None:
+			command += [f"--numIsolatedClusters={self.clusters}", f"--isolatedClusterIndex={cluster}"]
+		return command
+
+	def _run_dirs(self, run_id: str) -> List[Tuple[Path, int]]:
+
+		"""
+		Returns the (directory, cluster index) of the processes of a run: the run directory, or one cluster_<i> sub-directory per cluster.
+		"""
+
+		if self.clusters <= 1:
+			return [(self.output_dir / run_id, None)]
+		return [(self.output_dir / run_id / f"cluster_{cluster}", cluster) for cluster in range(self.clusters)]
+
+	def _run_one(self, run_id: str, params: Dict, seed: int, run_dir: Path = None, cluster: int = None) -> Dict:
+
+		run_dir = run_dir or self.output_dir / run_id
+		if run_dir.exists():
+			shutil.rmtree(run_dir)   # leftovers of an interrupted run
+		run_dir.mkdir(parents=True)
+
+		command = self._command(params, seed, run_dir, cluster)
+		start = time.time()
+		with open(run_dir / "run.log", "w") as log_file:
+			try:
+				return_code = subprocess.run(command, cwd=run_dir, stdout=log_file, stderr=subprocess.STDOUT,
+											 timeout=self.timeout).returncode
+			except subprocess.TimeoutExpired:
+				return_code = "timeout"
+		wall_time = time.time() - start
+
+		if return_code == 0:
+			(run_dir / "DONE").touch()
+
+		result = {"run_id": run_id, "seed": seed, "status": "ok" if return_code == 0 else "failed",
+				  "return_code": return_code, "wall_time_s": round(wall_time, 3), **params}
+		if cluster is not None:
+			result["cluster"] = cluster
+		return result
+
+	def run(self) -> List[Dict]:
+
+		"""
+		Executes every run that has no DONE marker yet, self.jobs processes at a time, and writes runs.csv. With isolated clusters, the processes of a run are scheduled independently and the run is DONE when all of its clusters are.
+		"""
+
+		if not self.binary.exists():
+			raise FileNotFoundError(f"scenario binary {self.binary} not found")
+
+		self.output_dir.mkdir(parents=True, exist_ok=True)
+		runs = self.expand()
+		results = []
+		pending = []
+		for run_id, params, seed in runs:
+			for run_dir, cluster in self._run_dirs(run_id):
+				if (run_dir / "DONE").exists():
+					results.append({"run_id": run_id, "seed": seed, "status": "ok", "return_code": 0,
+									"wall_time_s": "", **params, **({} if cluster is None else {"cluster": cluster})})
+				else:
+					pending.append((run_id, params, seed, run_dir, cluster))
+
+		processes = len(runs) * max(self.clusters, 1)
+		print(f"{len(runs)} runs, {processes - len(pending)} of {processes} processes already done, "
+			  f"{self.jobs} in parallel")
+		with ThreadPoolExecutor(max_workers=self.jobs) as executor:
+			futures = [executor.submit(self._run_one, *run) for run in pending]
+			for done_count, future in enumerate(as_completed(futures), 1):
+				result = future.result()
+				results.append(result)
+				cluster = f" cluster {result['cluster']}" if "cluster" in result else ""
+				print(f"[{done_count}/{len(pending)}] {result['run_id']}{cluster} {result['status']} "
+					  f"({result['wall_time_s']} s)")
+
+		if self.clusters > 1:
+			for run_id, _, _ in runs:
+				if all((run_dir / "DONE").exists() for run_dir, _ in self._run_dirs(run_id)):
+					(self.output_dir / run_id / "DONE").touch()
+
+		results.sort(key=lambda result: (result["run_id"], result.get("cluster", 0)))
+		self._write_csv(self.output_dir / "runs.csv", results)
+		return results
+
+	def merge(self) -> Dict[str, int]:
+
+		"""
+		Concatenates the E2 file logs of the completed runs into dataset_cu_cp.csv, dataset_cu_up.csv and dataset_du.csv.
+
+		Every row is prefixed with the run id, the seed, the swept parameters, the isolated cluster (with isolated_clusters) and the cell file id (the N of cu-cp-cell-N.txt). Rows are streamed, so the merged dataset does not have to fit in memory. The rows of an isolated cluster keep its own cell ids and IMSIs: the cluster_map.txt of its directory maps them to those of the full topology.
+		"""
+
+		runs = [run for run in self.expand() if (self.output_dir / run[0] / "DONE").exists()]
+		labels = (["run_id", "seed"] + sorted({name for run in runs for name in run[1]}) +
+				  (["cluster"] if self.clusters > 1 else []) + ["file_id_number"])
+		row_counts = {}
+
+		for log_type, pattern in self.log_types.items():
+			files = [(run, cluster, path) for run in runs for run_dir, cluster in self._run_dirs(run[0])
+					 for path in sorted(run_dir.glob(pattern))]
+
+			# Union of the headers, in order of first appearance
+			columns = []
+			for _, _, path in files:
+				with open(path, "r", newline="") as log_file:
+					header = next(csv.reader(log_file), [])
+				columns += [column.strip() for column in header
+							if column.strip() and column.strip() not in columns]
+
+			output_path = self.output_dir / f"dataset_{log_type}.csv"
+			row_count = 0
+			with open(output_path, "w", newline="") as output_file:
+				writer = csv.DictWriter(output_file, fieldnames=labels + columns, restval="")
+				writer.writeheader()
+				for (run_id, params, seed), cluster, path in files:
+					label = {"run_id": run_id, "seed": seed, **params,
+							 **({} if cluster is None else {"cluster": cluster}),
+							 "file_id_number": re.search(r"-(\d+)\.txt$", path.name).group(1)}
+					with open(path, "r", newline="") as log_file:
+						for row in csv.DictReader(log_file):
+							row = {k.strip(): v.strip() for k, v in row.items()
+								   if k is not None and k.strip() != "" and v is not None}
+							row.update(label)
+							writer.writerow(row)
+							row_count += 1
+			row_counts[log_type] = row_count
+			print(f"{output_path}: {row_count} rows from {len(files)} files")
+
+		return row_counts
+
+	@staticmethod
+	def _write_csv(path: Path, rows: List[Dict]):
+
+		columns = []
+		for row in rows:
+			columns += [column for column in row if column not in columns]
+		with open(path, "w", newline="") as output_file:
+			writer = csv.DictWriter(output_file, fieldnames=columns, restval="")
+			writer.writeheader()
+			writer.writerows(rows)
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Run a parameter sweep of the slicing_AD_v5 scenario and merge its E2 file logs.")
+	parser.add_argument("spec", help="YAML sweep specification")
+	parser.add_argument("--output", help="sweep output directory (overrides the spec)")
+	parser.add_argument("--jobs", type=int, help="concurrent scenario processes (default: spec, then number of cores)")
+	parser.add_argument("--merge-only", action="store_true", help="only merge the logs of the completed runs")
+	parser.add_argument("--dry-run", action="store_true", help="print the command of every run and exit")
+	args = parser.parse_args()
+
+	runner = SweepRunner(SweepRunner.load_spec(args.spec), output_dir=args.output, jobs=args.jobs)
+
+	if args.dry_run:
+		for run_id, params, seed in runner.expand():
+			for run_dir, cluster in runner._run_dirs(run_id):
+				print(run_id, " ".join(runner._command(params, seed, run_dir, cluster)))
+		sys.exit(0)
+
+	if not args.merge_only:
+		results = runner.run()
+		failed = [result["run_id"] for result in results if result["status"] != "ok"]
+		if failed:
+			print(f"{len(failed)} runs failed, see run.log in: {', '.join(failed)}")
+
+	runner.merge()
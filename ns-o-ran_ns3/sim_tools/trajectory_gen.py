@@ -0,0 +1,168 @@
+import sys
+import argparse
+import numpy as np
+
+
+class TrajectoryFile:
+
+	"""
+	Reads and writes the UE trajectory files replayed by the slicing scenario with --mobilityTrace and recorded with --mobilityRecord (see trajectory-file.h).
+
+	A file is a 64-byte header (magic "SADTRJ01", number of UEs, samples per UE, point size, time of the first sample, sample period) followed by float32 x, y, z points, UE-major: UE u at sample k is point u * samples + k.
+
+	Attributes
+	----------
+	header_dtype : np.dtype
+		Layout of the header.
+	"""
+
+	magic = b"SADTRJ01"
+	header_dtype = np.dtype([
+		("magic", "S8"),
+		("n_ues", "<u4"),
+		("n_samples", "<u4"),
+		("point_size", "<u4"),
+		("reserved", "<u4"),
+		("start", "<f8"),
+		("period", "<f8"),
+		("pad", "u1", (24,))])
+
+	@classmethod
+	def write(cls, file_name: str, points: np.ndarray, period: float, start: float = 0.0):
+
+		"""
+		Writes points, an array of shape (UEs, samples, 3) in meters, sampled every period seconds from start.
+		"""
+
+		points = np.ascontiguousarray(points, dtype="<f4")
+		if points.ndim != 3 or points.shape[2] != 3:
+			raise ValueError("points must have the shape (UEs, samples, 3)")
+		header = np.zeros(1, dtype=cls.header_dtype)
+		header["magic"] = cls.magic
+		header["n_ues"] = points.shape[0]
+		header["n_samples"] = points.shape[1]
+		header["point_size"] = 12
+		header["start"] = start
+		header["period"] = period
+		with open(file_name, "wb") as out:
+			out.write(header.tobytes())
+			out.write(points.tobytes())
+
+	@classmethod
+	def read(cls, file_name: str):
+
+		"""
+		Returns (points, start, period), points being a read-only memory map of shape (UEs, samples, 3).
+		"""
+
+		header = np.fromfile(file_name, dtype=cls.header_dtype, count=1)
+		if len(header) != 1 or header["magic"][0] != cls.magic or header["point_size"][0] != 12:
+			raise ValueError(f"{file_name} is not a trajectory file")
+		n_ues, n_samples = int(header["n_ues"][0]), int(header["n_samples"][0])
+		points = np.memmap(file_name, dtype="<f4", mode="r", offset=cls.header_dtype.itemsize, shape=(n_ues, n_samples, 3))
+		return points, float(header["start"][0]), float(header["period"][0])
+
+
+class TrajectoryGenerator:
+
+	"""
+	Generates UE trajectories offline, for runs that must share the same UE paths (e.g. handover settings compared on identical mobility).
+
+	Methods
+	-------
+	random_walk(n_ues, duration, period)
+		Straight segments at constant speed in a random direction, reflected at the bounds, like the RandomWalk2dOutdoorMobilityModel of the scenario; the UEs start uniformly in a disc, like its UniformDiscPositionAllocator.
+
+	from_csv(file_name, duration, period)
+		Resamples "ue,time,x,y[,z]" rows, e.g. exported from another mobility tool.
+	"""
+
+	def __init__(self, seed: int = 1):
+
+		"""
+		Initializes the class
+		"""
+
+		self.rng = np.random.default_rng(seed)
+
+	def random_walk(self, n_ues: int, duration: float, period: float, center=(2000.0, 2000.0), radius: float = 500.0, bounds=(0.0, 4000.0, 0.0, 4000.0), speed: float = 35.0, change_time: float = 1.0, height: float = 1.5) -> np.ndarray:
+
+		n_samples = int(round(duration / period)) + 1
+		points = np.empty((n_ues, n_samples, 3), dtype=np.float64)
+		rho = radius * np.sqrt(self.rng.random(n_ues))
+		theta = 2 * np.pi * self.rng.random(n_ues)
+		position = np.stack([center[0] + rho * np.cos(theta), center[1] + rho * np.sin(theta)], axis=1)
+		low = np.array([bounds[0], bounds[2]])
+		high = np.array([bounds[1], bounds[3]])
+		velocity = np.zeros((n_ues, 2))
+		next_change = np.zeros(n_ues)
+		for k in range(n_samples):
+			t = k * period
+			change = next_change <= t
+			if change.any():
+				direction = 2 * np.pi * self.rng.random(int(change.sum()))
+				velocity[change] = speed * np.stack([np.cos(direction), np.sin(direction)], axis=1)
+				next_change[change] = t + change_time
+			points[:, k, :2] = position
+			position = position + velocity * period
+			# Reflect on the bounds, as the random walk does
+			below = position < low
+			above = position > high
+			position = np.where(below, 2 * low - position, position)
+			position = np.where(above, 2 * high - position, position)
+			velocity = np.where(below | above, -velocity, velocity)
+		points[:, :, 2] = height
+		return points
+
+	def from_csv(self, file_name: str, duration: float, period: float, height: float = 1.5) -> np.ndarray:
+
+		import pandas as pd
+
+		rows = pd.read_csv(file_name)
+		times = np.arange(int(round(duration / period)) + 1) * period
+		ues = sorted(rows["ue"].unique())
+		points = np.empty((len(ues), len(times), 3), dtype=np.float64)
+		for i, ue in enumerate(ues):
+			track = rows[rows["ue"] == ue].sort_values("time")
+			points[i, :, 0] = np.interp(times, track["time"], track["x"])
+			points[i, :, 1] = np.interp(times, track["time"], track["y"])
+			points[i, :, 2] = np.interp(times, track["time"], track["z"]) if "z" in track else height
+		return points
+
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description="Generate or inspect trajectory files for --mobilityTrace.")
+	subparsers = parser.add_subparsers(dest="command", required=True)
+	walk_parser = subparsers.add_parser("random-walk", help="random walks, like the default UE mobility")
+	walk_parser.add_argument("output")
+	walk_parser.add_argument("--ues", type=int, required=True, help="number of UEs (all the UEs of the scenario)")
+	walk_parser.add_argument("--duration", type=float, default=10.0, help="[s], at least simTime")
+	walk_parser.add_argument("--period", type=float, default=0.1, help="sample period [s]")
+	walk_parser.add_argument("--center", type=float, nargs=2, default=[2000.0, 2000.0], help="center of the start disc [m]")
+	walk_parser.add_argument("--radius", type=float, default=500.0, help="radius of the start disc [m]")
+	walk_parser.add_argument("--bounds", type=float, nargs=4, default=[0.0, 4000.0, 0.0, 4000.0], help="xmin xmax ymin ymax [m]")
+	walk_parser.add_argument("--speed", type=float, default=35.0, help="[m/s]")
+	walk_parser.add_argument("--change-time", type=float, default=1.0, help="time between direction changes [s]")
+	walk_parser.add_argument("--seed", type=int, default=1)
+	csv_parser = subparsers.add_parser("csv", help="resample ue,time,x,y[,z] rows")
+	csv_parser.add_argument("input")
+	csv_parser.add_argument("output")
+	csv_parser.add_argument("--duration", type=float, default=10.0, help="[s], at least simTime")
+	csv_parser.add_argument("--period", type=float, default=0.1, help="sample period [s]")
+	info_parser = subparsers.add_parser("info", help="describe a trajectory file")
+	info_parser.add_argument("file")
+	args = parser.parse_args()
+
+	if args.command == "info":
+		points, start, period = TrajectoryFile.read(args.file)
+		speeds = np.linalg.norm(np.diff(points[:, :, :2], axis=1), axis=2) / period
+		print(f"{points.shape[0]} UEs, {points.shape[1]} samples every {period} s from {start} s")
+		print(f"x {points[:, :, 0].min():.1f}-{points[:, :, 0].max():.1f} m, y {points[:, :, 1].min():.1f}-{points[:, :, 1].max():.1f} m, mean speed {speeds.mean() if speeds.size else 0:.2f} m/s")
+		sys.exit(0)
+	generator = TrajectoryGenerator(getattr(args, "seed", 1))
+	if args.command == "random-walk":
+		points = generator.random_walk(args.ues, args.duration, args.period, args.center, args.radius, args.bounds, args.speed, args.change_time)
+	else:
+		points = generator.from_csv(args.input, args.duration, args.period)
+	TrajectoryFile.write(args.output, points, args.period)
+	print(f"{points.shape[0]} trajectories of {points.shape[1]} samples written to {args.output}")
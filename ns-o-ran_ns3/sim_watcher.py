@@ -1,31 +1,35 @@
 import re
-import csv
 import time
 import threading
 from statsd import StatsClient
 from watchdog.observers import Observer
-from typing import Dict, List, Set, Tuple
+from typing import Dict, List, Optional, Set, Tuple
+from concurrent.futures import ThreadPoolExecutor
+from metric_src.csv_tailer import CsvTailer
 from influx_db.influx_utils import InfluxUtils
 from watchdog.events import PatternMatchingEventHandler
 
-lock = threading.Lock()
-
 
 class SimWatcher(PatternMatchingEventHandler):
 	
 	"""
 	A Python event handler that looks for specific .txt formatted as csv files, parses data from them, and sends it to Telegraf as part of a watchdog object.
 
+	Only the lines appended since the previous event are parsed (see CsvTailer). Modified files are handed to a pool of worker threads, one file at a time per worker, instead of being processed under a global lock.
+
 	Attributes
 	----------
 	patterns : list
 		A list of file patterns that the event handler will monitor.
 		
-	kpm_map : Dict[Tuple[int, int, int], List]
-		A dictionary that contains the data for every measurement in the csv file.
-		
-	consumed_keys : Set[Tuple[int, int, int]]
-		A list of keys already used in the dictionary.
+	consumed_keys : Dict[Tuple[int, int, int], None]
+		The (timestamp, ue, file type) keys already sent to Telegraf, in insertion order. Keys older than key_retention seconds are dropped, so it stays bounded.
+
+	key_retention : int
+		Seconds a consumed key is remembered. Keys use the wall-clock second, so older keys cannot be produced again.
+
+	workers : int
+		Number of threads ingesting modified files concurrently.
 		
 	telegraf_host : str
 		The host address of the Telegraf server "localhost" by default.
@@ -56,8 +60,9 @@ class SimWatcher(PatternMatchingEventHandler):
 	"""
  
 	patterns = ['cu-up-cell-*.txt', 'cu-cp-cell-*.txt', "du-cell-*.txt"]
-	kpm_map: Dict[Tuple[int, int, int], List] = {}
-	consumed_keys: Set[Tuple[int, int, int]]
+	consumed_keys: Dict[Tuple[int, int, int], None]
+	key_retention = 2
+	workers = 4
 	telegraf_host = "telegraf"
 	telegraf_port = 8125
 	statsd_client = StatsClient(telegraf_host, telegraf_port, prefix = None)
@@ -72,8 +77,24 @@ class SimWatcher(PatternMatchingEventHandler):
 											 ignore_patterns=[],
 											 ignore_directories=True, case_sensitive=False)
 		self.directory = ''
-		self.consumed_keys = set()
-		self.influx_utils = InfluxUtils()
+		self.consumed_keys = {}
+		self._keys_lock = threading.Lock()
+		self._tailer = CsvTailer()
+		self._pending: Set[str] = set()
+		self._pending_lock = threading.Lock()
+		self._executor = ThreadPoolExecutor(max_workers=self.workers)
+		self._local = threading.local()
+
+	@property
+	def influx_utils(self) -> InfluxUtils:
+
+		"""
+		One InfluxDB client per worker thread.
+		"""
+
+		if not hasattr(self._local, "influx_utils"):
+			self._local.influx_utils = InfluxUtils()
+		return self._local.influx_utils
 
 	def on_created(self, event):
 
@@ -91,50 +112,98 @@ class SimWatcher(PatternMatchingEventHandler):
 
 		super().on_modified(event)
 
-		lock.acquire()
-		with open(event.src_path, 'r') as file:
-			reader = csv.DictReader(file)
+		# A file already waiting for a worker will be read up to its end anyway
+		with self._pending_lock:
+			if event.src_path in self._pending:
+				return
+			self._pending.add(event.src_path)
+		self._executor.submit(self._ingest, event.src_path)
+
+	def _ingest(self, file_name: str):
+
+		"""
+		Parses the rows appended to file_name and sends them to InfluxDB and Telegraf.
+		"""
+
+		with self._pending_lock:
+			self._pending.discard(file_name)
 
-			for row in reader:
+		try:
+			rows = self._tailer.read_new_rows(file_name)
+			fieldnames = self._tailer.header(file_name)
+			file_type = self._file_type(file_name)
+
+			for row in rows:
 				self.influx_utils.process_row(
-					row=row, file_name=file.name)
+					row=row, file_name=file_name)
+
+				if file_type is None:
+					continue
 
 				timestamp = int(time.time())
 				ue_imsi = int(row['ueImsiComplete'])
 				ue = row['ueImsiComplete']
-				
-				if re.search('cu-up-cell-[2-9].txt', file.name):
-					key = (timestamp, ue_imsi, 0)
-				if re.search('cu-cp-cell-[2-9].txt', file.name):
-					key = (timestamp, ue_imsi, 1)
-				if re.search('du-cell-[1-9].txt', file.name):
-					key = (timestamp, ue_imsi, 2)
-				if file.name == './cu-up-cell-1.txt':
-					key = (timestamp, ue_imsi, 3)   # to see data for eNB cell
-				if file.name == './cu-cp-cell-1.txt':
-					key = (timestamp, ue_imsi, 4)   # same here
+				key = (timestamp, ue_imsi, file_type)
+
+				if not self._consume_key(key):
+					continue
+
+				values = list()
+				fields = list()
+
+				for column_name in fieldnames:
+					if row[column_name] == '':
+						continue
+					values.append(float(row[column_name]))
+					fields.append(column_name)
 
-				if key not in self.consumed_keys:
+				regex = re.search(r"\w*-(\d+)\.txt", file_name)
+				fields.append('file_id_number')
+				values.append(regex.group(1))      # last item of list will be file_id_number
 
-					if key not in self.kpm_map:
-						self.kpm_map[key] = []
+				self._send_to_telegraf(ue=ue, values=values, fields=fields, file_type=file_type)
 
-					fields = list()
+		except Exception as error:
+			print(f"Error while ingesting {file_name}: {error}")
 
-					for column_name in reader.fieldnames:
-						if row[column_name] == '':
-							continue
-						self.kpm_map[key].append(float(row[column_name]))
-						fields.append(column_name)
+	@staticmethod
+	def _file_type(file_name: str) -> Optional[int]:
 
-					regex = re.search(r"\w*-(\d+)\.txt", file.name)
-					fields.append('file_id_number')
-					self.kpm_map[key].append(regex.group(1))      # last item of list will be file_id_number
+		"""
+		Returns the file type of the telegraf key of file_name (0 to 4), None if it is not sent to Telegraf.
+		"""
+
+		file_type = None
+		if re.search('cu-up-cell-[2-9].txt', file_name):
+			file_type = 0
+		if re.search('cu-cp-cell-[2-9].txt', file_name):
+			file_type = 1
+		if re.search('du-cell-[1-9].txt', file_name):
+			file_type = 2
+		if file_name == './cu-up-cell-1.txt':
+			file_type = 3   # to see data for eNB cell
+		if file_name == './cu-cp-cell-1.txt':
+			file_type = 4   # same here
+		return file_type
+
+	def _consume_key(self, key: Tuple[int, int, int]) -> bool:
+
+		"""
+		Returns True the first time key is seen, and drops the keys older than key_retention seconds.
+		"""
 
-					self.consumed_keys.add(key)
-					self._send_to_telegraf(ue=ue, values=self.kpm_map[key], fields=fields, file_type=key[2])
+		with self._keys_lock:
+			if key in self.consumed_keys:
+				return False
+			self.consumed_keys[key] = None
 
-		lock.release()
+			oldest = key[0] - self.key_retention
+			while self.consumed_keys:
+				first = next(iter(self.consumed_keys))
+				if first[0] >= oldest:
+					break
+				del self.consumed_keys[first]
+			return True
 
 	def on_closed(self, event):
 
@@ -209,9 +278,16 @@ if __name__ == "__main__":
 	observer.start()
 	
 	try:
+		seconds = 0
 		while True:
 			time.sleep(1)
+			seconds += 1
+			if seconds % 30 == 0 and InfluxUtils.shared_writer is not None:
+				print(f"InfluxDB writer: {InfluxUtils.shared_writer.stats()}")
 	except KeyboardInterrupt:
 		observer.stop()
 	
 	observer.join()
+	event_handler._executor.shutdown(wait=True)
+	if InfluxUtils.shared_writer is not None:
+		InfluxUtils.shared_writer.close()